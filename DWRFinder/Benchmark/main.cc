@@ -0,0 +1,204 @@
+//
+//  main.cc
+//  DWRFinder Benchmark
+//
+//  Created by ZachQin on 2018/1/15.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+//  Usage: DWRBenchmark [--waypoints N] [--coverage C] [--queries Q] [--k-queries Q] [--k K]
+//                      [--raster WxH] [--seed S] [--output FILE]
+//  Every benchmark is written as one JSON object per line.
+//
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "airway_graph.h"
+#include "dynamic_radar_airway_graph.h"
+#include "synthetic_generator.h"
+
+using namespace std;
+
+struct Options {
+    int waypoint_count = 10000;
+    double coverage = 0.05;
+    int query_count = 200;
+    int k_query_count = 20;
+    int k = 3;
+    int raster_width = 3000;
+    int raster_height = 2600;
+    uint32_t seed = 1;
+    string output;
+};
+
+struct Result {
+    string name;
+    vector<double> latencies;
+    double total_seconds = 0;
+};
+
+static long PeakRSSKilobytes() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+static double Percentile(vector<double> sorted_latencies, double percentile) {
+    if (sorted_latencies.empty()) {
+        return 0;
+    }
+    sort(sorted_latencies.begin(), sorted_latencies.end());
+    size_t index = static_cast<size_t>(percentile * (sorted_latencies.size() - 1) + 0.5);
+    return sorted_latencies[index];
+}
+
+static Result Measure(const string &name, int count, const function<void(int)> &operation) {
+    Result result;
+    result.name = name;
+    auto total_start = chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        auto start = chrono::steady_clock::now();
+        operation(i);
+        result.latencies.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+    result.total_seconds = chrono::duration<double>(chrono::steady_clock::now() - total_start).count();
+    return result;
+}
+
+static void Report(ostream &os, const Options &options, const Result &result) {
+    char line[512];
+    snprintf(line, sizeof(line),
+             "{\"benchmark\":\"%s\",\"waypoints\":%d,\"coverage\":%.4f,\"seed\":%u,\"count\":%zu,"
+             "\"p50_ms\":%.4f,\"p99_ms\":%.4f,\"throughput_per_s\":%.2f,\"peak_rss_kb\":%ld}",
+             result.name.c_str(), options.waypoint_count, options.coverage, options.seed, result.latencies.size(),
+             Percentile(result.latencies, 0.5), Percentile(result.latencies, 0.99),
+             result.total_seconds > 0 ? result.latencies.size() / result.total_seconds : 0.0,
+             PeakRSSKilobytes());
+    os << line << endl;
+}
+
+static bool ParseOptions(int argc, const char *argv[], Options &options) {
+    for (int i = 1; i < argc; i++) {
+        string argument = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        string value = argv[++i];
+        if (argument == "--waypoints") {
+            options.waypoint_count = stoi(value);
+        } else if (argument == "--coverage") {
+            options.coverage = min(max(stod(value), 0.0), 0.95);
+        } else if (argument == "--queries") {
+            options.query_count = stoi(value);
+        } else if (argument == "--k-queries") {
+            options.k_query_count = stoi(value);
+        } else if (argument == "--k") {
+            options.k = stoi(value);
+        } else if (argument == "--raster") {
+            if (sscanf(value.c_str(), "%dx%d", &options.raster_width, &options.raster_height) != 2) {
+                return false;
+            }
+        } else if (argument == "--seed") {
+            options.seed = static_cast<uint32_t>(stoul(value));
+        } else if (argument == "--output") {
+            options.output = value;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static vector<pair<dwr::WaypointIdentifier, dwr::WaypointIdentifier>>
+RandomQueries(const dwr::AirwayGraph &graph, int count, uint32_t seed) {
+    vector<dwr::WaypointIdentifier> connected;
+    for (auto identifier : graph.AllWaypointIdentifiers()) {
+        if (!graph.WaypointFromIdentifier(identifier)->neibors.empty()) {
+            connected.push_back(identifier);
+        }
+    }
+    vector<pair<dwr::WaypointIdentifier, dwr::WaypointIdentifier>> queries;
+    if (connected.empty()) {
+        return queries;
+    }
+    mt19937 random_engine(seed);
+    uniform_int_distribution<size_t> distribution(0, connected.size() - 1);
+    for (int i = 0; i < count; i++) {
+        queries.emplace_back(connected[distribution(random_engine)], connected[distribution(random_engine)]);
+    }
+    return queries;
+}
+
+int main(int argc, const char *argv[]) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        cerr << "usage: " << argv[0] << " [--waypoints N] [--coverage C] [--queries Q] [--k-queries Q] [--k K]"
+             << " [--raster WxH] [--seed S] [--output FILE]" << endl;
+        return 1;
+    }
+    ofstream output_file;
+    if (!options.output.empty()) {
+        output_file.open(options.output);
+    }
+    ostream &os = options.output.empty() ? cout : output_file;
+
+    // 生成并保存合成航路网，用于测量加载时间
+    string graph_path = "dwr_benchmark_" + to_string(options.seed) + ".ag";
+    {
+        dwr::AirwayGraph generated_graph;
+        dwr::benchmark::GenerateAirwayGraph(generated_graph, options.waypoint_count,
+                                            dwr::benchmark::kDefaultRegion, options.seed);
+        generated_graph.SaveToFile(graph_path);
+    }
+    dwr::DynamicRadarAirwayGraph graph;
+    Report(os, options, Measure("LoadFromFile", 1, [&](int){graph.LoadFromFile(graph_path);}));
+    remove(graph_path.c_str());
+
+    auto world_file_info = dwr::benchmark::GenerateWorldFile(dwr::benchmark::kDefaultRegion,
+                                                             options.raster_width, options.raster_height);
+    Report(os, options, Measure("Build", 1, [&](int){graph.Build(world_file_info);}));
+
+    const int update_count = 5;
+    vector<char *> masks;
+    for (int i = 0; i < update_count; i++) {
+        masks.push_back(dwr::benchmark::GenerateRadarMask(options.raster_width, options.raster_height,
+                                                          options.coverage, options.seed + i));
+    }
+    // 图持有掩码的所有权
+    Report(os, options, Measure("UpdateBlock", update_count, [&](int i){
+        graph.UpdateBlock(masks[i], options.raster_width, options.raster_height);
+    }));
+
+    auto queries = RandomQueries(graph, options.query_count, options.seed);
+    Report(os, options, Measure("FindPath", static_cast<int>(queries.size()), [&](int i){
+        graph.FindPath(queries[i].first, queries[i].second);
+    }));
+    Report(os, options, Measure("FindDynamicPath", static_cast<int>(queries.size()), [&](int i){
+        graph.FindDynamicPath(queries[i].first, queries[i].second);
+    }));
+    Report(os, options, Measure("FindDynamicFullPath", static_cast<int>(queries.size()), [&](int i){
+        graph.FindDynamicFullPath(queries[i].first, queries[i].second);
+    }));
+    int k_query_count = min(options.k_query_count, static_cast<int>(queries.size()));
+    Report(os, options, Measure("FindKDynamicFullPath", k_query_count, [&](int i){
+        graph.FindKDynamicFullPath(queries[i].first, queries[i].second, options.k);
+    }));
+    Report(os, options, Measure("FindParetoDynamicFullPath", k_query_count, [&](int i){
+        graph.FindParetoDynamicFullPath(queries[i].first, queries[i].second);
+    }));
+    return 0;
+}
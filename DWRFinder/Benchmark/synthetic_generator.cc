@@ -0,0 +1,102 @@
+//
+//  synthetic_generator.cc
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/15.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include "synthetic_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "coordinate_convert.h"
+
+namespace dwr {
+namespace benchmark {
+
+const SyntheticRegion kDefaultRegion = {1.7, 2.3, 0.3, 0.85};
+
+void GenerateAirwayGraph(AirwayGraph &graph, int waypoint_count, const SyntheticRegion &region, uint32_t seed) {
+    std::mt19937 random_engine(seed);
+    std::uniform_real_distribution<double> jitter(-0.35, 0.35);
+    std::uniform_real_distribution<double> probability(0.0, 1.0);
+    int columns = std::max(1, static_cast<int>(std::ceil(std::sqrt(static_cast<double>(waypoint_count)))));
+    int rows = (waypoint_count + columns - 1) / columns;
+    double cell_width = (region.east - region.west) / columns;
+    double cell_height = (region.north - region.south) / std::max(rows, 1);
+    for (int i = 0; i < waypoint_count; i++) {
+        int row = i / columns, column = i % columns;
+        double longitude = region.west + (column + 0.5 + jitter(random_engine)) * cell_width;
+        double latitude = region.south + (row + 0.5 + jitter(random_engine)) * cell_height;
+        graph.AddWaypoint(i, "W" + std::to_string(i), longitude, latitude);
+    }
+    // 连接网格邻居，部分删除使网络不规则
+    for (int i = 0; i < waypoint_count; i++) {
+        int row = i / columns, column = i % columns;
+        if (column + 1 < columns && i + 1 < waypoint_count && probability(random_engine) < 0.8) {
+            graph.AddAirwaySegment(i, i + 1);
+        }
+        if (row + 1 < rows && i + columns < waypoint_count && probability(random_engine) < 0.8) {
+            graph.AddAirwaySegment(i, i + columns);
+        }
+        if (column + 1 < columns && row + 1 < rows && i + columns + 1 < waypoint_count && probability(random_engine) < 0.2) {
+            graph.AddAirwaySegment(i, i + columns + 1);
+        }
+    }
+}
+
+WorldFileInfo GenerateWorldFile(const SyntheticRegion &region, int width, int height) {
+    double west, east, south, north;
+    LonLatToMerc(region.west, region.south, &west, &south);
+    LonLatToMerc(region.east, region.north, &east, &north);
+    WorldFileInfo world_file_info;
+    world_file_info.A = (east - west) / width;
+    world_file_info.B = 0;
+    world_file_info.D = 0;
+    world_file_info.E = -(north - south) / height;
+    world_file_info.C = west;
+    world_file_info.F = north;
+    return world_file_info;
+}
+
+char *GenerateRadarMask(int width, int height, double coverage, uint32_t seed) {
+    std::mt19937 random_engine(seed);
+    char *mask = new char[static_cast<size_t>(width) * height]();
+    long long target = static_cast<long long>(coverage * width * height);
+    long long covered = 0;
+    std::uniform_int_distribution<int> x_distribution(0, width - 1);
+    std::uniform_int_distribution<int> y_distribution(0, height - 1);
+    std::uniform_real_distribution<double> radius_distribution(0.005, 0.03);
+    std::uniform_real_distribution<double> shape_distribution(0.4, 1.0);
+    std::uniform_real_distribution<double> angle_distribution(0, M_PI);
+    int scale = std::min(width, height);
+    while (covered < target) {
+        int center_x = x_distribution(random_engine);
+        int center_y = y_distribution(random_engine);
+        double major = radius_distribution(random_engine) * scale;
+        double minor = major * shape_distribution(random_engine);
+        double angle = angle_distribution(random_engine);
+        double cos_angle = cos(angle), sin_angle = sin(angle);
+        int extent = static_cast<int>(std::ceil(major));
+        for (int y = std::max(0, center_y - extent); y <= std::min(height - 1, center_y + extent); y++) {
+            for (int x = std::max(0, center_x - extent); x <= std::min(width - 1, center_x + extent); x++) {
+                double u = ((x - center_x) * cos_angle + (y - center_y) * sin_angle) / major;
+                double v = (-(x - center_x) * sin_angle + (y - center_y) * cos_angle) / minor;
+                char &value = mask[static_cast<size_t>(y) * width + x];
+                if (u * u + v * v <= 1 && value == 0) {
+                    value = 1;
+                    covered++;
+                }
+            }
+        }
+    }
+    return mask;
+}
+
+}  // namespace benchmark
+}  // namespace dwr
@@ -0,0 +1,65 @@
+//
+//  synthetic_generator.h
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/15.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#ifndef synthetic_generator_h
+#define synthetic_generator_h
+
+#include <cstdint>
+#include <memory>
+
+#include "airway_graph.h"
+#include "dynamic_radar_airway_graph.h"
+
+namespace dwr {
+namespace benchmark {
+
+/**
+ Region covered by the synthetic data, in radian.
+ */
+struct SyntheticRegion {
+    GeoRad west;
+    GeoRad east;
+    GeoRad south;
+    GeoRad north;
+};
+
+/**
+ Roughly the extent of the test radar image.
+ */
+extern const SyntheticRegion kDefaultRegion;
+
+/**
+ Generate an airway network. Waypoints are jittered grid points and each one connects to
+ some of its grid neighbours, so the degree and the edge length look like a real network.
+
+ @param graph Graph to fill, should be empty.
+ @param waypoint_count Number of waypoints.
+ @param region Region of the waypoints.
+ @param seed Random seed.
+ */
+void GenerateAirwayGraph(AirwayGraph &graph, int waypoint_count, const SyntheticRegion &region, uint32_t seed);
+
+/**
+ World file mapping a raster of the given size onto the region in mercator coordinate.
+ */
+WorldFileInfo GenerateWorldFile(const SyntheticRegion &region, int width, int height);
+
+/**
+ Generate a radar mask made of elliptic storm cells until the given coverage is reached.
+
+ @param width Width of mask pixel.
+ @param height Height of mask pixel.
+ @param coverage Fraction of blocked pixels in [0, 1].
+ @param seed Random seed.
+ @return Mask allocated with new[], 1 means block.
+ */
+char *GenerateRadarMask(int width, int height, double coverage, uint32_t seed);
+
+}  // namespace benchmark
+}  // namespace dwr
+#endif /* synthetic_generator_h */
@@ -18,41 +18,79 @@ const double kMercParamX0 = 0.0;
 const double kMercParamY0 = 0.0;
 const double kMercParamRa = 0.00000015678559428873979;
 
-#define TOL 1.0e-10
-#define N_ITER 15
+// Coefficients of the conformal latitude to geodetic latitude series (Snyder, Map Projections, 3-5)
+// with the eccentricity of WGS84. The truncated terms are O(e^10) and the error is below 2e-12 rad.
+#define E2 (0.081819190842621486 * 0.081819190842621486)
+#define E4 (E2 * E2)
+#define E6 (E4 * E2)
+#define E8 (E4 * E4)
+static const double kPhiSeries2 = E2 / 2. + 5. * E4 / 24. + E6 / 12. + 13. * E8 / 360.;
+static const double kPhiSeries4 = 7. * E4 / 48. + 29. * E6 / 240. + 811. * E8 / 11520.;
+static const double kPhiSeries6 = 7. * E6 / 120. + 81. * E8 / 1120.;
+static const double kPhiSeries8 = 4279. * E8 / 161280.;
 
-static double pj_tsfn(double phi, double sinphi, double e) {
-    sinphi *= e;
-    return (tan (.5 * (M_PI_2 - phi)) /
-            pow((1. - sinphi) / (1. + sinphi), .5 * e));
+static inline double MercYToLatitude(double y) {
+    // Conformal latitude chi = gd(y), with sin(chi) = tanh(y) and cos(chi) = sech(y).
+    double t = exp(y);
+    double sinh_y = .5 * (t - 1. / t);
+    double cosh_y = .5 * (t + 1. / t);
+    double chi = atan(sinh_y);
+    double sin_chi = sinh_y / cosh_y;
+    double cos_chi = 1. / cosh_y;
+    // Multiple angles by recurrence, so only one transcendental call per term is needed.
+    double sin2 = 2. * sin_chi * cos_chi;
+    double cos2 = cos_chi * cos_chi - sin_chi * sin_chi;
+    double sin4 = 2. * sin2 * cos2;
+    double cos4 = cos2 * cos2 - sin2 * sin2;
+    double sin6 = sin4 * cos2 + cos4 * sin2;
+    double sin8 = 2. * sin4 * cos4;
+    return chi + kPhiSeries2 * sin2 + kPhiSeries4 * sin4 + kPhiSeries6 * sin6 + kPhiSeries8 * sin8;
 }
 
-static double pj_phi2(double ts, double e) {
-    double eccnth, Phi, con, dphi;
-    int i;
-    
-    eccnth = .5 * e;
-    Phi = M_PI_2 - 2. * atan (ts);
-    i = N_ITER;
-    do {
-        con = e * sin (Phi);
-        dphi = M_PI_2 - 2. * atan (ts * pow((1. - con) /
-                                            (1. + con), eccnth)) - Phi;
-        Phi += dphi;
-    } while ( fabs(dphi) > TOL && --i);
-    return Phi;
+static inline double LatitudeToMercY(double lat) {
+    // -ln(tsfn(lat)) = atanh(sin(lat)) - e * atanh(e * sin(lat))
+    double sin_lat = sin(lat);
+    double e_sin_lat = kMercParamE * sin_lat;
+    return .5 * (log((1. + sin_lat) / (1. - sin_lat)) -
+                 kMercParamE * log((1. + e_sin_lat) / (1. - e_sin_lat)));
 }
 
 void MercToLonLat(double x, double y, double *lon, double *lat) {
-    x = (x * kMercParamToMeter - kMercParamX0) * kMercParamRa;
-    y = (y * kMercParamToMeter - kMercParamY0) * kMercParamRa;
-    *lon = x / kMercParamK0;
-    *lat = pj_phi2(exp(-y / kMercParamK0), kMercParamE);
+    MercToLonLatBatch(&x, &y, lon, lat, 1);
 }
 
 void LonLatToMerc(double lon, double lat, double *x, double *y) {
-    *x = kMercParamK0 * lon;
-    *y = -kMercParamK0 * log(pj_tsfn(lat, sin(lat), kMercParamE));
-    *x = kMercParamFrMeter * (*x * kMercParamA + kMercParamX0);
-    *y = kMercParamFrMeter * (*y * kMercParamA + kMercParamY0);
+    LonLatToMercBatch(&lon, &lat, x, y, 1);
+}
+
+void MercToLonLatBatch(const double *restrict x, const double *restrict y,
+                       double *restrict lon, double *restrict lat, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        double xx = (x[i] * kMercParamToMeter - kMercParamX0) * kMercParamRa;
+        double yy = (y[i] * kMercParamToMeter - kMercParamY0) * kMercParamRa;
+        lon[i] = xx / kMercParamK0;
+        lat[i] = MercYToLatitude(yy / kMercParamK0);
+    }
+}
+
+void LonLatToMercBatch(const double *restrict lon, const double *restrict lat,
+                       double *restrict x, double *restrict y, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        double xx = kMercParamK0 * lon[i];
+        double yy = kMercParamK0 * LatitudeToMercY(lat[i]);
+        x[i] = kMercParamFrMeter * (xx * kMercParamA + kMercParamX0);
+        y[i] = kMercParamFrMeter * (yy * kMercParamA + kMercParamY0);
+    }
+}
+
+void PixelToLonLatBatch(const double affine[6],
+                        const int *restrict pixel_x, const int *restrict pixel_y,
+                        double *restrict x, double *restrict y,
+                        double *restrict lon, double *restrict lat, size_t count) {
+    double a = affine[0], d = affine[1], b = affine[2], e = affine[3], c = affine[4], f = affine[5];
+    for (size_t i = 0; i < count; i++) {
+        x[i] = a * pixel_x[i] + b * pixel_y[i] + c;
+        y[i] = d * pixel_x[i] + e * pixel_y[i] + f;
+    }
+    MercToLonLatBatch(x, y, lon, lat, count);
 }
@@ -9,6 +9,8 @@
 #ifndef coordinate_convert_h
 #define coordinate_convert_h
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -16,6 +18,26 @@ extern "C" {
 void MercToLonLat(double x, double y, double *lon, double *lat);
 void LonLatToMerc(double lon, double lat, double *x, double *y);
 
+/*
+ Array versions of the conversions above. The inverse uses a closed form series instead of
+ Newton iterations; the latitude error of the series is below 2e-12 rad (about 0.01 mm on the
+ ground). The loops still call the scalar exp, atan, sin and log of libm for each element, so
+ they are not vectorized. The arrays must not overlap.
+ */
+void MercToLonLatBatch(const double *x, const double *y, double *lon, double *lat, size_t count);
+void LonLatToMercBatch(const double *lon, const double *lat, double *x, double *y, size_t count);
+
+/*
+ Project world file pixels to mercator coordinates and longitude/latitude in one pass.
+ affine holds a, d, b, e, c, f of x = a * px + b * py + c and y = d * px + e * py + f, the
+ 2x3 matrix in column order. WorldFileInfo names these A, D, B, E, C, F, but reads them from
+ the file in the order A, B, D, E, C, F.
+ */
+void PixelToLonLatBatch(const double affine[6],
+                        const int *pixel_x, const int *pixel_y,
+                        double *x, double *y,
+                        double *lon, double *lat, size_t count);
+
 #ifdef __cplusplus
 }
 #endif
@@ -8,41 +8,22 @@
 
 #include "graphics_utils.h"
 
+#include <math.h>
+
+#include <algorithm>
 #include <utility>
 
 namespace dwr {
 Line BresenhamLine(const Pixel &start_pixel, const Pixel &end_pixel) {
     Line result;
-    int x0 = start_pixel.x, x1 = end_pixel.x;
-    int y0 = start_pixel.y, y1 = end_pixel.y;
-    bool steep = abs(y1 - y0) > abs(x1 - x0);
-    if (steep) {
-        std::swap(x0, y0);
-        std::swap(x1, y1);
-    }
-    bool reverse = x0 > x1;
-    if (reverse) {
-        std::swap(x0, x1);
-        std::swap(y0, y1);
-    }
-    int delta_x = x1 - x0;
-    int delta_y = abs(y1 - y0);
-    int error = delta_x / 2;
-    int yy = y0;
-    int ystep = y0 < y1 ? 1 : -1;
-    for (int xx = x0; xx <= x1; xx++) {
-        if (steep) {
-            result.push_back(Pixel(yy, xx));
-        } else {
-            result.push_back(Pixel(xx, yy));
-        }
-        error -= delta_y;
-        if (error < 0) {
-            yy += ystep;
-            error += delta_x;
-        }
-    }
-    if (reverse) {
+    result.reserve(std::max(abs(end_pixel.x - start_pixel.x), abs(end_pixel.y - start_pixel.y)) + 1);
+    WalkBresenhamLine(start_pixel, end_pixel, [&result](const Pixel &pixel) {
+        result.push_back(pixel);
+        return true;
+    });
+    // 保持从起点到终点的顺序
+    bool steep = abs(end_pixel.y - start_pixel.y) > abs(end_pixel.x - start_pixel.x);
+    if (steep ? start_pixel.y > end_pixel.y : start_pixel.x > end_pixel.x) {
         std::reverse(result.begin(), result.end());
     }
     return result;
@@ -72,4 +53,78 @@ std::vector<Line> VerticalEquantLine(const Pixel &start_pixel, const Pixel &end_
     return result;
 }
 
+void ScanlinePolygon(const std::vector<double> &x,
+                     const std::vector<double> &y,
+                     std::vector<PixelSpan> &spans) {
+    struct Edge {
+        int first_row;
+        int last_row;
+        double x0;
+        double y0;
+        double dxdy;
+    };
+    int n = static_cast<int>(x.size());
+    if (n < 3) {
+        return;
+    }
+    std::vector<Edge> edges;
+    for (int i = 0; i < n; i++) {
+        int j = (i + 1) % n;
+        // 轮廓像素，向下取整使负坐标也落在所在的像素
+        Line outline = BresenhamLine(Pixel(static_cast<int>(floor(x[i])), static_cast<int>(floor(y[i]))),
+                                     Pixel(static_cast<int>(floor(x[j])), static_cast<int>(floor(y[j]))));
+        for (auto &pixel : outline) {
+            spans.push_back({pixel.y, pixel.x, pixel.x + 1});
+        }
+        if (y[i] == y[j]) {
+            continue;
+        }
+        double top = std::min(y[i], y[j]), bottom = std::max(y[i], y[j]);
+        // 覆盖像素中心 row + 0.5 ∈ [top, bottom) 的行
+        Edge edge;
+        edge.first_row = static_cast<int>(ceil(top - 0.5));
+        edge.last_row = static_cast<int>(ceil(bottom - 0.5)) - 1;
+        edge.x0 = x[i];
+        edge.y0 = y[i];
+        edge.dxdy = (x[j] - x[i]) / (y[j] - y[i]);
+        if (edge.first_row <= edge.last_row) {
+            edges.push_back(edge);
+        }
+    }
+    if (edges.empty()) {
+        return;
+    }
+    std::sort(edges.begin(), edges.end(), [](const Edge &edge1, const Edge &edge2) {
+        return edge1.first_row < edge2.first_row;
+    });
+    int last_row = edges[0].last_row;
+    for (auto &edge : edges) {
+        last_row = std::max(last_row, edge.last_row);
+    }
+    std::vector<const Edge *> active_edges;
+    std::vector<double> crossings;
+    size_t next_edge = 0;
+    for (int row = edges[0].first_row; row <= last_row; row++) {
+        while (next_edge < edges.size() && edges[next_edge].first_row == row) {
+            active_edges.push_back(&edges[next_edge++]);
+        }
+        active_edges.erase(std::remove_if(active_edges.begin(), active_edges.end(), [row](const Edge *edge) {
+            return edge->last_row < row;
+        }), active_edges.end());
+        double center_y = row + 0.5;
+        crossings.clear();
+        for (auto edge : active_edges) {
+            crossings.push_back(edge->x0 + (center_y - edge->y0) * edge->dxdy);
+        }
+        std::sort(crossings.begin(), crossings.end());
+        for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+            int begin_x = static_cast<int>(ceil(crossings[i] - 0.5));
+            int end_x = static_cast<int>(ceil(crossings[i + 1] - 0.5));
+            if (begin_x < end_x) {
+                spans.push_back({row, begin_x, end_x});
+            }
+        }
+    }
+}
+
 }  // namespace dwr
@@ -9,17 +9,70 @@
 #ifndef graphics_utils_h
 #define graphics_utils_h
 
+#include <stdlib.h>
+
+#include <utility>
 #include <vector>
 #include "raster_type.h"
 
 namespace dwr {
 
+/**
+ Visit the pixels of BresenhamLine without building the line. The pixels are visited from
+ the endpoint with the smaller major coordinate, so the order may be reversed.
+
+ @param visit Function called with each pixel, returning false to stop.
+ @return False when stopped by visit.
+ */
+template <typename Visit>
+bool WalkBresenhamLine(const Pixel &start_pixel, const Pixel &end_pixel, Visit visit) {
+    int x0 = start_pixel.x, x1 = end_pixel.x;
+    int y0 = start_pixel.y, y1 = end_pixel.y;
+    bool steep = abs(y1 - y0) > abs(x1 - x0);
+    if (steep) {
+        std::swap(x0, y0);
+        std::swap(x1, y1);
+    }
+    if (x0 > x1) {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+    }
+    int delta_x = x1 - x0;
+    int delta_y = abs(y1 - y0);
+    int error = delta_x / 2;
+    int yy = y0;
+    int ystep = y0 < y1 ? 1 : -1;
+    for (int xx = x0; xx <= x1; xx++) {
+        if (!(steep ? visit(Pixel(yy, xx)) : visit(Pixel(xx, yy)))) {
+            return false;
+        }
+        error -= delta_y;
+        if (error < 0) {
+            yy += ystep;
+            error += delta_x;
+        }
+    }
+    return true;
+}
+
 Line BresenhamLine(const Pixel &start_pixel, const Pixel &end_pixel);
 
 std::vector<Line> VerticalEquantLine(const Pixel &start_pixel,
                                      const Pixel &end_pixel,
                                      int segment_number,
                                      int radius);
+
+/**
+ Pixels covered by a polygon, filled with the even-odd rule at the pixel centers and
+ outlined with Bresenham lines so that thin parts are not lost.
+
+ @param x Vertex x in continuous pixel coordinate, pixel (i, j) covering [i, i + 1) x [j, j + 1).
+ @param y Vertex y in continuous pixel coordinate.
+ @param spans Spans are appended to it, unsorted and possibly overlapping.
+ */
+void ScanlinePolygon(const std::vector<double> &x,
+                     const std::vector<double> &y,
+                     std::vector<PixelSpan> &spans);
 }  // namespace dwr
 
 #endif /* graphics_utils_h */
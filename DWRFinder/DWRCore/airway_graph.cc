@@ -8,14 +8,36 @@
 
 #include "airway_graph.h"
 
+#include <algorithm>
+#include <cmath>
 #include <queue>
 #include <fstream>
+#include <stdexcept>
 #include <string>
+#include <tuple>
 #include <memory>
 #include <utility>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Utils/coordinate_convert.h"
+#include "compact_path.h"
+#include "graph_scenario.h"
+#include "metrics.h"
 
 namespace dwr {
 
+static const Histogram find_path_latency =
+MetricsRegistry::Default().AddHistogram("dwr_find_path_seconds", "Latency of AirwayGraph::FindPath.", 1e-6);
+static const Histogram find_k_path_latency =
+MetricsRegistry::Default().AddHistogram("dwr_find_k_path_seconds", "Latency of AirwayGraph::FindKPath.", 1e-6);
+static const Histogram save_latency =
+MetricsRegistry::Default().AddHistogram("dwr_save_seconds", "Latency of AirwayGraph::SaveToFile.", 1e-6);
+static const Histogram load_latency =
+MetricsRegistry::Default().AddHistogram("dwr_load_seconds", "Latency of AirwayGraph::LoadFromFile.", 1e-6);
+static const Histogram apply_change_latency =
+MetricsRegistry::Default().AddHistogram("dwr_apply_change_seconds", "Latency of AirwayGraph::ApplyChange.", 1e-6);
+
 AirwayGraph::AirwayGraph(const char *path) {
     this->LoadFromFile(path);
 }
@@ -24,7 +46,24 @@ void AirwayGraph::AddWaypoint(WaypointIdentifier identifier,
                               const std::string &name,
                               GeoRad longitude,
                               GeoRad latitude) {
-    waypoint_map_[identifier] = std::make_shared<Waypoint>(identifier, name, longitude, latitude);
+    auto waypoint = std::make_shared<Waypoint>(identifier, name, longitude, latitude);
+    // 投影坐标使航段在Build前即有方向
+    LonLatToMerc(longitude, latitude, &waypoint->coordinate.x, &waypoint->coordinate.y);
+    InsertWaypoint(waypoint);
+}
+
+void AirwayGraph::InsertWaypoint(const WaypointPtr &waypoint) {
+    int32_t index = identifier_table_.Find(waypoint->identifier);
+    if (index != IdentifierTable::kNoIndex) {
+        // 替换同ID的航路点
+        waypoints_[index]->index = -1;
+        waypoints_[index] = waypoint;
+    } else {
+        index = static_cast<int32_t>(waypoints_.size());
+        waypoints_.push_back(waypoint);
+        identifier_table_.Insert(waypoint->identifier, index);
+    }
+    waypoint->index = index;
 }
 
 void AirwayGraph::RemoveAirwaySegments(const WaypointPtr &waypoint) {
@@ -39,19 +78,32 @@ void AirwayGraph::RemoveAirwaySegments(const WaypointPtr &waypoint) {
 }
 
 void AirwayGraph::RemoveWaypoint(WaypointIdentifier identifier) {
-    auto waypoint_iterator = waypoint_map_.find(identifier);
-    if (waypoint_iterator == waypoint_map_.end()) {
+    int32_t index = identifier_table_.Find(identifier);
+    if (index == IdentifierTable::kNoIndex) {
         return;
     }
-    RemoveAirwaySegments(waypoint_iterator->second);
-    waypoint_map_.erase(identifier);
+    RemoveAirwaySegments(waypoints_[index]);
+    EraseWaypointAt(index);
+}
+
+void AirwayGraph::EraseWaypointAt(int32_t index) {
+    waypoints_[index]->index = -1;
+    identifier_table_.Erase(waypoints_[index]->identifier);
+    // 末尾的航路点移入空位，保持索引稠密
+    if (index + 1 < waypoints_.size()) {
+        waypoints_[index] = waypoints_.back();
+        waypoints_[index]->index = index;
+        identifier_table_.Insert(waypoints_[index]->identifier, index);
+    }
+    waypoints_.pop_back();
 }
 
 void AirwayGraph::AddAirwaySegment(const WaypointPtr &waypoint1,
                                    const WaypointPtr &waypoint2) {
     GeoDistance distance = Waypoint::Distance(*waypoint1, *waypoint2);
-    Neighbor neibor1(waypoint2, distance);
-    Neighbor neibor2(waypoint1, distance);
+    GeoProj direction = Waypoint::Direction(*waypoint1, *waypoint2);
+    Neighbor neibor1(waypoint2, distance, direction);
+    Neighbor neibor2(waypoint1, distance, {-direction.x, -direction.y});
     if (std::find(waypoint1->neibors.begin(), waypoint1->neibors.end(), neibor1) == waypoint1->neibors.end()) {
         waypoint1->neibors.push_back(std::move(neibor1));
     }
@@ -62,13 +114,12 @@ void AirwayGraph::AddAirwaySegment(const WaypointPtr &waypoint1,
 
 void AirwayGraph::AddAirwaySegment(WaypointIdentifier identifier1,
                                    WaypointIdentifier identifier2) {
-    auto waypoint_iterator1 = waypoint_map_.find(identifier1);
-    auto waypoint_iterator2 = waypoint_map_.find(identifier2);
-    if (waypoint_iterator1 == waypoint_map_.end() ||
-        waypoint_iterator2 == waypoint_map_.end()) {
+    auto waypoint1 = WaypointFromIdentifier(identifier1);
+    auto waypoint2 = WaypointFromIdentifier(identifier2);
+    if (waypoint1 == nullptr || waypoint2 == nullptr) {
         return;
     }
-    AddAirwaySegment(waypoint_iterator1->second, waypoint_iterator2->second);
+    AddAirwaySegment(waypoint1, waypoint2);
 }
 
 void AirwayGraph::RemoveAirwaySegment(const WaypointPtr &waypoint1,
@@ -83,12 +134,124 @@ void AirwayGraph::RemoveAirwaySegment(const WaypointPtr &waypoint1,
 
 void AirwayGraph::RemoveAirwaySegment(WaypointIdentifier identifier1,
                                       WaypointIdentifier identifier2) {
-    auto waypoint_iterator1 = waypoint_map_.find(identifier1);
-    auto waypoint_iterator2 = waypoint_map_.find(identifier2);
-    if (waypoint_iterator1 == waypoint_map_.end() || waypoint_iterator2 == waypoint_map_.end()) {
+    auto waypoint1 = WaypointFromIdentifier(identifier1);
+    auto waypoint2 = WaypointFromIdentifier(identifier2);
+    if (waypoint1 == nullptr || waypoint2 == nullptr) {
         return;
     }
-    RemoveAirwaySegment(waypoint_iterator1->second, waypoint_iterator2->second);
+    RemoveAirwaySegment(waypoint1, waypoint2);
+}
+
+// 两个方向的航段索引对，按起点排序并去重
+static std::vector<std::pair<int32_t, int32_t>>
+SegmentIndexPairs(const IdentifierTable &identifier_table, const std::vector<SegmentRecord> &segments) {
+    std::vector<std::pair<int32_t, int32_t>> index_pairs;
+    index_pairs.reserve(segments.size() * 2);
+    for (auto &segment : segments) {
+        int32_t index1 = identifier_table.Find(segment.first);
+        int32_t index2 = identifier_table.Find(segment.second);
+        if (index1 == IdentifierTable::kNoIndex || index2 == IdentifierTable::kNoIndex || index1 == index2) {
+            continue;
+        }
+        index_pairs.push_back(std::make_pair(index1, index2));
+        index_pairs.push_back(std::make_pair(index2, index1));
+    }
+    std::sort(index_pairs.begin(), index_pairs.end());
+    index_pairs.erase(std::unique(index_pairs.begin(), index_pairs.end()), index_pairs.end());
+    return index_pairs;
+}
+
+// 删除目标被标记的邻接，目标已释放的邻接一并删除
+static void EraseMarkedNeighbors(Waypoint &waypoint, const std::vector<uint32_t> &marks, uint32_t mark) {
+    waypoint.neibors.erase(std::remove_if(waypoint.neibors.begin(), waypoint.neibors.end(), [&](const Neighbor &neib) {
+        auto target = neib.target.lock();
+        if (target == nullptr) {
+            return true;
+        }
+        return target->index >= 0 && marks[target->index] == mark;
+    }), waypoint.neibors.end());
+}
+
+void AirwayGraph::ApplyChange(const GraphChange &change) {
+    MetricsScope metrics_scope(apply_change_latency);
+    // 按航路点索引打标记，每个邻接表只扫描一遍
+    std::vector<uint32_t> marks(waypoints_.size(), 0);
+    uint32_t mark = 0;
+    // 删除航段
+    auto removed_pairs = SegmentIndexPairs(identifier_table_, change.removed_segments);
+    for (size_t begin = 0, end = 0; begin < removed_pairs.size(); begin = end) {
+        mark++;
+        for (end = begin; end < removed_pairs.size() && removed_pairs[end].first == removed_pairs[begin].first; end++) {
+            marks[removed_pairs[end].second] = mark;
+        }
+        EraseMarkedNeighbors(*waypoints_[removed_pairs[begin].first], marks, mark);
+    }
+    // 删除航路点，被替换的航路点一并删除
+    std::vector<WaypointPtr> removed_waypoints;
+    mark++;
+    auto mark_removed = [&](WaypointIdentifier identifier) {
+        int32_t index = identifier_table_.Find(identifier);
+        if (index != IdentifierTable::kNoIndex && marks[index] != mark) {
+            marks[index] = mark;
+            removed_waypoints.push_back(waypoints_[index]);
+        }
+    };
+    for (auto identifier : change.removed_waypoints) {
+        mark_removed(identifier);
+    }
+    for (auto &record : change.added_waypoints) {
+        mark_removed(record.identifier);
+    }
+    if (!removed_waypoints.empty()) {
+        uint32_t removed_mark = mark;
+        uint32_t visited_mark = ++mark;
+        for (auto &waypoint : removed_waypoints) {
+            for (auto &neibor : waypoint->neibors) {
+                auto target = neibor.target.lock();
+                if (target == nullptr || target->index < 0 ||
+                    marks[target->index] == removed_mark || marks[target->index] == visited_mark) {
+                    continue;
+                }
+                EraseMarkedNeighbors(*target, marks, removed_mark);
+                marks[target->index] = visited_mark;
+            }
+        }
+        for (auto &waypoint : removed_waypoints) {
+            waypoint->neibors.clear();
+            EraseWaypointAt(waypoint->index);
+        }
+    }
+    // 添加航路点
+    for (auto &record : change.added_waypoints) {
+        AddWaypoint(record.identifier, record.name, record.longitude, record.latitude);
+    }
+    // 添加航段，跳过已有的邻接
+    auto added_pairs = SegmentIndexPairs(identifier_table_, change.added_segments);
+    if (added_pairs.empty()) {
+        return;
+    }
+    marks.assign(waypoints_.size(), 0);
+    mark = 0;
+    for (size_t begin = 0, end = 0; begin < added_pairs.size(); begin = end) {
+        mark++;
+        Waypoint &waypoint = *waypoints_[added_pairs[begin].first];
+        for (auto &neibor : waypoint.neibors) {
+            auto target = neibor.target.lock();
+            if (target != nullptr && target->index >= 0) {
+                marks[target->index] = mark;
+            }
+        }
+        for (end = begin; end < added_pairs.size() && added_pairs[end].first == added_pairs[begin].first; end++) {
+            int32_t target_index = added_pairs[end].second;
+            if (marks[target_index] == mark) {
+                continue;
+            }
+            const WaypointPtr &target = waypoints_[target_index];
+            waypoint.neibors.push_back(Neighbor(target,
+                                                Waypoint::Distance(waypoint, *target),
+                                                Waypoint::Direction(waypoint, *target)));
+        }
+    }
 }
 
 WaypointPath
@@ -96,15 +259,17 @@ AirwayGraph::FindPath(WaypointIdentifier origin_identifier,
                       WaypointIdentifier destination_identifier,
                       const std::function<bool(const WaypointPair &,
                                                const WaypointInfoPair &,
-                                               std::vector<WaypointPtr> &)> &can_search) const {
-    auto origin_iterator = waypoint_map_.find(origin_identifier);
-    auto destination_iterator = waypoint_map_.find(destination_identifier);
-    if (origin_iterator == waypoint_map_.end() || destination_iterator == waypoint_map_.end()) {
+                                               std::vector<WaypointPtr> &)> &can_search,
+                      const std::function<GeoDistance(const WaypointPair &,
+                                                      const std::vector<WaypointPtr> &)> &penalty,
+                      SearchStats *stats) const {
+    MetricsScope metrics_scope(find_path_latency, stats);
+    auto origin_waypoint = WaypointFromIdentifier(origin_identifier);
+    auto destination_waypoint = WaypointFromIdentifier(destination_identifier);
+    if (origin_waypoint == nullptr || destination_waypoint == nullptr) {
         return WaypointPath();
     }
-    auto origin_waypoint = origin_iterator->second;
-    auto destination_waypoint = destination_iterator->second;
-    return FindPathInGraph(origin_waypoint, destination_waypoint, can_search);
+    return FindPathInGraph(origin_waypoint, destination_waypoint, can_search, penalty, stats);
 }
 
 std::vector<WaypointPath>
@@ -113,28 +278,42 @@ AirwayGraph::FindKPath(WaypointIdentifier origin_identifier,
                        int k,
                        const std::function<WaypointPath(const ConstWaypointPtr &,
                                                         const ConstWaypointPtr &,
-                                                        const std::set<WaypointPair> &)> &find_path) const {
-    auto origin_iterator = waypoint_map_.find(origin_identifier);
-    auto destination_iterator = waypoint_map_.find(destination_identifier);
-    if (origin_iterator == waypoint_map_.end() || destination_iterator == waypoint_map_.end()) {
+                                                        const std::set<WaypointPair> &)> &find_path,
+                       SearchStats *stats) const {
+    MetricsScope metrics_scope(find_k_path_latency, stats);
+    auto origin_waypoint = WaypointFromIdentifier(origin_identifier);
+    auto destination_waypoint = WaypointFromIdentifier(destination_identifier);
+    if (origin_waypoint == nullptr || destination_waypoint == nullptr) {
         return std::vector<WaypointPath>();
     }
-    auto origin_waypoint = origin_iterator->second;
-    auto destination_waypoint = destination_iterator->second;
-    return FindKPathInGraph(origin_waypoint, destination_waypoint, k, find_path);
+    if (find_path) {
+        return FindKPathInGraph(origin_waypoint, destination_waypoint, k, find_path, stats);
+    }
+    auto block_find_path = [stats](const ConstWaypointPtr &spur_waypoint,
+                                   const ConstWaypointPtr &destination_waypoint,
+                                   const std::set<WaypointPair> &block_set) {
+        auto can_search = [&block_set](const WaypointPair &p,
+                                       const WaypointInfoPair &,
+                                       std::vector<WaypointPtr> &inserted_waypoints) {
+            return block_set.find(p) == block_set.end();
+        };
+        return FindPathInGraph(spur_waypoint, destination_waypoint, can_search, nullptr, stats);
+    };
+    return FindKPathInGraph(origin_waypoint, destination_waypoint, k, block_find_path, stats);
 }
 
 bool AirwayGraph::SaveToFile(const std::string &path) const {
+    MetricsScope metrics_scope(save_latency);
     std::ofstream of(path, std::ios::binary);
     if (!of.is_open()) {
         return false;
     }
     // 序列化航路点数量
-    uint32_t n = static_cast<uint32_t>(waypoint_map_.size());
+    uint32_t n = static_cast<uint32_t>(waypoints_.size());
     of.write(reinterpret_cast<char *>(&n), sizeof(n));
     // 序列化航路点基本信息
-    for (auto &waypoint_pair : waypoint_map_) {
-        const Waypoint &waypoint = *waypoint_pair.second;
+    for (auto &waypoint_pointer : waypoints_) {
+        const Waypoint &waypoint = *waypoint_pointer;
         // 序列化ID
         uint32_t identifier = static_cast<uint32_t>(waypoint.identifier);
         of.write(reinterpret_cast<char *>(&identifier), sizeof(identifier));
@@ -143,15 +322,15 @@ bool AirwayGraph::SaveToFile(const std::string &path) const {
         of.write(reinterpret_cast<char *>(&name_size), sizeof(name_size));
         of.write(waypoint.name.c_str(), name_size);
         // 序列化经度
-        double longitude = static_cast<double>(waypoint.location.longitude);
+        double longitude = static_cast<double>(waypoint.GetLocation().longitude);
         of.write(reinterpret_cast<char *>(&longitude), sizeof(longitude));
         // 序列化纬度
-        double latitude = static_cast<double>(waypoint.location.latitude);
+        double latitude = static_cast<double>(waypoint.GetLocation().latitude);
         of.write(reinterpret_cast<char *>(&latitude), sizeof(latitude));
     }
     // 序列化航路点邻接信息
-    for (auto &waypoint_pair : waypoint_map_) {
-        const Waypoint &waypoint = *waypoint_pair.second;
+    for (auto &waypoint_pointer : waypoints_) {
+        const Waypoint &waypoint = *waypoint_pointer;
         // 序列化ID
         uint32_t identifier = static_cast<uint32_t>(waypoint.identifier);
         of.write(reinterpret_cast<char *>(&identifier), sizeof(identifier));
@@ -171,12 +350,17 @@ bool AirwayGraph::SaveToFile(const std::string &path) const {
 }
 
 bool AirwayGraph::LoadFromFile(const std::string &path) {
+    MetricsScope metrics_scope(load_latency);
     std::ifstream inf(path, std::ios::binary);
     if (!inf.is_open()) {
         return false;
     }
     uint32_t n = 0;
     inf.read(reinterpret_cast<char *>(&n), sizeof(n));
+    waypoints_.reserve(waypoints_.size() + n);
+    std::vector<Waypoint *> loaded_waypoints;
+    std::vector<double> longitude_list, latitude_list;
+    loaded_waypoints.reserve(n);
     for (int i = 0; i < n; i++) {
         auto waypoint = std::make_shared<Waypoint>();
         // 反序列化ID
@@ -194,18 +378,26 @@ bool AirwayGraph::LoadFromFile(const std::string &path) {
         // 反序列化经度
         double longitude = 0.0;
         inf.read(reinterpret_cast<char *>(&longitude), sizeof(longitude));
-        waypoint->location.longitude = static_cast<double>(longitude);
         // 反序列化纬度
         double latitude = 0.0;
         inf.read(reinterpret_cast<char *>(&latitude), sizeof(latitude));
-        waypoint->location.latitude = static_cast<double>(latitude);
-        waypoint_map_[identifier] = waypoint;
+        waypoint->SetLocation({longitude, latitude});
+        loaded_waypoints.push_back(waypoint.get());
+        longitude_list.push_back(longitude);
+        latitude_list.push_back(latitude);
+        InsertWaypoint(waypoint);
+    }
+    // 批量投影坐标，邻接的方向在加载时即可计算
+    std::vector<double> x(loaded_waypoints.size()), y(loaded_waypoints.size());
+    LonLatToMercBatch(longitude_list.data(), latitude_list.data(), x.data(), y.data(), loaded_waypoints.size());
+    for (size_t i = 0; i < loaded_waypoints.size(); i++) {
+        loaded_waypoints[i]->coordinate = {x[i], y[i]};
     }
     for (int i = 0; i < n; i++) {
         // 反序列化ID
         uint32_t identifier = 0;
         inf.read(reinterpret_cast<char *>(&identifier), sizeof(identifier));
-        WaypointPtr waypoint = waypoint_map_[static_cast<WaypointIdentifier>(identifier)];
+        WaypointPtr waypoint = WaypointFromIdentifier(static_cast<WaypointIdentifier>(identifier));
         // 反序列化邻接个数
         uint32_t neibor_size = 0;
         inf.read(reinterpret_cast<char *>(&neibor_size), sizeof(neibor_size));
@@ -216,8 +408,12 @@ bool AirwayGraph::LoadFromFile(const std::string &path) {
             // 反序列化相邻距离
             double distance = 0.0;
             inf.read(reinterpret_cast<char *>(&distance), sizeof(distance));
-            Neighbor neibor(waypoint_map_[neibor_identifier], static_cast<GeoDistance>(distance));
-            waypoint->neibors.push_back(neibor);
+            WaypointPtr neibor_waypoint = WaypointFromIdentifier(static_cast<WaypointIdentifier>(neibor_identifier));
+            if (waypoint == nullptr || neibor_waypoint == nullptr) {
+                continue;
+            }
+            waypoint->neibors.push_back(Neighbor(neibor_waypoint, static_cast<GeoDistance>(distance),
+                                                 Waypoint::Direction(*waypoint, *neibor_waypoint)));
         }
     }
     return true;
@@ -226,8 +422,7 @@ bool AirwayGraph::LoadFromFile(const std::string &path) {
 void AirwayGraph::ForEach(const std::function<void(const WaypointPtr &,
                                                    const WaypointPtr &,
                                                    GeoDistance)> &traverse_function) {
-    for (auto &pair : waypoint_map_) {
-        auto waypoint = pair.second;
+    for (auto &waypoint : waypoints_) {
         for (auto &neibor : waypoint->neibors) {
             traverse_function(waypoint, neibor.target.lock(), neibor.distance);
         }
@@ -236,24 +431,100 @@ void AirwayGraph::ForEach(const std::function<void(const WaypointPtr &,
 
 std::vector<WaypointIdentifier> AirwayGraph::AllWaypointIdentifiers() const {
     std::vector<WaypointIdentifier> all_waypoint_identifier_vector;
-    for (auto &pair : waypoint_map_) {
-        all_waypoint_identifier_vector.push_back(pair.first);
+    all_waypoint_identifier_vector.reserve(waypoints_.size());
+    for (auto &waypoint : waypoints_) {
+        all_waypoint_identifier_vector.push_back(waypoint->identifier);
     }
+    // 保持按ID升序
+    std::sort(all_waypoint_identifier_vector.begin(), all_waypoint_identifier_vector.end());
     return all_waypoint_identifier_vector;
 }
 
-WaypointPtr AirwayGraph::WaypointFromIdentifier(WaypointIdentifier identifier) const {
-    auto iterator = waypoint_map_.find(identifier);
-    if (iterator != waypoint_map_.end()) {
-        return iterator->second;
-    } else {
-        return nullptr;
+/**
+ Search state of the waypoints reused across searches. The waypoints of a graph are kept in an
+ array by their dense index and stamped with the search which last wrote them, so nothing is
+ cleared between searches. The waypoints made while searching are kept in a hash table, which
+ also keeps them alive until the path is built.
+ */
+class SearchWorkspace {
+ public:
+    void Begin() {
+        if (++generation_ == 0) {
+            std::fill(stamps_.begin(), stamps_.end(), 0);
+            generation_ = 1;
+        }
+        extra_infos_.clear();
+        touched_count_ = 0;
     }
-}
+
+    /**
+     Info of a waypoint. A reference stays valid until a waypoint of a larger index is looked up.
+     */
+    WaypointInfo &Get(const ConstWaypointPtr &waypoint) {
+        if (waypoint->index < 0) {
+            return extra_infos_[waypoint];
+        }
+        size_t index = static_cast<size_t>(waypoint->index);
+        if (index >= infos_.size()) {
+            size_t size = std::max(index + 1, infos_.size() * 2);
+            infos_.resize(size);
+            stamps_.resize(size, 0);
+        }
+        if (stamps_[index] != generation_) {
+            stamps_[index] = generation_;
+            infos_[index] = WaypointInfo();
+            touched_count_++;
+        }
+        return infos_[index];
+    }
+
+    size_t WorkspaceBytes() const {
+        return touched_count_ * (sizeof(WaypointInfo) + sizeof(uint32_t)) +
+        extra_infos_.size() * (sizeof(ConstWaypointPtr) + sizeof(WaypointInfo) + 2 * sizeof(void *));
+    }
+
+ private:
+    std::vector<WaypointInfo> infos_;
+    std::vector<uint32_t> stamps_;
+    uint32_t generation_ = 0;
+    size_t touched_count_ = 0;
+    std::unordered_map<ConstWaypointPtr, WaypointInfo> extra_infos_;
+};
+
+/**
+ Workspace of the calling thread for the duration of a search. A search started from inside
+ another one, e.g. from can_search, gets a workspace of its own.
+ */
+template <typename Workspace>
+class WorkspaceLease {
+ public:
+    WorkspaceLease() {
+        if (free_workspaces_.empty()) {
+            workspace_.reset(new Workspace());
+        } else {
+            workspace_ = std::move(free_workspaces_.back());
+            free_workspaces_.pop_back();
+        }
+        workspace_->Begin();
+    }
+
+    ~WorkspaceLease() {
+        free_workspaces_.push_back(std::move(workspace_));
+    }
+
+    Workspace &operator * () {return *workspace_;}
+
+ private:
+    static thread_local std::vector<std::unique_ptr<Workspace>> free_workspaces_;
+    std::unique_ptr<Workspace> workspace_;
+};
+
+template <typename Workspace>
+thread_local std::vector<std::unique_ptr<Workspace>> WorkspaceLease<Workspace>::free_workspaces_;
 
 static GeoDistance HeuristicDistance(const ConstWaypointPtr &waypoint1,
                                      const ConstWaypointPtr &waypoint2) {
-    return Waypoint::Distance(*waypoint1, *waypoint2) * 0.9;
+    return Waypoint::ChordDistance(*waypoint1, *waypoint2) * 0.9;
 }
 
 WaypointPath
@@ -261,37 +532,71 @@ AirwayGraph::FindPathInGraph(const ConstWaypointPtr &origin_waypoint,
                              const ConstWaypointPtr &destination_waypoint,
                              const std::function<bool(const WaypointPair &,
                                                       const WaypointInfoPair &,
-                                                      std::vector<WaypointPtr> &)> &can_search) {
+                                                      std::vector<WaypointPtr> &)> &can_search,
+                             const std::function<GeoDistance(const WaypointPair &,
+                                                             const std::vector<WaypointPtr> &)> &penalty,
+                             SearchStats *stats,
+                             const GraphOverlay *overlay) {
     WaypointPath result;
-    std::map<ConstWaypointPtr, WaypointInfo> waypoint_info_map;
-    // Init priority queue.
-    auto waypoint_compare = [&waypoint_info_map](const ConstWaypointPtr &waypoint1,
-                                                 const ConstWaypointPtr &waypoint2) {
-        auto &waypoint_info1 = waypoint_info_map[waypoint1];
-        auto &waypoint_info2 = waypoint_info_map[waypoint2];
-        return waypoint_info1.estimated_distance > waypoint_info2.estimated_distance;
+    WorkspaceLease<SearchWorkspace> lease;
+    SearchWorkspace &workspace = *lease;
+    // 入队时记录估计距离，出队时大于当前估计的为过期项
+    using QueueEntry = std::pair<GeoDistance, ConstWaypointPtr>;
+    auto waypoint_compare = [](const QueueEntry &entry1, const QueueEntry &entry2) {
+        return entry1.first > entry2.first;
     };
-    std::priority_queue<ConstWaypointPtr, std::vector<ConstWaypointPtr>,
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>,
                         decltype(waypoint_compare)> waypoint_queue(waypoint_compare);
-    auto &origin_info = waypoint_info_map[origin_waypoint];
+    auto &origin_info = workspace.Get(origin_waypoint);
     origin_info.actual_distance = 0;
     origin_info.estimated_distance = HeuristicDistance(origin_waypoint, destination_waypoint);
-    waypoint_queue.push(origin_waypoint);
+    waypoint_queue.push(QueueEntry(origin_info.estimated_distance, origin_waypoint));
+    // 仅在需要统计时记录已出队的航路点
+    std::unordered_set<const Waypoint *> settled_waypoints;
+    size_t max_queue_size = 1;
+    if (stats) {
+        stats->path_searches++;
+        stats->heap_pushes++;
+    }
     while (!waypoint_queue.empty()) {
-        ConstWaypointPtr current_waypoint = waypoint_queue.top();
-        WaypointInfo &current_info = waypoint_info_map[current_waypoint];
+        GeoDistance queued_distance = waypoint_queue.top().first;
+        ConstWaypointPtr current_waypoint = waypoint_queue.top().second;
+        if (stats) {
+            max_queue_size = std::max(max_queue_size, waypoint_queue.size());
+        }
         waypoint_queue.pop();
+        // 复制一份，查找邻居时数组可能扩容
+        const WaypointInfo current_info = workspace.Get(current_waypoint);
+        if (queued_distance > current_info.estimated_distance) {
+            if (stats) {
+                stats->stale_pops++;
+            }
+            continue;
+        }
+        if (stats) {
+            if (settled_waypoints.insert(current_waypoint.get()).second) {
+                stats->nodes_settled++;
+            } else {
+                stats->stale_pops++;
+            }
+        }
         if (current_waypoint == destination_waypoint) {
             break;
         }
-        for (auto &neibor : current_waypoint->neibors) {
+        auto relax = [&](const Neighbor &neibor) {
             WaypointPtr neibor_waypoint = neibor.target.lock();
-            WaypointInfo &neibor_info = waypoint_info_map[neibor_waypoint];
+            WaypointInfo &neibor_info = workspace.Get(neibor_waypoint);
             std::vector<WaypointPtr> inserted_waypoints;
+            if (stats) {
+                stats->can_search_calls++;
+            }
             if (!can_search(std::make_pair(current_waypoint, neibor_waypoint),
                             std::make_pair(current_info, neibor_info),
                             inserted_waypoints)) {
-                continue;
+                return;
+            }
+            if (stats) {
+                stats->inserted_waypoints += inserted_waypoints.size();
             }
             GeoDistance distance_through_current = current_info.actual_distance;
             if (inserted_waypoints.size() > 0) {
@@ -306,31 +611,60 @@ AirwayGraph::FindPathInGraph(const ConstWaypointPtr &origin_waypoint,
             } else {
                 distance_through_current += neibor.distance;
             }
+            if (penalty) {
+                distance_through_current += penalty(std::make_pair(current_waypoint, neibor_waypoint), inserted_waypoints);
+            }
             if (distance_through_current < neibor_info.actual_distance) {
                 neibor_info.actual_distance = distance_through_current;
                 if (inserted_waypoints.size() == 0) {
                     neibor_info.previous = current_waypoint;
+                    neibor_info.direction = neibor.direction;
                 } else {
+                    neibor_info.direction = Waypoint::Direction(*inserted_waypoints.back(), *neibor_waypoint);
                     ConstWaypointPtr current_inserted_waypoint = neibor_waypoint;
                     for (auto iterator = inserted_waypoints.rbegin(); iterator != inserted_waypoints.rend(); iterator++) {
-                        auto &current_inserted_info = waypoint_info_map[current_inserted_waypoint];
+                        auto &current_inserted_info = workspace.Get(current_inserted_waypoint);
                         current_inserted_info.previous = *iterator;
                         current_inserted_waypoint = current_inserted_info.previous.lock();
                     }
-                    waypoint_info_map[current_inserted_waypoint].previous = current_waypoint;
+                    workspace.Get(current_inserted_waypoint).previous = current_waypoint;
                 }
                 neibor_info.estimated_distance = neibor_info.actual_distance + HeuristicDistance(neibor_waypoint, destination_waypoint);
-                waypoint_queue.push(neibor_waypoint);
+                waypoint_queue.push(QueueEntry(neibor_info.estimated_distance, neibor_waypoint));
+                if (stats) {
+                    stats->heap_pushes++;
+                }
+            }
+        };
+        // 只有邻接改变的航路点才查询情景
+        if (overlay == nullptr || !overlay->IsChanged(*current_waypoint)) {
+            for (auto &neibor : current_waypoint->neibors) {
+                relax(neibor);
+            }
+            continue;
+        }
+        for (auto &neibor : current_waypoint->neibors) {
+            if (!overlay->IsRemoved(*current_waypoint, *neibor.target.lock())) {
+                relax(neibor);
+            }
+        }
+        if (auto added_neighbors = overlay->FindAddedNeighbors(*current_waypoint)) {
+            for (auto &neibor : *added_neighbors) {
+                relax(neibor);
             }
         }
     }
-    auto current_waypoint = destination_waypoint;
-    auto &current_info = waypoint_info_map[current_waypoint];
-    if (current_info.previous.lock() == nullptr) {
+    if (stats) {
+        stats->workspace_bytes += workspace.WorkspaceBytes() +
+                                  max_queue_size * sizeof(QueueEntry) +
+                                  settled_waypoints.size() * (sizeof(const Waypoint *) + 2 * sizeof(void *));
+    }
+    ConstWaypointPtr current_waypoint = destination_waypoint;
+    if (workspace.Get(current_waypoint).previous.lock() == nullptr) {
         return result;
     }
     while (current_waypoint != nullptr) {
-        current_info = waypoint_info_map[current_waypoint];
+        const WaypointInfo &current_info = workspace.Get(current_waypoint);
         result.waypoints.push_back(current_waypoint);
         result.lengths.push_back(current_info.actual_distance);
         current_waypoint = current_info.previous.lock();
@@ -340,55 +674,637 @@ AirwayGraph::FindPathInGraph(const ConstWaypointPtr &origin_waypoint,
     return result;
 }
 
+/**
+ Outgoing edges of the waypoints reached by a search over edges. The edges of a waypoint get a
+ block of consecutive slots when the waypoint is first expanded, found by its dense index with
+ generation stamps. Slot s is the s-th edge: states 2s and 2s + 1 arrive at its target directly
+ and through a detour.
+ */
+class EdgeSlotTable {
+ public:
+    void Begin() {
+        if (++generation_ == 0) {
+            std::fill(stamps_.begin(), stamps_.end(), 0);
+            generation_ = 1;
+        }
+        slot_blocks_.clear();
+        blocks_.clear();
+        detours_.clear();
+        extra_blocks_.clear();
+    }
+
+    /**
+     First slot of the outgoing edges of a waypoint, allocated on first use.
+     */
+    int32_t Block(const ConstWaypointPtr &waypoint) {
+        int32_t *first_slot = nullptr;
+        if (waypoint->index < 0) {
+            first_slot = &extra_blocks_.emplace(waypoint.get(), -1).first->second;
+        } else {
+            size_t index = static_cast<size_t>(waypoint->index);
+            if (index >= first_slots_.size()) {
+                size_t size = std::max(index + 1, first_slots_.size() * 2);
+                first_slots_.resize(size);
+                stamps_.resize(size, 0);
+            }
+            if (stamps_[index] != generation_) {
+                stamps_[index] = generation_;
+                first_slots_[index] = -1;
+            }
+            first_slot = &first_slots_[index];
+        }
+        if (*first_slot < 0) {
+            *first_slot = static_cast<int32_t>(slot_blocks_.size());
+            int32_t block = static_cast<int32_t>(blocks_.size());
+            blocks_.push_back(std::make_pair(waypoint, *first_slot));
+            slot_blocks_.resize(slot_blocks_.size() + waypoint->neibors.size(), block);
+        }
+        return *first_slot;
+    }
+
+    size_t GetSlotCount() const {return slot_blocks_.size();}
+
+    /**
+     Waypoint the edge of a state starts from.
+     */
+    const ConstWaypointPtr &Tail(int32_t state) const {return blocks_[slot_blocks_[state / 2]].first;}
+
+    const Neighbor &Edge(int32_t state) const {
+        auto &block = blocks_[slot_blocks_[state / 2]];
+        return block.first->neibors[state / 2 - block.second];
+    }
+
+    int32_t AddDetour(std::vector<WaypointPtr> &&inserted_waypoints) {
+        detours_.push_back(std::move(inserted_waypoints));
+        return static_cast<int32_t>(detours_.size()) - 1;
+    }
+
+    const std::vector<WaypointPtr> &Detour(int32_t detour) const {return detours_[detour];}
+
+    size_t SlotBytes() const {
+        return slot_blocks_.size() * sizeof(int32_t) +
+        blocks_.size() * (sizeof(ConstWaypointPtr) + 2 * sizeof(int32_t) + sizeof(uint32_t));
+    }
+
+ private:
+    // Block of each slot.
+    std::vector<int32_t> slot_blocks_;
+    // Waypoint and first slot of each block.
+    std::vector<std::pair<ConstWaypointPtr, int32_t>> blocks_;
+    std::vector<std::vector<WaypointPtr>> detours_;
+    // First slots by the dense index, valid when stamped with the generation.
+    std::vector<int32_t> first_slots_;
+    std::vector<uint32_t> stamps_;
+    uint32_t generation_ = 0;
+    std::unordered_map<const Waypoint *, int32_t> extra_blocks_;
+};
+
+/**
+ States of the edge search reused across searches. expanded_[s] records whether slot s was expanded.
+ */
+class EdgeSearchWorkspace : public EdgeSlotTable {
+ public:
+    struct Label {
+        GeoDistance g = std::numeric_limits<GeoDistance>::infinity();
+        GeoDistance f = std::numeric_limits<GeoDistance>::infinity();
+        // Previous state, -1 for the origin.
+        int32_t parent = -1;
+        // Index in the detours for a state arriving through a detour.
+        int32_t detour = -1;
+        GeoProj direction = kNoDirection;
+    };
+
+    void Begin() {
+        EdgeSlotTable::Begin();
+        labels_.clear();
+        expanded_.clear();
+    }
+
+    int32_t Block(const ConstWaypointPtr &waypoint) {
+        int32_t first_slot = EdgeSlotTable::Block(waypoint);
+        if (expanded_.size() < GetSlotCount()) {
+            labels_.resize(GetSlotCount() * 2);
+            expanded_.resize(GetSlotCount(), 0);
+        }
+        return first_slot;
+    }
+
+    Label &GetLabel(int32_t state) {return labels_[state];}
+
+    bool IsExpanded(int32_t slot) const {return expanded_[slot] != 0;}
+
+    void SetExpanded(int32_t slot) {expanded_[slot] = 1;}
+
+    size_t WorkspaceBytes() const {
+        return labels_.size() * sizeof(Label) + expanded_.size() * sizeof(uint8_t) + SlotBytes();
+    }
+
+ private:
+    std::vector<Label> labels_;
+    std::vector<uint8_t> expanded_;
+};
+
+WaypointPath
+AirwayGraph::FindEdgePathInGraph(const ConstWaypointPtr &origin_waypoint,
+                                 const ConstWaypointPtr &destination_waypoint,
+                                 const std::function<bool(const WaypointPair &,
+                                                          const WaypointInfoPair &,
+                                                          std::vector<WaypointPtr> &)> &can_search,
+                                 const std::function<GeoDistance(const WaypointPair &,
+                                                                 const std::vector<WaypointPtr> &)> &penalty,
+                                 SearchStats *stats) {
+    using Label = EdgeSearchWorkspace::Label;
+    const int32_t kOriginState = -1;
+    WaypointPath result;
+    WorkspaceLease<EdgeSearchWorkspace> lease;
+    EdgeSearchWorkspace &workspace = *lease;
+    Label origin_label;
+    origin_label.g = 0;
+    origin_label.f = HeuristicDistance(origin_waypoint, destination_waypoint);
+    // 入队时记录估计距离，出队时大于当前估计的为过期项
+    using QueueEntry = std::pair<GeoDistance, int32_t>;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> state_queue;
+    state_queue.push(QueueEntry(origin_label.f, kOriginState));
+    size_t max_queue_size = 1;
+    if (stats) {
+        stats->path_searches++;
+        stats->heap_pushes++;
+    }
+    int32_t destination_state = kOriginState;
+    bool found = false;
+    std::vector<WaypointPtr> inserted_waypoints;
+    while (!state_queue.empty()) {
+        QueueEntry entry = state_queue.top();
+        if (stats) {
+            max_queue_size = std::max(max_queue_size, state_queue.size());
+        }
+        state_queue.pop();
+        int32_t state = entry.second;
+        // 复制一份，展开时数组可能扩容
+        const Label label = state == kOriginState ? origin_label : workspace.GetLabel(state);
+        if (entry.first > label.f) {
+            if (stats) {
+                stats->stale_pops++;
+            }
+            continue;
+        }
+        if (stats) {
+            stats->nodes_settled++;
+        }
+        ConstWaypointPtr current_waypoint = state == kOriginState ? origin_waypoint : workspace.Edge(state).target.lock();
+        if (current_waypoint == destination_waypoint) {
+            destination_state = state;
+            found = true;
+            break;
+        }
+        WaypointInfo current_info;
+        if (state != kOriginState) {
+            current_info.previous = label.detour >= 0 ? workspace.Detour(label.detour).back() : workspace.Tail(state);
+        }
+        current_info.direction = label.direction;
+        current_info.actual_distance = label.g;
+        current_info.estimated_distance = label.f;
+        int32_t first_slot = workspace.Block(current_waypoint);
+        for (int32_t j = 0; j < static_cast<int32_t>(current_waypoint->neibors.size()); j++) {
+            int32_t slot = first_slot + j;
+            // 同一航路点上更短的状态已展开过这条边，直接到达的后继不会更优
+            if (workspace.IsExpanded(slot)) {
+                if (stats) {
+                    stats->dominated_edges++;
+                }
+                continue;
+            }
+            const Neighbor &neibor = current_waypoint->neibors[j];
+            WaypointPtr neibor_waypoint = neibor.target.lock();
+            inserted_waypoints.clear();
+            if (stats) {
+                stats->can_search_calls++;
+            }
+            if (!can_search(std::make_pair(current_waypoint, neibor_waypoint),
+                            std::make_pair(current_info, WaypointInfo()),
+                            inserted_waypoints)) {
+                continue;
+            }
+            workspace.SetExpanded(slot);
+            if (stats) {
+                stats->inserted_waypoints += inserted_waypoints.size();
+            }
+            GeoDistance distance_through_current = label.g;
+            if (inserted_waypoints.size() > 0) {
+                const Waypoint *leg_start = current_waypoint.get();
+                for (auto &inserted_waypoint : inserted_waypoints) {
+                    distance_through_current += Waypoint::Distance(*leg_start, *inserted_waypoint);
+                    leg_start = inserted_waypoint.get();
+                }
+                distance_through_current += Waypoint::Distance(*leg_start, *neibor_waypoint);
+            } else {
+                distance_through_current += neibor.distance;
+            }
+            if (penalty) {
+                distance_through_current += penalty(std::make_pair(current_waypoint, neibor_waypoint), inserted_waypoints);
+            }
+            int32_t next_state = slot * 2 + (inserted_waypoints.empty() ? 0 : 1);
+            Label &next_label = workspace.GetLabel(next_state);
+            if (distance_through_current >= next_label.g) {
+                continue;
+            }
+            next_label.g = distance_through_current;
+            next_label.f = distance_through_current + HeuristicDistance(neibor_waypoint, destination_waypoint);
+            next_label.parent = state;
+            if (inserted_waypoints.empty()) {
+                next_label.direction = neibor.direction;
+                next_label.detour = -1;
+            } else {
+                next_label.direction = Waypoint::Direction(*inserted_waypoints.back(), *neibor_waypoint);
+                next_label.detour = workspace.AddDetour(std::move(inserted_waypoints));
+                inserted_waypoints = std::vector<WaypointPtr>();
+            }
+            state_queue.push(QueueEntry(next_label.f, next_state));
+            if (stats) {
+                stats->heap_pushes++;
+            }
+        }
+    }
+    if (stats) {
+        stats->workspace_bytes += workspace.WorkspaceBytes() + max_queue_size * sizeof(QueueEntry);
+    }
+    if (!found || destination_state == kOriginState) {
+        return result;
+    }
+    std::vector<int32_t> states;
+    for (int32_t state = destination_state; state != kOriginState; state = workspace.GetLabel(state).parent) {
+        states.push_back(state);
+    }
+    result.waypoints.push_back(origin_waypoint);
+    result.lengths.push_back(0);
+    for (auto iterator = states.rbegin(); iterator != states.rend(); iterator++) {
+        const Label &label = workspace.GetLabel(*iterator);
+        if (label.detour >= 0) {
+            // 绕行点的长度按实际距离累加
+            GeoDistance length = result.lengths.back();
+            for (auto &inserted_waypoint : workspace.Detour(label.detour)) {
+                length += Waypoint::Distance(*result.waypoints.back(), *inserted_waypoint);
+                result.waypoints.push_back(inserted_waypoint);
+                result.lengths.push_back(length);
+            }
+        }
+        result.waypoints.push_back(workspace.Edge(*iterator).target.lock());
+        result.lengths.push_back(label.g);
+    }
+    return result;
+}
+
+/**
+ Labels of the Pareto search reused across searches. Labels are appended to one arena and refer
+ to their parents by index. Each state keeps the smallest turn of its settled labels, which are
+ settled in order of distance, and the transitions to the edges of its waypoint, tested by
+ can_search once for the state.
+ */
+class ParetoSearchWorkspace : public EdgeSlotTable {
+ public:
+    struct Label {
+        GeoDistance g;
+        double turn;
+        GeoDistance f;
+        // Previous label, -1 for the origin.
+        int32_t parent;
+        // -1 for the origin.
+        int32_t state;
+        int32_t detour;
+        GeoProj direction;
+    };
+
+    struct Transition {
+        bool accepted;
+        GeoDistance distance;
+        // Direction leaving the waypoint and arriving at the target.
+        GeoProj departure_direction;
+        GeoProj arrival_direction;
+        // Turn at the detour points.
+        double detour_turn;
+        int32_t detour;
+    };
+
+    void Begin() {
+        EdgeSlotTable::Begin();
+        labels_.clear();
+        front_turns_.clear();
+        transition_offsets_.clear();
+        transitions_.clear();
+        origin_front_turn_ = std::numeric_limits<double>::infinity();
+        origin_transition_offset_ = -1;
+    }
+
+    int32_t Block(const ConstWaypointPtr &waypoint) {
+        int32_t first_slot = EdgeSlotTable::Block(waypoint);
+        if (front_turns_.size() < GetSlotCount() * 2) {
+            front_turns_.resize(GetSlotCount() * 2, std::numeric_limits<double>::infinity());
+            transition_offsets_.resize(GetSlotCount() * 2, -1);
+        }
+        return first_slot;
+    }
+
+    int32_t AddLabel(const Label &label) {
+        labels_.push_back(label);
+        return static_cast<int32_t>(labels_.size()) - 1;
+    }
+
+    const Label &GetLabel(int32_t label) const {return labels_[label];}
+
+    /**
+     Smallest turn of the settled labels of a state.
+     */
+    double &FrontTurn(int32_t state) {return state < 0 ? origin_front_turn_ : front_turns_[state];}
+
+    /**
+     First transition of a state, -1 when its transitions are not tested yet.
+     */
+    int32_t &TransitionOffset(int32_t state) {return state < 0 ? origin_transition_offset_ : transition_offsets_[state];}
+
+    std::vector<Transition> &Transitions() {return transitions_;}
+
+    size_t WorkspaceBytes() const {
+        return labels_.size() * sizeof(Label) + front_turns_.size() * (sizeof(double) + sizeof(int32_t)) +
+        transitions_.size() * sizeof(Transition) + SlotBytes();
+    }
+
+ private:
+    std::vector<Label> labels_;
+    std::vector<double> front_turns_;
+    std::vector<int32_t> transition_offsets_;
+    std::vector<Transition> transitions_;
+    double origin_front_turn_;
+    int32_t origin_transition_offset_;
+};
+
+// 同向转弯的转角之和只取决于首尾方向，不同路径常常相等，舍入误差内的视为相等
+static const double kTurnTolerance = 1e-9;
+
+static double TurnAngle(const GeoProj &arriving_direction, const GeoProj &leaving_direction) {
+    if (arriving_direction == kNoDirection || leaving_direction == kNoDirection) {
+        return 0;
+    }
+    double cos_turn = arriving_direction.x * leaving_direction.x + arriving_direction.y * leaving_direction.y;
+    return acos(std::max(-1.0, std::min(cos_turn, 1.0)));
+}
+
+std::vector<WaypointPath>
+AirwayGraph::FindParetoPathInGraph(const ConstWaypointPtr &origin_waypoint,
+                                   const ConstWaypointPtr &destination_waypoint,
+                                   const std::function<bool(const WaypointPair &,
+                                                            const WaypointInfoPair &,
+                                                            std::vector<WaypointPtr> &)> &can_search,
+                                   double turn_epsilon,
+                                   const std::function<GeoDistance(const WaypointPair &,
+                                                                   const std::vector<WaypointPtr> &)> &penalty,
+                                   SearchStats *stats) {
+    if (turn_epsilon < 0) {
+        throw std::invalid_argument("negative turn epsilon");
+    }
+    using Label = ParetoSearchWorkspace::Label;
+    using Transition = ParetoSearchWorkspace::Transition;
+    const int32_t kOriginState = -1;
+    std::vector<WaypointPath> result;
+    WorkspaceLease<ParetoSearchWorkspace> lease;
+    ParetoSearchWorkspace &workspace = *lease;
+    std::vector<Transition> &transitions = workspace.Transitions();
+    // 按估计距离、转角出队，同一状态的标签按距离递增定型
+    using QueueEntry = std::tuple<GeoDistance, double, int32_t>;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> label_queue;
+    Label origin_label = {0, 0, HeuristicDistance(origin_waypoint, destination_waypoint), -1, kOriginState, -1, kNoDirection};
+    label_queue.push(QueueEntry(origin_label.f, 0, workspace.AddLabel(origin_label)));
+    size_t max_queue_size = 1;
+    if (stats) {
+        stats->path_searches++;
+        stats->heap_pushes++;
+    }
+    std::vector<int32_t> destination_labels;
+    double destination_turn = std::numeric_limits<double>::infinity();
+    std::vector<WaypointPtr> inserted_waypoints;
+    while (!label_queue.empty()) {
+        if (stats) {
+            max_queue_size = std::max(max_queue_size, label_queue.size());
+        }
+        int32_t label_index = std::get<2>(label_queue.top());
+        label_queue.pop();
+        // 复制一份，扩展时标签池可能扩容
+        const Label label = workspace.GetLabel(label_index);
+        // 已定型的标签距离不大于当前标签，转角也不大于时当前标签被支配
+        if (label.turn + kTurnTolerance >= std::min(destination_turn - turn_epsilon, workspace.FrontTurn(label.state))) {
+            if (stats) {
+                stats->dominated_labels++;
+            }
+            continue;
+        }
+        workspace.FrontTurn(label.state) = label.turn;
+        if (stats) {
+            stats->nodes_settled++;
+        }
+        ConstWaypointPtr current_waypoint = label.state == kOriginState ? origin_waypoint : workspace.Edge(label.state).target.lock();
+        if (current_waypoint == destination_waypoint) {
+            destination_labels.push_back(label_index);
+            destination_turn = label.turn;
+            continue;
+        }
+        int32_t first_slot = workspace.Block(current_waypoint);
+        int32_t neibor_count = static_cast<int32_t>(current_waypoint->neibors.size());
+        if (workspace.TransitionOffset(label.state) < 0) {
+            // 同一状态的到达方向相同，可行性和绕行只需判断一次
+            workspace.TransitionOffset(label.state) = static_cast<int32_t>(transitions.size());
+            WaypointInfo current_info;
+            if (label.state != kOriginState) {
+                current_info.previous = label.detour >= 0 ? workspace.Detour(label.detour).back() : workspace.Tail(label.state);
+            }
+            current_info.direction = label.direction;
+            current_info.actual_distance = label.g;
+            current_info.estimated_distance = label.f;
+            for (int32_t j = 0; j < neibor_count; j++) {
+                const Neighbor &neibor = current_waypoint->neibors[j];
+                WaypointPtr neibor_waypoint = neibor.target.lock();
+                Transition transition = {false, neibor.distance, neibor.direction, neibor.direction, 0, -1};
+                inserted_waypoints.clear();
+                if (stats) {
+                    stats->can_search_calls++;
+                }
+                if (can_search(std::make_pair(current_waypoint, neibor_waypoint),
+                               std::make_pair(current_info, WaypointInfo()),
+                               inserted_waypoints)) {
+                    transition.accepted = true;
+                    if (stats) {
+                        stats->inserted_waypoints += inserted_waypoints.size();
+                    }
+                    if (inserted_waypoints.size() > 0) {
+                        transition.distance = 0;
+                        const Waypoint *leg_start = current_waypoint.get();
+                        GeoProj leg_direction = kNoDirection;
+                        for (int k = 0; k <= inserted_waypoints.size(); k++) {
+                            const Waypoint &leg_end = k < inserted_waypoints.size() ? *inserted_waypoints[k] : *neibor_waypoint;
+                            GeoProj direction = Waypoint::Direction(*leg_start, leg_end);
+                            if (k == 0) {
+                                transition.departure_direction = direction;
+                            } else {
+                                transition.detour_turn += TurnAngle(leg_direction, direction);
+                            }
+                            transition.distance += Waypoint::Distance(*leg_start, leg_end);
+                            leg_direction = direction;
+                            leg_start = &leg_end;
+                        }
+                        transition.arrival_direction = leg_direction;
+                    }
+                    if (penalty) {
+                        transition.distance += penalty(std::make_pair(current_waypoint, neibor_waypoint), inserted_waypoints);
+                    }
+                    if (inserted_waypoints.size() > 0) {
+                        transition.detour = workspace.AddDetour(std::move(inserted_waypoints));
+                        inserted_waypoints = std::vector<WaypointPtr>();
+                    }
+                }
+                transitions.push_back(transition);
+            }
+        }
+        int32_t transition_offset = workspace.TransitionOffset(label.state);
+        for (int32_t j = 0; j < neibor_count; j++) {
+            const Transition &transition = transitions[transition_offset + j];
+            if (!transition.accepted) {
+                continue;
+            }
+            Label next_label;
+            next_label.g = label.g + transition.distance;
+            next_label.turn = label.turn + TurnAngle(label.direction, transition.departure_direction) + transition.detour_turn;
+            next_label.state = (first_slot + j) * 2 + (transition.detour >= 0 ? 1 : 0);
+            if (next_label.turn + kTurnTolerance >= std::min(destination_turn - turn_epsilon, workspace.FrontTurn(next_label.state))) {
+                if (stats) {
+                    stats->dominated_labels++;
+                }
+                continue;
+            }
+            WaypointPtr neibor_waypoint = current_waypoint->neibors[j].target.lock();
+            next_label.f = next_label.g + HeuristicDistance(neibor_waypoint, destination_waypoint);
+            next_label.parent = label_index;
+            next_label.detour = transition.detour;
+            next_label.direction = transition.arrival_direction;
+            label_queue.push(QueueEntry(next_label.f, next_label.turn, workspace.AddLabel(next_label)));
+            if (stats) {
+                stats->heap_pushes++;
+            }
+        }
+    }
+    if (stats) {
+        stats->workspace_bytes += workspace.WorkspaceBytes() + max_queue_size * sizeof(QueueEntry);
+    }
+    std::vector<int32_t> labels;
+    for (int32_t destination_label : destination_labels) {
+        labels.clear();
+        for (int32_t label = destination_label; workspace.GetLabel(label).state != kOriginState; label = workspace.GetLabel(label).parent) {
+            labels.push_back(label);
+        }
+        WaypointPath path;
+        path.waypoints.push_back(origin_waypoint);
+        path.lengths.push_back(0);
+        for (auto iterator = labels.rbegin(); iterator != labels.rend(); iterator++) {
+            const Label &label = workspace.GetLabel(*iterator);
+            if (label.detour >= 0) {
+                GeoDistance length = path.lengths.back();
+                for (auto &inserted_waypoint : workspace.Detour(label.detour)) {
+                    length += Waypoint::Distance(*path.waypoints.back(), *inserted_waypoint);
+                    path.waypoints.push_back(inserted_waypoint);
+                    path.lengths.push_back(length);
+                }
+            }
+            path.waypoints.push_back(workspace.Edge(label.state).target.lock());
+            path.lengths.push_back(label.g);
+        }
+        result.push_back(std::move(path));
+    }
+    return result;
+}
+
 std::vector<WaypointPath>
 AirwayGraph::FindKPathInGraph(const ConstWaypointPtr &origin_waypoint,
                  const ConstWaypointPtr &destination_waypoint,
                  int k,
                  const std::function<WaypointPath(const ConstWaypointPtr &,
                                                   const ConstWaypointPtr &,
-                                                  const std::set<WaypointPair> &)> &find_path) {
+                                                  const std::set<WaypointPair> &)> &find_path,
+                 SearchStats *stats) {
     std::vector<WaypointPath> result;
-    auto path_compare = [](const WaypointPath &path1, const WaypointPath &path2) {
-        return path1.lengths.back() > path2.lengths.back();
-    };
-    std::priority_queue<WaypointPath,
-                        std::vector<WaypointPath>,
-                        decltype(path_compare)> path_queue(path_compare);
     WaypointPath init_path = find_path(origin_waypoint,
                                        destination_waypoint,
                                        std::set<WaypointPair>());
     if (init_path.waypoints.size() == 0) {
         return result;
     }
-    result.push_back(std::move(init_path));
+    // 候选路径以紧凑形式保存，返回前再还原
+    std::vector<ConstWaypointPtr> waypoint_table;
+    std::vector<CompactPath> paths;
+    paths.push_back(CompactPath(init_path, waypoint_table));
+    auto path_compare = [](const CompactPath &path1, const CompactPath &path2) {
+        return path1.GetLength() > path2.GetLength();
+    };
+    std::vector<CompactPath> path_heap;
     for (int kk = 1; kk < k; kk++) {
-        for (int i = 0; i < result[kk - 1].GetSize() - 1; i++) {
-            std::set<WaypointPair> removed_edges;
-            auto spur_waypoint = result[kk - 1].waypoints[i];
-            WaypointPath root_path = WaypointPath(result[kk - 1], 0, i + 1);
-            for (auto &path : result) {
-                if (std::equal(root_path.waypoints.begin(), root_path.waypoints.end(), path.waypoints.begin())) {
-                    removed_edges.insert(std::make_pair(path.waypoints[i], path.waypoints[i + 1]));
+        const CompactPath &last_path = paths[kk - 1];
+        // 路径不重复经过航路点时，根路径每次只多一个节点，删除的边增量维护
+        std::set<const Waypoint *> path_waypoints;
+        for (int i = 0; i < last_path.GetSize(); i++) {
+            path_waypoints.insert(last_path.WaypointAt(i, waypoint_table).get());
+        }
+        bool incremental = path_waypoints.size() == last_path.GetSize();
+        std::set<WaypointPair> removed_edges;
+        std::vector<WaypointPair> spur_edges;
+        auto insert_neighbor_edges = [&](const ConstWaypointPtr &root_path_node) {
+            for (auto &neibor : root_path_node->neibors) {
+                removed_edges.insert(std::make_pair(root_path_node, neibor.target.lock()));
+            }
+        };
+        for (int i = 0; i < last_path.GetSize() - 1; i++) {
+            auto &spur_waypoint = last_path.WaypointAt(i, waypoint_table);
+            if (incremental) {
+                for (auto &edge : spur_edges) {
+                    removed_edges.erase(edge);
+                }
+                if (i > 0) {
+                    insert_neighbor_edges(last_path.WaypointAt(i - 1, waypoint_table));
+                }
+            } else {
+                removed_edges.clear();
+                for (int j = 0; j <= i; j++) {
+                    auto &root_path_node = last_path.WaypointAt(j, waypoint_table);
+                    if (root_path_node != spur_waypoint) {
+                        insert_neighbor_edges(root_path_node);
+                    }
                 }
             }
-            for (auto &root_path_node : root_path.waypoints) {
-                if (root_path_node != spur_waypoint) {
-                    for (auto &neibor : root_path_node->neibors) {
-                        removed_edges.insert(std::make_pair(root_path_node, neibor.target.lock()));
+            spur_edges.clear();
+            for (auto &path : paths) {
+                if (path.GetSize() > i + 1 && path.HasSamePrefix(last_path, i + 1)) {
+                    auto edge = std::make_pair(path.WaypointAt(i, waypoint_table), path.WaypointAt(i + 1, waypoint_table));
+                    if (removed_edges.insert(edge).second) {
+                        spur_edges.push_back(std::move(edge));
                     }
                 }
             }
+            if (stats) {
+                stats->spur_searches++;
+            }
             auto spur_path = find_path(spur_waypoint, destination_waypoint, removed_edges);
             if (spur_path.GetSize() > 0) {
-                WaypointPath total_path = root_path + spur_path;
-                path_queue.push(std::move(total_path));
+                CompactPath total_path(last_path, i + 1);
+                total_path.Append(CompactPath(spur_path, waypoint_table));
+                path_heap.push_back(std::move(total_path));
+                std::push_heap(path_heap.begin(), path_heap.end(), path_compare);
             }
         }
-        if (path_queue.empty()) {
+        if (path_heap.empty()) {
             break;
         }
-        result.push_back(std::move(path_queue.top()));
-        path_queue.pop();
+        std::pop_heap(path_heap.begin(), path_heap.end(), path_compare);
+        paths.push_back(std::move(path_heap.back()));
+        path_heap.pop_back();
+    }
+    result.reserve(paths.size());
+    for (auto &path : paths) {
+        result.push_back(path.Materialize(waypoint_table));
     }
     return result;
 }
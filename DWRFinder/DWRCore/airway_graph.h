@@ -18,21 +18,52 @@
 #include <set>
 
 #include "airway_type.h"
+#include "identifier_table.h"
+#include "search_stats.h"
 
 namespace dwr {
 
 using WaypointPair = std::pair<ConstWaypointPtr, ConstWaypointPtr>;
 using WaypointInfoPair = std::pair<const WaypointInfo, const WaypointInfo>;
 
+/**
+ Waypoint of a bulk import or change.
+ */
+struct WaypointRecord {
+    WaypointIdentifier identifier;
+    std::string name;
+    GeoRad longitude;
+    GeoRad latitude;
+};
+
+/**
+ Undirected segment between two waypoint identifiers.
+ */
+using SegmentRecord = std::pair<WaypointIdentifier, WaypointIdentifier>;
+
+/**
+ Changes applied together by AirwayGraph::ApplyChange, in the order of the members.
+ */
+struct GraphChange {
+    std::vector<SegmentRecord> removed_segments;
+    std::vector<WaypointIdentifier> removed_waypoints;
+    // A waypoint whose identifier is in the graph replaces it, and the segments of the old one are removed.
+    std::vector<WaypointRecord> added_waypoints;
+    std::vector<SegmentRecord> added_segments;
+};
+
 class AirwayGraph;
+struct GraphOverlay;
 
 class AirwayGraph {
+    friend class GraphBuilder;
  public:
     AirwayGraph() = default;
 
     AirwayGraph(const char *path);
 
-    AirwayGraph(const AirwayGraph &other);
+    // Waypoints are linked by pointers, so a copy is not supported. Use GraphScenario for what-if changes.
+    AirwayGraph(const AirwayGraph &other) = delete;
 
     /**
      Add a waypoint to the graph.
@@ -90,12 +121,24 @@ class AirwayGraph {
      */
     void RemoveAirwaySegment(WaypointIdentifier identifier1, WaypointIdentifier identifier2);
 
+    /**
+     Apply a change set in time linear in the change and the degrees of the waypoints it
+     touches. Each neighbour list is scanned once, instead of once per removed or added segment.
+     Segments with an unknown waypoint are ignored. State derived from the segments, e.g. that of
+     DynamicRadarAirwayGraph::Build, has to be built again.
+
+     @param change Segments and waypoints to remove and add.
+     */
+    void ApplyChange(const GraphChange &change);
+
     /**
      Get the path using A* algorithm.
      
      @param origin_identifier Origin waypoint ID
      @param destination_identifier Destination waypoint ID
      @param can_search The function using to determine whether the edge can be access.
+     @param penalty The function giving the extra cost of an accessible edge, nullptr for none.
+     @param stats Counters of the search are added to it, nullptr for none.
      @return The shortest path.
      */
     WaypointPath
@@ -103,7 +146,10 @@ class AirwayGraph {
              WaypointIdentifier destination_identifier,
              const std::function<bool(const WaypointPair &, const WaypointInfoPair &, std::vector<WaypointPtr> &)> &can_search
              = [](const WaypointPair &, const WaypointInfoPair &,
-                  std::vector<WaypointPtr> &inserted_waypoints) {return true;}) const;
+                  std::vector<WaypointPtr> &inserted_waypoints) {return true;},
+             const std::function<GeoDistance(const WaypointPair &, const std::vector<WaypointPtr> &)> &penalty
+             = nullptr,
+             SearchStats *stats = nullptr) const;
 
     /**
      Get k shortest paths using Yen's algorithm.
@@ -111,7 +157,8 @@ class AirwayGraph {
      @param origin_identifier Origin waypoint identifier
      @param destination_identifier Destination waypoint identifier
      @param k Number of paths.
-     @param find_path The function using to find a single path.
+     @param find_path The function using to find a single path, nullptr for A* avoiding the block set.
+     @param stats Counters of the searches are added to it, nullptr for none.
      @return The vector of shortest path.
      */
     std::vector<WaypointPath>
@@ -120,16 +167,9 @@ class AirwayGraph {
               int k,
               const std::function<WaypointPath(const ConstWaypointPtr &spur_waypoint,
                                                const ConstWaypointPtr &destination_waypoint,
-                                               const std::set<WaypointPair> &block_set)> &find_path
-              = [](const ConstWaypointPtr &spur_waypoint,
-                   const ConstWaypointPtr &destination_waypoint,
-                   const std::set<WaypointPair> &block_set) {
-                  return dwr::AirwayGraph::FindPathInGraph(spur_waypoint,
-                                                           destination_waypoint,
-                                                           [block_set](const WaypointPair &p,
-                                                                       const WaypointInfoPair &,
-                                                                       std::vector<WaypointPtr> &inserted_waypoints) {return block_set.find(p) == block_set.end();});
-              }) const;
+                                               const std::set<WaypointPair> &block_set)> &find_path = nullptr,
+              SearchStats *stats = nullptr) const;
+
     /**
      Save the graph as a file.
      
@@ -163,18 +203,82 @@ class AirwayGraph {
     std::vector<WaypointIdentifier> AllWaypointIdentifiers() const;
 
     /**
-     Get waypoint from waypoint ID.
+     Get waypoint from waypoint ID in constant time.
      
      @param identifier Waypoint ID.
-     @return Waypoint pointer.
+     @return Waypoint pointer, nullptr when not found.
      */
-    WaypointPtr WaypointFromIdentifier(WaypointIdentifier identifier) const;
+    WaypointPtr WaypointFromIdentifier(WaypointIdentifier identifier) const {
+        int32_t index = identifier_table_.Find(identifier);
+        return index != IdentifierTable::kNoIndex ? waypoints_[index] : nullptr;
+    }
+
+    size_t GetWaypointCount() const {return waypoints_.size();}
+
+    /**
+     A* search from a waypoint.
 
+     @param overlay Edges added and removed on top of the neighbour lists, nullptr for none.
+     @return The shortest path.
+     */
     static WaypointPath
     FindPathInGraph(const ConstWaypointPtr &origin_waypoint,
                     const ConstWaypointPtr &destination_waypoint,
                     const std::function<bool(const WaypointPair &waypoint_pair, const WaypointInfoPair &info_pair,
-                                             std::vector<WaypointPtr> &inserted_waypoints)> &can_search);
+                                             std::vector<WaypointPtr> &inserted_waypoints)> &can_search,
+                    const std::function<GeoDistance(const WaypointPair &waypoint_pair,
+                                                    const std::vector<WaypointPtr> &inserted_waypoints)> &penalty
+                    = nullptr,
+                    SearchStats *stats = nullptr,
+                    const GraphOverlay *overlay = nullptr);
+
+    /**
+     A* search over the arriving edges instead of the waypoints. Each edge into a waypoint keeps
+     its own label, and a label through a detour over the edge another one, so can_search sees
+     the previous waypoint and direction of the arrival it is called for. A turn limit checked in
+     can_search is exact: an arrival that is a little longer but allows a later turn is kept.
+     A state does not expand an edge already expanded from its waypoint by a state not longer
+     than it; this keeps the search close to the size of FindPathInGraph, and of the detours over
+     a blocked edge keeps only those of the first state expanding it. The overlay of a scenario
+     is not supported.
+
+     @return The shortest path, with info_pair.second of can_search left default.
+     */
+    static WaypointPath
+    FindEdgePathInGraph(const ConstWaypointPtr &origin_waypoint,
+                        const ConstWaypointPtr &destination_waypoint,
+                        const std::function<bool(const WaypointPair &waypoint_pair, const WaypointInfoPair &info_pair,
+                                                 std::vector<WaypointPtr> &inserted_waypoints)> &can_search,
+                        const std::function<GeoDistance(const WaypointPair &waypoint_pair,
+                                                        const std::vector<WaypointPtr> &inserted_waypoints)> &penalty
+                        = nullptr,
+                        SearchStats *stats = nullptr);
+
+    /**
+     Bi-objective label-setting search over the distance and the sum of the turn angles, the
+     route property measured by WaypointPath::GetSumTurn. Labels are kept per arriving edge as in
+     FindEdgePathInGraph, and a label is dropped when a label of its edge, or of the destination,
+     is not longer and turns no more. can_search is called once per arriving edge and outgoing
+     edge, with the info of the first label expanding the arriving edge. Labels arriving through
+     different detours over the same edge share one front, so the front is exact when the
+     detours do not depend on the arriving direction.
+
+     @param turn_epsilon Turn in radians a route of the front may exceed another one by and still drop it. 0 keeps
+     the whole front; a larger value bounds the front to about the turn range divided by it, and each route of the
+     exact front is then matched by a returned route not longer and turning at most turn_epsilon more.
+     @return The front sorted by distance, so the first route is the shortest one and the last turns least.
+     @throw std::invalid_argument When turn_epsilon is negative.
+     */
+    static std::vector<WaypointPath>
+    FindParetoPathInGraph(const ConstWaypointPtr &origin_waypoint,
+                          const ConstWaypointPtr &destination_waypoint,
+                          const std::function<bool(const WaypointPair &waypoint_pair, const WaypointInfoPair &info_pair,
+                                                   std::vector<WaypointPtr> &inserted_waypoints)> &can_search,
+                          double turn_epsilon = 0,
+                          const std::function<GeoDistance(const WaypointPair &waypoint_pair,
+                                                          const std::vector<WaypointPtr> &inserted_waypoints)> &penalty
+                          = nullptr,
+                          SearchStats *stats = nullptr);
 
     static std::vector<WaypointPath>
     FindKPathInGraph(const ConstWaypointPtr &origin_waypoint,
@@ -182,10 +286,18 @@ class AirwayGraph {
                      int k,
                      const std::function<WaypointPath(const ConstWaypointPtr &spur_waypoint,
                                                       const ConstWaypointPtr &destination_waypoint,
-                                                      const std::set<WaypointPair> &block_set)> &find_path);
+                                                      const std::set<WaypointPair> &block_set)> &find_path,
+                     SearchStats *stats = nullptr);
 
  protected:
-    std::map<WaypointIdentifier, WaypointPtr> waypoint_map_;
+    // Waypoints by their dense index, see Waypoint::index.
+    std::vector<WaypointPtr> waypoints_;
+    IdentifierTable identifier_table_;
+
+    void InsertWaypoint(const WaypointPtr &waypoint);
+
+    // Remove the waypoint at an index, moving the last one into its place. Its segments are kept.
+    void EraseWaypointAt(int32_t index);
 };
 
 }  // namespace dwr
@@ -8,19 +8,28 @@
 
 #include "airway_type.h"
 
+#include <algorithm>
 #include <cmath>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
 
 namespace dwr {
 
+const double kRadToDeg = 57.29577951308232;
+
+GeoVector Waypoint::UnitVector(const GeoPoint &location) {
+    double cos_latitude = cos(location.latitude);
+    return {cos_latitude * cos(location.longitude), cos_latitude * sin(location.longitude), sin(location.latitude)};
+}
+
 GeoDistance Waypoint::Distance(const dwr::Waypoint &p1,
                                const dwr::Waypoint &p2) {
-    double FI1 = p1.location.latitude;
-    double FI2 = p2.location.latitude;
-    double deltFI = FI2 - FI1;
-    double deltLamda = p2.location.longitude - p1.location.longitude;
-    double a = sin(deltFI/2) * sin(deltFI/2) + cos(FI1)*cos(FI2) * sin(deltLamda/2) * sin(deltLamda/2);
-    double c = 2 * atan2(sqrt(a), sqrt(1-a));
-    return kEarthRadius * c;
+    // 弦长为2sin(c/2)，与半正矢公式相同而只需一次反三角函数
+    double half_chord = ChordDistance(p1, p2) / (2 * kEarthRadius);
+    return kEarthRadius * 2 * asin(std::min(half_chord, 1.0));
 }
 
 double Waypoint::CosinTurnAngle(const dwr::Waypoint &previous,
@@ -38,6 +47,38 @@ double Waypoint::CosinTurnAngle(const dwr::Waypoint &previous,
     return (pc_x * cn_x + pc_y * cn_y) / (sqrt(pc_x * pc_x + pc_y * pc_y) * sqrt(cn_x * cn_x + cn_y * cn_y));
 }
 
+GeoProj Waypoint::Direction(const Waypoint &from, const Waypoint &to) {
+    if (from.coordinate == kNoCoordinate || to.coordinate == kNoCoordinate) {
+        return kNoDirection;
+    }
+    double dx = to.coordinate.x - from.coordinate.x;
+    double dy = to.coordinate.y - from.coordinate.y;
+    double length = sqrt(dx * dx + dy * dy);
+    if (length == 0) {
+        return kNoDirection;
+    }
+    return {dx / length, dy / length};
+}
+
+std::string Waypoint::LocationName(const GeoPoint &location) {
+    std::ostringstream text_stream;
+    double longitude_degree = location.longitude * kRadToDeg;
+    text_stream << std::fixed << std::setprecision(2) << longitude_degree;
+    if (longitude_degree >= 0) {
+        text_stream << "E";
+    } else {
+        text_stream << "W";
+    }
+    double latitude_degree = location.latitude * kRadToDeg;
+    text_stream << latitude_degree;
+    if (latitude_degree >= 0) {
+        text_stream << "N";
+    } else {
+        text_stream << "S";
+    }
+    return text_stream.str();
+}
+
 WaypointPath::WaypointPath(const WaypointPath &other, int start, int node_count) {
     waypoints.reserve(node_count);
     lengths.reserve(node_count);
@@ -46,18 +87,77 @@ WaypointPath::WaypointPath(const WaypointPath &other, int start, int node_count)
     std::for_each(lengths.begin(), lengths.end(), [&](GeoDistance &distance){distance -= lengths[0];});
 }
 
-WaypointPath WaypointPath::operator+(const dwr::WaypointPath &path) const {
-    if (waypoints.back() != path.waypoints.front()) {
+// 拼接后的节点数，检查首尾相接
+static size_t AppendedSize(const WaypointPath &left, const WaypointPath &right) {
+    if (left.waypoints.back() != right.waypoints.front()) {
         throw std::invalid_argument("back of left path not same as front of right path");
     }
-    WaypointPath result(*this, 0, GetSize());
-    int sum_size = GetSize() + path.GetSize() - 1;
-    result.waypoints.reserve(sum_size);
-    result.lengths.reserve(sum_size);
-    result.waypoints.insert(result.waypoints.end(), path.waypoints.begin() + 1, path.waypoints.end());
-    result.lengths.insert(result.lengths.end(), path.lengths.begin() + 1, path.lengths.end());
-    std::for_each(result.lengths.begin() + GetSize(), result.lengths.end(), [&](GeoDistance &distance){distance += lengths.back();});
-    return result;
+    return left.waypoints.size() + right.waypoints.size() - 1;
+}
+
+WaypointPath &WaypointPath::Append(const WaypointPath &path) {
+    if (path.waypoints.empty()) {
+        return *this;
+    }
+    if (waypoints.empty()) {
+        return *this = path;
+    }
+    size_t sum_size = AppendedSize(*this, path);
+    GeoDistance offset = lengths.back();
+    waypoints.reserve(sum_size);
+    lengths.reserve(sum_size);
+    waypoints.insert(waypoints.end(), path.waypoints.begin() + 1, path.waypoints.end());
+    for (auto iterator = path.lengths.begin() + 1; iterator != path.lengths.end(); iterator++) {
+        lengths.push_back(*iterator + offset);
+    }
+    return *this;
+}
+
+WaypointPath &WaypointPath::Append(WaypointPath &&path) {
+    if (path.waypoints.empty()) {
+        return *this;
+    }
+    if (waypoints.empty()) {
+        return *this = std::move(path);
+    }
+    size_t sum_size = AppendedSize(*this, path);
+    GeoDistance offset = lengths.back();
+    waypoints.reserve(sum_size);
+    lengths.reserve(sum_size);
+    waypoints.insert(waypoints.end(),
+                     std::make_move_iterator(path.waypoints.begin() + 1),
+                     std::make_move_iterator(path.waypoints.end()));
+    for (auto iterator = path.lengths.begin() + 1; iterator != path.lengths.end(); iterator++) {
+        lengths.push_back(*iterator + offset);
+    }
+    path = WaypointPath();
+    return *this;
+}
+
+WaypointPath WaypointPath::operator+(const dwr::WaypointPath &path) const & {
+    WaypointPath result(*this);
+    return std::move(result.Append(path));
+}
+
+WaypointPath WaypointPath::operator+(const dwr::WaypointPath &path) && {
+    return std::move(Append(path));
+}
+
+void WaypointPath::MaterializeNames() {
+    for (auto &waypoint : waypoints) {
+        if (waypoint->user_waypoint && waypoint->name.empty()) {
+            auto named_waypoint = std::make_shared<Waypoint>(*waypoint);
+            named_waypoint->name = Waypoint::LocationName(waypoint->GetLocation());
+            waypoint = std::move(named_waypoint);
+        }
+    }
+}
+
+static std::string WaypointName(const Waypoint &waypoint) {
+    if (waypoint.user_waypoint && waypoint.name.empty()) {
+        return Waypoint::LocationName(waypoint.GetLocation());
+    }
+    return waypoint.name;
 }
 
 std::string WaypointPath::ToString() const {
@@ -66,10 +166,10 @@ std::string WaypointPath::ToString() const {
         return path_description;
     }
     for (auto it = waypoints.begin(); it < waypoints.end() - 1; it++) {
-        path_description += (*it)->name;
+        path_description += WaypointName(**it);
         path_description += "->";
     }
-    path_description += waypoints.back()->name;
+    path_description += WaypointName(*waypoints.back());
     return path_description;
 }
 
@@ -77,7 +177,8 @@ double WaypointPath::GetSumTurn() const {
     double sum_turn = 0.0;
     for (size_t i = 2; i < waypoints.size(); i++) {
         double cos_turn = Waypoint::CosinTurnAngle(*waypoints[i - 2], *waypoints[i - 1], *waypoints[i]);
-        sum_turn += acos(cos_turn);
+        // 共线时舍入误差可能使余弦略大于1
+        sum_turn += acos(std::max(-1.0, std::min(cos_turn, 1.0)));
     }
     return sum_turn;
 }
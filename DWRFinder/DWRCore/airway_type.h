@@ -9,9 +9,11 @@
 #ifndef airway_type_h
 #define airway_type_h
 
+#include <cmath>
 #include <string>
 #include <memory>
 #include <limits>
+#include <tuple>
 #include <vector>
 
 namespace dwr {
@@ -25,20 +27,6 @@ struct Waypoint;
 using WaypointPtr = std::shared_ptr<Waypoint>;
 using ConstWaypointPtr = std::shared_ptr<const Waypoint>;
 
-struct Neighbor {
-    std::weak_ptr<Waypoint> target;
-    GeoDistance distance;
-
-    Neighbor() {}
-
-    Neighbor(const WaypointPtr &arg_target, GeoDistance arg_distance) :
-    target(arg_target), distance(arg_distance) {}
-    
-    bool operator == (const Neighbor &n) const {
-        return target.lock() == n.target.lock();
-    }
-};
-
 const WaypointIdentifier kNoWaypointIdentifier = -1;
 const GeoDistance kEarthRadius = 6378137.0;
 
@@ -56,43 +44,146 @@ struct GeoProj {
     }
 };
 
+/**
+ Point on the unit sphere in the direction of a location from the center of the earth.
+ */
+struct GeoVector {
+    double x;
+    double y;
+    double z;
+};
+
 constexpr GeoProj kNoCoordinate = {
     std::numeric_limits<GeoDistance>::infinity(),
     std::numeric_limits<GeoDistance>::infinity()};
 
+constexpr GeoProj kNoDirection = {0.0, 0.0};
+
+struct Neighbor {
+    std::weak_ptr<Waypoint> target;
+    GeoDistance distance;
+    // Unit vector of the edge in projected coordinate, zero when the coordinates are unknown.
+    GeoProj direction = kNoDirection;
+
+    Neighbor() {}
+
+    Neighbor(const WaypointPtr &arg_target, GeoDistance arg_distance) :
+    target(arg_target), distance(arg_distance) {}
+
+    Neighbor(const WaypointPtr &arg_target, GeoDistance arg_distance, const GeoProj &arg_direction) :
+    target(arg_target), distance(arg_distance), direction(arg_direction) {}
+    
+    bool operator == (const Neighbor &n) const {
+        return target.lock() == n.target.lock();
+    }
+};
+
 struct Waypoint {
     WaypointIdentifier identifier;
     std::string name;
-    GeoPoint location;
+    // Mercator projection of the location, set when the waypoint is added to a graph.
     GeoProj coordinate = kNoCoordinate;
 
     bool user_waypoint = false;
     std::vector<Neighbor> neibors;
+    // Dense index in the graph, -1 for the waypoints made while searching. Not copied.
+    int index = -1;
 
-    Waypoint() {}
+    Waypoint() : location_({0.0, 0.0}), unit_vector_(UnitVector(location_)) {}
 
     Waypoint(const Waypoint &other) :
     identifier(other.identifier),
-    name(other.name), location(other.location), coordinate(other.coordinate),
-    user_waypoint(other.user_waypoint) {}
+    name(other.name), coordinate(other.coordinate),
+    user_waypoint(other.user_waypoint), location_(other.location_), unit_vector_(other.unit_vector_) {}
 
     Waypoint(int waypoint_identifier, const std::string &name, double lon, double lat) :
-    identifier(waypoint_identifier), name(name), location({lon, lat}) {}
+    identifier(waypoint_identifier), name(name), location_({lon, lat}), unit_vector_(UnitVector(location_)) {}
+
+    const GeoPoint &GetLocation() const {return location_;}
+
+    /**
+     Move the waypoint, keeping the unit vector used by the distances in step. The coordinate
+     is not changed.
+     */
+    void SetLocation(const GeoPoint &location) {
+        location_ = location;
+        unit_vector_ = UnitVector(location);
+    }
+
+    const GeoVector &GetUnitVector() const {return unit_vector_;}
 
     bool operator < (const Waypoint &p) const {
         return identifier < p.identifier;
     }
 
+    static GeoVector UnitVector(const GeoPoint &location);
+
+    /**
+     Great circle distance, converted from the chord between the unit vectors.
+     */
     static GeoDistance Distance(const Waypoint &p1,
                                 const Waypoint &p2);
 
+    /**
+     Straight distance through the earth. Never longer than Distance and obeying the triangle
+     inequality, so it is a consistent A* heuristic needing only a sqrt.
+     */
+    static GeoDistance ChordDistance(const Waypoint &p1,
+                                     const Waypoint &p2) {
+        double dx = p1.unit_vector_.x - p2.unit_vector_.x;
+        double dy = p1.unit_vector_.y - p2.unit_vector_.y;
+        double dz = p1.unit_vector_.z - p2.unit_vector_.z;
+        return kEarthRadius * sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
     static double CosinTurnAngle(const Waypoint &previous,
                                  const Waypoint &current,
                                  const Waypoint &next);
+
+    /**
+     Unit vector from one waypoint to another in projected coordinate.
+
+     @return The direction, or kNoDirection when either coordinate is unknown or the points coincide.
+     */
+    static GeoProj Direction(const Waypoint &from, const Waypoint &to);
+
+    /**
+     Whether the turn at current is less than 90°. Only the sign of the dot product matters,
+     so the departing leg needs neither normalization nor sqrt.
+
+     @param arriving_direction Direction of the leg arriving at current, kNoDirection if there is none.
+     @param current Current waypoint.
+     @param next Next waypoint.
+     @return True when no arriving direction is known or the turn is acute.
+     */
+    static bool IsAcuteTurn(const GeoProj &arriving_direction,
+                            const Waypoint &current,
+                            const Waypoint &next) {
+        if (arriving_direction == kNoDirection) {
+            return true;
+        }
+        return arriving_direction.x * (next.coordinate.x - current.coordinate.x) +
+               arriving_direction.y * (next.coordinate.y - current.coordinate.y) > 0;
+    }
+
+    /**
+     Format a location as the name of a user waypoint, e.g. 110.45E24.97N.
+
+     @param location Location in radian.
+     @return Location name.
+     */
+    static std::string LocationName(const GeoPoint &location);
+
+ private:
+    GeoPoint location_;
+    // Unit vector of the location, set with it so that it cannot go stale.
+    GeoVector unit_vector_;
 };
 
 struct WaypointInfo {
     std::weak_ptr<const Waypoint> previous;
+    // Direction of the leg arriving from previous.
+    GeoProj direction = kNoDirection;
     GeoDistance actual_distance = std::numeric_limits<GeoDistance>::max();
     GeoDistance estimated_distance = std::numeric_limits<GeoDistance>::max();
 };
@@ -109,7 +200,24 @@ struct WaypointPath {
 
     double GetSumTurn() const;
 
-    WaypointPath operator+ (const WaypointPath &path) const;
+    /**
+     Append a path starting at the last waypoint, moving the waypoints of an rvalue path.
+
+     @throw std::invalid_argument When the path does not start at the last waypoint.
+     */
+    WaypointPath &Append(const WaypointPath &path);
+
+    WaypointPath &Append(WaypointPath &&path);
+
+    WaypointPath operator+ (const WaypointPath &path) const &;
+
+    // The left path is moved into the result.
+    WaypointPath operator+ (const WaypointPath &path) &&;
+
+    /**
+     Name the user waypoints which are created without a name during searching.
+     */
+    void MaterializeNames();
 
     std::string ToString() const;
 };
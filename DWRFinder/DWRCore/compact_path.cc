@@ -0,0 +1,99 @@
+//
+//  compact_path.cc
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/27.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include "compact_path.h"
+
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+namespace dwr {
+
+CompactPath::CompactPath(const WaypointPath &path, std::vector<ConstWaypointPtr> &waypoint_table) :
+lengths_(path.lengths) {
+    nodes_.reserve(path.waypoints.size());
+    for (auto &waypoint : path.waypoints) {
+        if (waypoint->index < 0) {
+            nodes_.push_back(~static_cast<int32_t>(extra_waypoints_.size()));
+            extra_waypoints_.push_back(waypoint);
+            continue;
+        }
+        size_t index = static_cast<size_t>(waypoint->index);
+        if (index >= waypoint_table.size()) {
+            waypoint_table.resize(std::max(index + 1, waypoint_table.size() * 2));
+        }
+        // 表中已有时不复制shared_ptr
+        if (waypoint_table[index] == nullptr) {
+            waypoint_table[index] = waypoint;
+        }
+        nodes_.push_back(waypoint->index);
+    }
+}
+
+CompactPath::CompactPath(const CompactPath &other, int node_count) :
+nodes_(other.nodes_.begin(), other.nodes_.begin() + node_count),
+lengths_(other.lengths_.begin(), other.lengths_.begin() + node_count) {
+    // 只保留用到的附加航路点
+    for (auto &node : nodes_) {
+        if (node < 0) {
+            int32_t extra_node = ~static_cast<int32_t>(extra_waypoints_.size());
+            extra_waypoints_.push_back(other.extra_waypoints_[~node]);
+            node = extra_node;
+        }
+    }
+}
+
+bool CompactPath::HasSamePrefix(const CompactPath &other, int node_count) const {
+    if (GetSize() < node_count || other.GetSize() < node_count) {
+        return false;
+    }
+    for (int i = 0; i < node_count; i++) {
+        if (!IsSameNode(i, other, i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CompactPath::Append(CompactPath &&path) {
+    if (path.nodes_.empty()) {
+        return;
+    }
+    if (nodes_.empty()) {
+        *this = std::move(path);
+        return;
+    }
+    if (!IsSameNode(GetSize() - 1, path, 0)) {
+        throw std::invalid_argument("back of left path not same as front of right path");
+    }
+    GeoDistance offset = lengths_.back();
+    int32_t extra_offset = static_cast<int32_t>(extra_waypoints_.size());
+    nodes_.reserve(nodes_.size() + path.nodes_.size() - 1);
+    lengths_.reserve(lengths_.size() + path.lengths_.size() - 1);
+    for (int i = 1; i < path.GetSize(); i++) {
+        int32_t node = path.nodes_[i];
+        nodes_.push_back(node >= 0 ? node : ~(~node + extra_offset));
+        lengths_.push_back(path.lengths_[i] + offset);
+    }
+    extra_waypoints_.insert(extra_waypoints_.end(),
+                            std::make_move_iterator(path.extra_waypoints_.begin()),
+                            std::make_move_iterator(path.extra_waypoints_.end()));
+    path = CompactPath();
+}
+
+WaypointPath CompactPath::Materialize(const std::vector<ConstWaypointPtr> &waypoint_table) const {
+    WaypointPath path;
+    path.waypoints.reserve(nodes_.size());
+    for (int i = 0; i < GetSize(); i++) {
+        path.waypoints.push_back(WaypointAt(i, waypoint_table));
+    }
+    path.lengths = lengths_;
+    return path;
+}
+
+}  // namespace dwr
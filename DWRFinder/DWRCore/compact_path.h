@@ -0,0 +1,91 @@
+//
+//  compact_path.h
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/27.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#ifndef compact_path_h
+#define compact_path_h
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "airway_type.h"
+
+namespace dwr {
+
+/**
+ Path stored as packed node numbers for the candidates of the searches, so they are moved and
+ compared without shared_ptr copies. A waypoint of the graph is stored as its Waypoint::index,
+ and a waypoint made while searching, e.g. a detour point, as a negative number into a side
+ buffer of the path. The waypoints of the graph are resolved by a table from Waypoint::index,
+ filled while packing, and shared_ptrs are made only when materializing a WaypointPath.
+ */
+class CompactPath {
+ public:
+    CompactPath() = default;
+
+    /**
+     Pack a path.
+
+     @param path Path consists of waypoints.
+     @param waypoint_table Waypoints of the graph by Waypoint::index, the waypoints of the path are added to it.
+     */
+    CompactPath(const WaypointPath &path, std::vector<ConstWaypointPtr> &waypoint_table);
+
+    /**
+     First nodes of a path, keeping their lengths from the start of the path.
+     */
+    CompactPath(const CompactPath &other, int node_count);
+
+    int GetSize() const {return static_cast<int>(nodes_.size());}
+
+    GeoDistance GetLength() const {return lengths_.empty() ? 0 : lengths_.back();}
+
+    /**
+     @return Waypoint of the i-th node.
+     */
+    const ConstWaypointPtr &WaypointAt(int i, const std::vector<ConstWaypointPtr> &waypoint_table) const {
+        int32_t node = nodes_[i];
+        return node >= 0 ? waypoint_table[node] : extra_waypoints_[~node];
+    }
+
+    /**
+     Whether the first nodes of both paths are the same waypoints.
+     */
+    bool HasSamePrefix(const CompactPath &other, int node_count) const;
+
+    /**
+     Append a path starting at the last node, moving its nodes and side buffer.
+
+     @throw std::invalid_argument When the path does not start at the last node.
+     */
+    void Append(CompactPath &&path);
+
+    /**
+     @param waypoint_table Table filled while packing.
+     @return Path consists of waypoints.
+     */
+    WaypointPath Materialize(const std::vector<ConstWaypointPtr> &waypoint_table) const;
+
+ private:
+    // Waypoint::index, or ~i for the i-th waypoint of extra_waypoints_.
+    std::vector<int32_t> nodes_;
+    std::vector<GeoDistance> lengths_;
+    std::vector<ConstWaypointPtr> extra_waypoints_;
+
+    bool IsSameNode(int i, const CompactPath &other, int j) const {
+        int32_t node = nodes_[i];
+        int32_t other_node = other.nodes_[j];
+        if (node >= 0 || other_node >= 0) {
+            return node == other_node;
+        }
+        return extra_waypoints_[~node] == other.extra_waypoints_[~other_node];
+    }
+};
+
+}  // namespace dwr
+#endif /* compact_path_h */
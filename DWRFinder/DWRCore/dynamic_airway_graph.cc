@@ -11,31 +11,66 @@
 #include <memory>
 #include <vector>
 
+#include "metrics.h"
+
 namespace dwr {
 
+static const Histogram find_dynamic_path_latency =
+MetricsRegistry::Default().AddHistogram("dwr_find_dynamic_path_seconds", "Latency of DynamicAirwayGraph::FindDynamicPath.", 1e-6);
+
 WaypointPath
 DynamicAirwayGraph::FindDynamicPath(WaypointIdentifier origin_identifier,
-                                    WaypointIdentifier destination_identifier) const {
+                                    WaypointIdentifier destination_identifier,
+                                    SearchStats *stats) const {
+    MetricsScope metrics_scope(find_dynamic_path_latency, stats);
     auto can_search = [&](const WaypointPair &waypoint_pair,
                           const WaypointInfoPair &info_pair,
                           std::vector<WaypointPtr> &inserted_waypoints) {
         // False when waypoint pair in block set.
         if (block_set_.find(UndirectedWaypointPair(waypoint_pair)) == block_set_.end()) {
             // 90° limit
-            if (info_pair.first.previous.lock() == nullptr) {
-                return true;
-            } else if (Waypoint::CosinTurnAngle(*info_pair.first.previous.lock(),
-                                                *waypoint_pair.first,
-                                                *waypoint_pair.second) > 0) {
-                return true;
-            } else {
-                return false;
-            }
+            return Waypoint::IsAcuteTurn(info_pair.first.direction, *waypoint_pair.first, *waypoint_pair.second);
         } else {
+            if (stats) {
+                stats->blocked_edges++;
+            }
             return false;
         }
     };
-    return FindPath(origin_identifier, destination_identifier, can_search);
+    return FindTurnPath(origin_identifier, destination_identifier, can_search, stats);
+}
+
+WaypointPath
+DynamicAirwayGraph::FindTurnPath(WaypointIdentifier origin_identifier,
+                                 WaypointIdentifier destination_identifier,
+                                 const std::function<bool(const WaypointPair &,
+                                                          const WaypointInfoPair &,
+                                                          std::vector<WaypointPtr> &)> &can_search,
+                                 SearchStats *stats) const {
+    if (turn_search_ == TurnSearch::kWaypoint) {
+        return FindPath(origin_identifier, destination_identifier, can_search, nullptr, stats);
+    }
+    auto origin_waypoint = WaypointFromIdentifier(origin_identifier);
+    auto destination_waypoint = WaypointFromIdentifier(destination_identifier);
+    if (origin_waypoint == nullptr || destination_waypoint == nullptr) {
+        return WaypointPath();
+    }
+    return FindEdgePathInGraph(origin_waypoint, destination_waypoint, can_search, nullptr, stats);
+}
+
+WaypointPath
+DynamicAirwayGraph::FindTurnPathInGraph(const ConstWaypointPtr &origin_waypoint,
+                                        const ConstWaypointPtr &destination_waypoint,
+                                        const std::function<bool(const WaypointPair &,
+                                                                 const WaypointInfoPair &,
+                                                                 std::vector<WaypointPtr> &)> &can_search,
+                                        const std::function<GeoDistance(const WaypointPair &,
+                                                                        const std::vector<WaypointPtr> &)> &penalty,
+                                        SearchStats *stats) const {
+    if (turn_search_ == TurnSearch::kWaypoint) {
+        return FindPathInGraph(origin_waypoint, destination_waypoint, can_search, penalty, stats);
+    }
+    return FindEdgePathInGraph(origin_waypoint, destination_waypoint, can_search, penalty, stats);
 }
 
 void
@@ -26,14 +26,54 @@ struct UndirectedWaypointPair : public WaypointPair {
     WaypointPair(std::min(waypoint1, waypoint2), std::max(waypoint1, waypoint2)) {}
 };
 
+/**
+ Search used for the routes limited by the turn between successive legs.
+ */
+enum class TurnSearch {
+    // A* over the waypoints, see FindPathInGraph. A waypoint keeps only its shortest arrival,
+    // so a route needing a longer arrival to make a later turn may be missed.
+    kWaypoint,
+    // A* over the arriving edges, see FindEdgePathInGraph.
+    kEdge
+};
+
 class DynamicAirwayGraph: public AirwayGraph {
  public:
     WaypointPath FindDynamicPath(WaypointIdentifier origin_identifier,
-                                 WaypointIdentifier destination_identifier) const;
+                                 WaypointIdentifier destination_identifier,
+                                 SearchStats *stats = nullptr) const;
 
     void ForEachBlock(const std::function<void(const Waypoint &, const Waypoint &)> &traverse_function) const;
+
+    /**
+     Set the search of the dynamic paths, TurnSearch::kWaypoint by default.
+     */
+    void SetTurnSearch(TurnSearch turn_search) {turn_search_ = turn_search;}
+
+    TurnSearch GetTurnSearch() const {return turn_search_;}
  protected:
     std::set<UndirectedWaypointPair> block_set_;
+    TurnSearch turn_search_ = TurnSearch::kWaypoint;
+
+    /**
+     FindPath with the search set by SetTurnSearch.
+     */
+    WaypointPath FindTurnPath(WaypointIdentifier origin_identifier,
+                              WaypointIdentifier destination_identifier,
+                              const std::function<bool(const WaypointPair &, const WaypointInfoPair &,
+                                                       std::vector<WaypointPtr> &)> &can_search,
+                              SearchStats *stats) const;
+
+    /**
+     FindPathInGraph with the search set by SetTurnSearch.
+     */
+    WaypointPath FindTurnPathInGraph(const ConstWaypointPtr &origin_waypoint,
+                                     const ConstWaypointPtr &destination_waypoint,
+                                     const std::function<bool(const WaypointPair &, const WaypointInfoPair &,
+                                                              std::vector<WaypointPtr> &)> &can_search,
+                                     const std::function<GeoDistance(const WaypointPair &,
+                                                                     const std::vector<WaypointPtr> &)> &penalty,
+                                     SearchStats *stats) const;
 };
 
 }  // namespace dwr
@@ -10,21 +10,48 @@
 
 #include <fstream>
 #include <iostream>
-#include <sstream>
-#include <iomanip>
 #include <memory>
 #include <string>
 #include <algorithm>
 #include <vector>
 #include <set>
+#include <stdexcept>
+#include <chrono>
+#include <thread>
+#include <utility>
 
 #include "Utils/coordinate_convert.h"
 #include "Utils/graphics_utils.h"
+#include "metrics.h"
 #include "raster_graph.h"
+#include "waypoint_pool.h"
 
 namespace dwr {
 
-const double kRadToDeg = 57.29577951308232;
+static const Histogram build_latency =
+MetricsRegistry::Default().AddHistogram("dwr_build_seconds", "Latency of DynamicRadarAirwayGraph::Build.", 1e-6);
+static const Histogram single_build_latency =
+MetricsRegistry::Default().AddHistogram("dwr_single_build_seconds", "Latency of DynamicRadarAirwayGraph::SingleBuild.", 1e-6);
+static const Histogram update_block_latency =
+MetricsRegistry::Default().AddHistogram("dwr_update_block_seconds", "Latency of DynamicRadarAirwayGraph::UpdateBlock.", 1e-6);
+static const Histogram update_intensity_latency =
+MetricsRegistry::Default().AddHistogram("dwr_update_intensity_seconds", "Latency of DynamicRadarAirwayGraph::UpdateIntensity.", 1e-6);
+static const Histogram update_block_polygons_latency =
+MetricsRegistry::Default().AddHistogram("dwr_update_block_polygons_seconds", "Latency of DynamicRadarAirwayGraph::UpdateBlockPolygons.", 1e-6);
+static const Histogram add_forecast_block_latency =
+MetricsRegistry::Default().AddHistogram("dwr_add_forecast_block_seconds", "Latency of DynamicRadarAirwayGraph::AddForecastBlock.", 1e-6);
+static const Histogram find_dynamic_full_path_latency =
+MetricsRegistry::Default().AddHistogram("dwr_find_dynamic_full_path_seconds", "Latency of DynamicRadarAirwayGraph::FindDynamicFullPath.", 1e-6);
+static const Histogram find_cached_dynamic_full_path_latency =
+MetricsRegistry::Default().AddHistogram("dwr_find_cached_dynamic_full_path_seconds", "Latency of DynamicRadarAirwayGraph::FindCachedDynamicFullPath.", 1e-6);
+static const Histogram find_k_dynamic_full_path_latency =
+MetricsRegistry::Default().AddHistogram("dwr_find_k_dynamic_full_path_seconds", "Latency of DynamicRadarAirwayGraph::FindKDynamicFullPath.", 1e-6);
+static const Histogram find_pareto_dynamic_full_path_latency =
+MetricsRegistry::Default().AddHistogram("dwr_find_pareto_dynamic_full_path_seconds", "Latency of DynamicRadarAirwayGraph::FindParetoDynamicFullPath.", 1e-6);
+static const Histogram find_time_dependent_path_latency =
+MetricsRegistry::Default().AddHistogram("dwr_find_time_dependent_path_seconds", "Latency of DynamicRadarAirwayGraph::FindTimeDependentPath.", 1e-6);
+static const Histogram blocked_edges_per_frame =
+MetricsRegistry::Default().AddHistogram("dwr_blocked_edges_per_frame", "Blocked edges of each radar or forecast frame.");
 
 WorldFileInfo::WorldFileInfo(const char* path) {
     std::ifstream inf(path);
@@ -48,157 +75,823 @@ GeoProj PixelToCoordinate(const Pixel &pixel, const WorldFileInfo &w) {
     return xy;
 }
 
-std::string LonlatToString(double lon, double lat) {
-    std::ostringstream text_stream;
-    double longitude_degree = lon * kRadToDeg;
-    text_stream << std::fixed << std::setprecision(2) << longitude_degree;
-    if (longitude_degree >= 0) {
-        text_stream << "E";
-    } else {
-        text_stream << "W";
+void PixelsToWaypoints(PixelPath::const_iterator first,
+                       PixelPath::const_iterator last,
+                       const WorldFileInfo &w,
+                       const WaypointPool &pool,
+                       std::vector<WaypointPtr> &waypoints) {
+    size_t count = last - first;
+    std::vector<int> pixel_x(count), pixel_y(count);
+    std::vector<double> x(count), y(count), longitude(count), latitude(count);
+    for (size_t i = 0; i < count; i++) {
+        pixel_x[i] = first[i].x;
+        pixel_y[i] = first[i].y;
     }
-    double latitude_degree = lat * kRadToDeg;
-    text_stream << latitude_degree;
-    if (latitude_degree >= 0) {
-        text_stream << "N";
-    } else {
-        text_stream << "S";
+    const double affine[6] = {w.A, w.D, w.B, w.E, w.C, w.F};
+    PixelToLonLatBatch(affine, pixel_x.data(), pixel_y.data(),
+                       x.data(), y.data(), longitude.data(), latitude.data(), count);
+    waypoints.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        // 名称在生成最终路径时才格式化
+        auto user_waypoint = pool.MakeWaypoint(kNoWaypointIdentifier, std::string(), longitude[i], latitude[i]);
+        user_waypoint->coordinate = {x[i], y[i]};
+        user_waypoint->user_waypoint = true;
+        waypoints[i] = std::move(user_waypoint);
     }
-    return text_stream.str();
 }
 
-WaypointPtr PixelToWaypoint(const Pixel &pixel, const WorldFileInfo &world_file_info) {
-    GeoProj xy = PixelToCoordinate(pixel, world_file_info);
-    double longitude, latitude;
-    MercToLonLat(xy.x, xy.y, &longitude, &latitude);
-    auto name = LonlatToString(longitude, latitude);
-    auto user_waypoint = std::make_shared<Waypoint>(kNoWaypointIdentifier, name, longitude, latitude);
-    user_waypoint->coordinate = xy;
-    user_waypoint->user_waypoint = true;
-    return user_waypoint;
+bool DynamicRadarAirwayGraph::RasterSource::Contains(const Pixel &pixel) const {
+    if (info.width <= 0 || info.height <= 0) {
+        return true;
+    }
+    return pixel.x >= 0 && pixel.x < info.width && pixel.y >= 0 && pixel.y < info.height;
+}
+
+void DynamicRadarAirwayGraph::RasterSource::IndexEdge(const UndirectedWaypointPair &edge) {
+    Pixel start_pixel = CoordinateToPixel(edge.first->coordinate, info.world_file_info);
+    Pixel end_pixel = CoordinateToPixel(edge.second->coordinate, info.world_file_info);
+    if (info.width > 0 && info.height > 0) {
+        // 与图像范围不相交的航段不必逐像素索引
+        if (std::max(start_pixel.x, end_pixel.x) < 0 || std::min(start_pixel.x, end_pixel.x) >= info.width ||
+            std::max(start_pixel.y, end_pixel.y) < 0 || std::min(start_pixel.y, end_pixel.y) >= info.height) {
+            return;
+        }
+    }
+    WalkBresenhamLine(start_pixel, end_pixel, [&](const Pixel &pixel) {
+        if (Contains(pixel)) {
+            // SingleBuild可能再次索引已索引的航段，重复会使强度累计两次
+            auto &edges = pixel_to_edge_table[pixel];
+            if (std::find(edges.begin(), edges.end(), edge) == edges.end()) {
+                edges.push_back(edge);
+            }
+        }
+        return true;
+    });
 }
 
 void DynamicRadarAirwayGraph::Build(const WorldFileInfo &world_file_info) {
-    world_file_info_ = world_file_info;
-    pixel_to_edge_table_.clear();
-    auto traverse_function = [&](const WaypointPtr &start_waypoint,
-                                 const WaypointPtr &end_waypoint, GeoDistance d) {
-        // 更新坐标
-        if (start_waypoint->coordinate == kNoCoordinate) {
-            LonLatToMerc(start_waypoint->location.longitude,
-                         start_waypoint->location.latitude,
-                         &start_waypoint->coordinate.x,
-                         &start_waypoint->coordinate.y);
+    Build(std::vector<RasterSourceInfo>{RasterSourceInfo(world_file_info)});
+}
+
+void DynamicRadarAirwayGraph::Build(const std::vector<RasterSourceInfo> &raster_sources) {
+    MetricsScope metrics_scope(build_latency);
+    raster_sources_.clear();
+    raster_sources_.resize(raster_sources.size());
+    for (size_t i = 0; i < raster_sources.size(); i++) {
+        raster_sources_[i].info = raster_sources[i];
+    }
+    block_set_.clear();
+    block_count_map_.clear();
+    polygon_block_set_.clear();
+    // 预报帧按旧的第一个雷达索引，需重新添加
+    forecast_frames_.clear();
+    block_interval_map_.clear();
+    route_cache_.Clear();
+    // 批量计算所有航路点的坐标
+    std::vector<Waypoint *> unprojected_waypoints;
+    std::vector<double> longitude, latitude;
+    for (auto &waypoint_pointer : waypoints_) {
+        Waypoint *waypoint = waypoint_pointer.get();
+        if (waypoint->coordinate == kNoCoordinate) {
+            unprojected_waypoints.push_back(waypoint);
+            longitude.push_back(waypoint->GetLocation().longitude);
+            latitude.push_back(waypoint->GetLocation().latitude);
         }
-        if (end_waypoint->coordinate == kNoCoordinate) {
-            LonLatToMerc(end_waypoint->location.longitude,
-                         end_waypoint->location.latitude,
-                         &end_waypoint->coordinate.x,
-                         &end_waypoint->coordinate.y);
+    }
+    std::vector<double> x(unprojected_waypoints.size()), y(unprojected_waypoints.size());
+    LonLatToMercBatch(longitude.data(), latitude.data(), x.data(), y.data(), unprojected_waypoints.size());
+    for (size_t i = 0; i < unprojected_waypoints.size(); i++) {
+        unprojected_waypoints[i]->coordinate = {x[i], y[i]};
+    }
+    // 预计算边的方向
+    for (auto &waypoint : waypoints_) {
+        for (auto &neibor : waypoint->neibors) {
+            neibor.direction = Waypoint::Direction(*waypoint, *neibor.target.lock());
         }
-        Pixel start_pixel = CoordinateToPixel(start_waypoint->coordinate, world_file_info);
-        Pixel end_pixel = CoordinateToPixel(end_waypoint->coordinate, world_file_info);
-        Line linePixels = BresenhamLine(start_pixel, end_pixel);
-        for (auto &point : linePixels) {
-            pixel_to_edge_table_[point].push_back(UndirectedWaypointPair(start_waypoint, end_waypoint));
+    }
+    // ForEach经过每条航段的两个方向，只索引一次
+    std::vector<UndirectedWaypointPair> edges;
+    this->ForEach([&](const WaypointPtr &start_waypoint, const WaypointPtr &end_waypoint, GeoDistance d) {
+        edges.push_back(UndirectedWaypointPair(start_waypoint, end_waypoint));
+    });
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    // 每个雷达源的索引在各自的线程中建立
+    auto index_source = [&](size_t source_index) {
+        for (auto &edge : edges) {
+            raster_sources_[source_index].IndexEdge(edge);
         }
     };
-    this->ForEach(traverse_function);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < raster_sources_.size(); i++) {
+        threads.push_back(std::thread(index_source, i));
+    }
+    if (!raster_sources_.empty()) {
+        index_source(0);
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    waypoint_index_.Build(waypoints_);
 }
 
 void DynamicRadarAirwayGraph::SingleBuild(WaypointIdentifier identifier) {
+    MetricsScope metrics_scope(single_build_latency);
     auto start_waypoint = WaypointFromIdentifier(identifier);
     if (start_waypoint == nullptr) {
         return;
     }
     if (start_waypoint->coordinate == kNoCoordinate) {
-        LonLatToMerc(start_waypoint->location.longitude,
-                     start_waypoint->location.latitude,
+        LonLatToMerc(start_waypoint->GetLocation().longitude,
+                     start_waypoint->GetLocation().latitude,
                      &start_waypoint->coordinate.x,
                      &start_waypoint->coordinate.y);
     }
-    Pixel start_pixel = CoordinateToPixel(start_waypoint->coordinate, world_file_info_);
+    waypoint_index_.Insert(start_waypoint);
+    route_cache_.Clear();
     for (auto &neibor : start_waypoint->neibors) {
         auto end_waypoint = neibor.target.lock();
         // 如果是Build前end_waypoint是孤立的节点，则在Build中会遗漏该节点的坐标计算
         if (end_waypoint->coordinate == kNoCoordinate) {
-            LonLatToMerc(end_waypoint->location.longitude,
-                         end_waypoint->location.latitude,
+            LonLatToMerc(end_waypoint->GetLocation().longitude,
+                         end_waypoint->GetLocation().latitude,
                          &end_waypoint->coordinate.x,
                          &end_waypoint->coordinate.y);
         }
-        Pixel end_pixel = CoordinateToPixel(end_waypoint->coordinate, world_file_info_);
-        Line linePixels = BresenhamLine(start_pixel, end_pixel);
-        for (auto &point : linePixels) {
-            pixel_to_edge_table_[point].push_back(UndirectedWaypointPair(start_waypoint, end_waypoint));
+        neibor.direction = Waypoint::Direction(*start_waypoint, *end_waypoint);
+        for (auto &reverse_neibor : end_waypoint->neibors) {
+            if (reverse_neibor.target.lock() == start_waypoint) {
+                reverse_neibor.direction = {-neibor.direction.x, -neibor.direction.y};
+            }
+        }
+        for (auto &source : raster_sources_) {
+            source.IndexEdge(UndirectedWaypointPair(start_waypoint, end_waypoint));
         }
     }
 }
 
-void DynamicRadarAirwayGraph::UpdateBlock(char *mask, int width, int height) {
-    raster_graph_.SetRasterData(mask, width, height);
-    // 更新阻塞集合
-    block_set_.clear();
-    raster_graph_.ForEach([&](int x, int y, char value){
-        if (value > 0) {
-            Pixel pixel = Pixel(x, y);
-            for (auto &edge : pixel_to_edge_table_[pixel]) {
-                block_set_.insert(edge);
+void DynamicRadarAirwayGraph::ForEachWeatherEdge(const RasterSource &source,
+                                                 const RasterGraph &raster_graph,
+                                                 const std::function<void(const UndirectedWaypointPair &, char)> &traverse_function) const {
+    raster_graph.ForEachNonZero([&](int x, int y, char value){
+        auto iterator = source.pixel_to_edge_table.find(Pixel(x, y));
+        if (iterator == source.pixel_to_edge_table.end()) {
+            return;
+        }
+        for (auto &edge : iterator->second) {
+            traverse_function(edge, value);
+        }
+    });
+}
+
+DynamicRadarAirwayGraph::RasterSource &DynamicRadarAirwayGraph::RasterSourceAt(int source_index) {
+    if (source_index < 0 || source_index >= raster_sources_.size()) {
+        throw std::out_of_range("raster source index out of range");
+    }
+    return raster_sources_[source_index];
+}
+
+BlockChange DynamicRadarAirwayGraph::UpdateBlock(char *mask, int width, int height) {
+    return UpdateBlock(0, mask, width, height);
+}
+
+BlockChange DynamicRadarAirwayGraph::UpdateBlock(int source_index, char *mask, int width, int height) {
+    MetricsScope metrics_scope(update_block_latency);
+    return ReplaceRaster(source_index, RasterGraph(mask, width, height));
+}
+
+BlockChange DynamicRadarAirwayGraph::UpdateIntensity(char *intensity, int width, int height,
+                                                     int block_level, double intensity_weight) {
+    return UpdateIntensity(0, intensity, width, height, block_level, intensity_weight);
+}
+
+BlockChange DynamicRadarAirwayGraph::UpdateIntensity(int source_index, char *intensity, int width, int height,
+                                                     int block_level, double intensity_weight) {
+    MetricsScope metrics_scope(update_intensity_latency);
+    RasterGraph raster_graph(intensity, width, height);
+    raster_graph.SetIntensity(block_level, intensity_weight);
+    return ReplaceRaster(source_index, std::move(raster_graph));
+}
+
+BlockChange DynamicRadarAirwayGraph::ReplaceRaster(int source_index, RasterGraph raster_graph) {
+    RasterSource &source = RasterSourceAt(source_index);
+    int width = raster_graph.GetWidth(), height = raster_graph.GetHeight();
+    if (source.info.width > 0 && source.info.height > 0 &&
+        (width != source.info.width || height != source.info.height)) {
+        throw std::invalid_argument("raster size differs from the raster source");
+    }
+    double intensity_weight = raster_graph.GetIntensityWeight();
+    // 在锁外计算本源的阻塞集合，并在同一次遍历中累计航段强度
+    std::set<UndirectedWaypointPair> block_set;
+    std::map<UndirectedWaypointPair, int> intensity_map;
+    ForEachWeatherEdge(source, raster_graph, [&](const UndirectedWaypointPair &edge, char value){
+        if (raster_graph.IsBlockValue(value)) {
+            block_set.insert(edge);
+        } else if (intensity_weight > 0) {
+            intensity_map[edge] += static_cast<unsigned char>(value);
+        }
+    });
+    blocked_edges_per_frame.Record(block_set.size());
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    std::vector<RouteCache::TileKey> changed_tiles;
+    bool resized = width != source.raster_graph.GetWidth() || height != source.raster_graph.GetHeight();
+    if (!resized) {
+        for (int tile_index : raster_graph.ChangedTiles(source.raster_graph)) {
+            changed_tiles.push_back(RouteCache::MakeTileKey(source_index, tile_index));
+        }
+        route_cache_.InvalidateTiles(changed_tiles);
+    } else {
+        route_cache_.Clear();
+    }
+    // 保留多边形阻塞区域
+    raster_graph.SetBlockSpans(source.raster_graph.GetBlockSpans());
+    source.raster_graph = std::move(raster_graph);
+    source.intensity_map.swap(intensity_map);
+    BlockChange change = ReplaceBlockSet(source.block_set, std::move(block_set));
+    change.changed_tiles.swap(changed_tiles);
+    change.all_tiles_changed = resized;
+    change.route_impacts = route_registry_.FindImpacts(change.blocked_edges, change.changed_tiles, resized);
+    return change;
+}
+
+BlockChange DynamicRadarAirwayGraph::UpdateBlockPolygons(const std::vector<GeoPolygon> &polygons) {
+    MetricsScope metrics_scope(update_block_polygons_latency);
+    std::vector<std::vector<double>> polygon_x, polygon_y;
+    for (auto &polygon : polygons) {
+        size_t count = polygon.size();
+        std::vector<double> longitude(count), latitude(count), x(count), y(count);
+        for (size_t i = 0; i < count; i++) {
+            longitude[i] = polygon[i].longitude;
+            latitude[i] = polygon[i].latitude;
+        }
+        LonLatToMercBatch(longitude.data(), latitude.data(), x.data(), y.data(), count);
+        polygon_x.push_back(std::move(x));
+        polygon_y.push_back(std::move(y));
+    }
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    std::set<UndirectedWaypointPair> block_set;
+    std::vector<RouteCache::TileKey> changed_tiles;
+    for (int source_index = 0; source_index < raster_sources_.size(); source_index++) {
+        RasterSource &source = raster_sources_[source_index];
+        const WorldFileInfo &w = source.info.world_file_info;
+        double determinant = w.A * w.E - w.D * w.B;
+        std::vector<PixelSpan> spans;
+        for (size_t polygon_index = 0; polygon_index < polygon_x.size(); polygon_index++) {
+            const std::vector<double> &x = polygon_x[polygon_index], &y = polygon_y[polygon_index];
+            size_t count = x.size();
+            // 与CoordinateToPixel相同的逆变换，但保留小数部分
+            std::vector<double> pixel_x(count), pixel_y(count);
+            for (size_t i = 0; i < count; i++) {
+                pixel_x[i] = (w.E * x[i] - w.B * y[i] + w.B * w.F - w.E * w.C) / determinant;
+                pixel_y[i] = (-w.D * x[i] + w.A * y[i] + w.D * w.C - w.A * w.F) / determinant;
+            }
+            ScanlinePolygon(pixel_x, pixel_y, spans);
+        }
+        std::vector<PixelSpan> previous_spans = source.raster_graph.GetBlockSpans();
+        source.raster_graph.SetBlockSpans(std::move(spans));
+        if (previous_spans != source.raster_graph.GetBlockSpans()) {
+            // 新旧区域覆盖的瓦片
+            auto add_span_tiles = [&](const std::vector<PixelSpan> &span_list) {
+                for (auto &span : span_list) {
+                    source.raster_graph.ForEachTileInBox(Pixel(span.begin_x, span.y), Pixel(span.end_x - 1, span.y), [&](int tile_index) {
+                        changed_tiles.push_back(RouteCache::MakeTileKey(source_index, tile_index));
+                    });
+                }
+            };
+            add_span_tiles(previous_spans);
+            add_span_tiles(source.raster_graph.GetBlockSpans());
+        }
+        // 直接按像素查找经过的航段，无需遍历整幅图像
+        for (auto &span : source.raster_graph.GetBlockSpans()) {
+            for (int x = span.begin_x; x < span.end_x; x++) {
+                auto iterator = source.pixel_to_edge_table.find(Pixel(x, span.y));
+                if (iterator == source.pixel_to_edge_table.end()) {
+                    continue;
+                }
+                block_set.insert(iterator->second.begin(), iterator->second.end());
             }
         }
+    }
+    std::sort(changed_tiles.begin(), changed_tiles.end());
+    changed_tiles.erase(std::unique(changed_tiles.begin(), changed_tiles.end()), changed_tiles.end());
+    route_cache_.InvalidateTiles(changed_tiles);
+    BlockChange change = ReplaceBlockSet(polygon_block_set_, std::move(block_set));
+    change.changed_tiles.swap(changed_tiles);
+    change.route_impacts = route_registry_.FindImpacts(change.blocked_edges, change.changed_tiles);
+    return change;
+}
+
+BlockChange DynamicRadarAirwayGraph::ClearBlockPolygons() {
+    return UpdateBlockPolygons(std::vector<GeoPolygon>());
+}
+
+BlockChange DynamicRadarAirwayGraph::ReplaceBlockSet(std::set<UndirectedWaypointPair> &current_block_set,
+                                                     std::set<UndirectedWaypointPair> block_set) {
+    // 只更新阻塞状态变化的航段，其他雷达和多边形的阻塞不受影响
+    BlockChange change;
+    for (auto &edge : current_block_set) {
+        if (block_set.find(edge) != block_set.end()) {
+            continue;
+        }
+        auto iterator = block_count_map_.find(edge);
+        if (--iterator->second == 0) {
+            block_count_map_.erase(iterator);
+            block_set_.erase(edge);
+            change.cleared_edges.push_back(edge);
+        }
+    }
+    for (auto &edge : block_set) {
+        if (current_block_set.find(edge) == current_block_set.end() && ++block_count_map_[edge] == 1) {
+            block_set_.insert(edge);
+            change.blocked_edges.push_back(edge);
+        }
+    }
+    current_block_set.swap(block_set);
+    route_cache_.InvalidateEdges(change.cleared_edges);
+    route_cache_.InvalidateEdges(change.blocked_edges);
+    return change;
+}
+
+void DynamicRadarAirwayGraph::AddDetourFootprint(const WaypointPair &waypoint_pair, RouteFootprint &footprint) const {
+    footprint.edges.insert(UndirectedWaypointPair(waypoint_pair));
+    for (int source_index = 0; source_index < raster_sources_.size(); source_index++) {
+        const RasterSource &source = raster_sources_[source_index];
+        Pixel pixel1 = CoordinateToPixel(waypoint_pair.first->coordinate, source.info.world_file_info);
+        Pixel pixel2 = CoordinateToPixel(waypoint_pair.second->coordinate, source.info.world_file_info);
+        // 绕行窗口为包围盒向外扩展半个直线长度，另加粗网格的一格
+        int margin = static_cast<int>(Pixel::Distance(pixel1, pixel2) * (0.5 + 0.125)) + 1;
+        source.raster_graph.ForEachTileInBox(Pixel(std::min(pixel1.x, pixel2.x) - margin, std::min(pixel1.y, pixel2.y) - margin),
+                                             Pixel(std::max(pixel1.x, pixel2.x) + margin, std::max(pixel1.y, pixel2.y) + margin),
+                                             [&](int tile_index) {
+            footprint.tiles.insert(RouteCache::MakeTileKey(source_index, tile_index));
+        });
+    }
+}
+
+void DynamicRadarAirwayGraph::RegisterRoute(RouteIdentifier route_identifier, const WaypointPath &path) {
+    // 绕行段按与RouteCache相同的瓦片索引
+    route_registry_.Register(route_identifier, path, [this](const WaypointPair &waypoint_pair,
+                                                            std::vector<RouteCache::TileKey> &tiles) {
+        RouteFootprint footprint;
+        AddDetourFootprint(waypoint_pair, footprint);
+        tiles.insert(tiles.end(), footprint.tiles.begin(), footprint.tiles.end());
     });
 }
 
+bool DynamicRadarAirwayGraph::HasIntensity() const {
+    for (auto &source : raster_sources_) {
+        if (source.raster_graph.GetIntensityWeight() > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+GeoDistance DynamicRadarAirwayGraph::IntensityPenalty(const WaypointPair &waypoint_pair,
+                                                      const std::vector<WaypointPtr> &inserted_waypoints) const {
+    // 雷达覆盖重叠时取最大的惩罚
+    GeoDistance max_penalty = 0;
+    for (auto &source : raster_sources_) {
+        double intensity_weight = source.raster_graph.GetIntensityWeight();
+        if (intensity_weight <= 0) {
+            continue;
+        }
+        const WorldFileInfo &w = source.info.world_file_info;
+        GeoDistance penalty = 0;
+        if (inserted_waypoints.empty()) {
+            auto iterator = source.intensity_map.find(UndirectedWaypointPair(waypoint_pair));
+            if (iterator == source.intensity_map.end()) {
+                continue;
+            }
+            Pixel start_pixel = CoordinateToPixel(waypoint_pair.first->coordinate, w);
+            Pixel end_pixel = CoordinateToPixel(waypoint_pair.second->coordinate, w);
+            // Bresenham直线的像素数
+            int pixel_count = std::max(abs(end_pixel.x - start_pixel.x), abs(end_pixel.y - start_pixel.y)) + 1;
+            double mean_level = static_cast<double>(iterator->second) / pixel_count;
+            penalty = Waypoint::Distance(*waypoint_pair.first, *waypoint_pair.second) * intensity_weight * mean_level;
+        } else {
+            // 绕行路径逐段计算
+            const Waypoint *leg_start = waypoint_pair.first.get();
+            for (size_t i = 0; i <= inserted_waypoints.size(); i++) {
+                const Waypoint *leg_end = i < inserted_waypoints.size() ? inserted_waypoints[i].get() : waypoint_pair.second.get();
+                double mean_level = source.raster_graph.LineIntensity(CoordinateToPixel(leg_start->coordinate, w),
+                                                                      CoordinateToPixel(leg_end->coordinate, w));
+                penalty += Waypoint::Distance(*leg_start, *leg_end) * intensity_weight * mean_level;
+                leg_start = leg_end;
+            }
+        }
+        max_penalty = std::max(max_penalty, penalty);
+    }
+    return max_penalty;
+}
+
+void DynamicRadarAirwayGraph::AddForecastBlock(double valid_time, char *mask, int width, int height) {
+    MetricsScope metrics_scope(add_forecast_block_latency);
+    // 先接管mask，检查失败时由RasterGraph释放
+    RasterGraph frame_raster_graph(mask, width, height);
+    if (raster_sources_.empty()) {
+        throw std::logic_error("graph is not built");
+    }
+    const RasterSourceInfo &info = raster_sources_.front().info;
+    if (info.width > 0 && info.height > 0 && (width != info.width || height != info.height)) {
+        throw std::invalid_argument("raster size differs from the raster source");
+    }
+    if (!forecast_frames_.empty() && valid_time <= forecast_frames_.back().valid_time) {
+        throw std::invalid_argument("forecast frames must be added in ascending valid time");
+    }
+    int frame = static_cast<int>(forecast_frames_.size());
+    uint64_t blocked_edge_count = 0;
+    forecast_frames_.push_back({valid_time, std::move(frame_raster_graph)});
+    // 连续帧中的阻塞合并为一个区间
+    const RasterGraph &raster_graph = forecast_frames_.back().raster_graph;
+    ForEachWeatherEdge(raster_sources_.front(), raster_graph, [&](const UndirectedWaypointPair &edge, char value){
+        if (!raster_graph.IsBlockValue(value)) {
+            return;
+        }
+        auto &intervals = block_interval_map_[edge];
+        if (!intervals.empty() && intervals.back().end_frame >= frame) {
+            // 同一航段在本帧可能经过多个阻塞像素
+            if (intervals.back().end_frame == frame) {
+                blocked_edge_count++;
+            }
+            intervals.back().end_frame = frame + 1;
+        } else {
+            blocked_edge_count++;
+            intervals.push_back({frame, frame + 1});
+        }
+    });
+    blocked_edges_per_frame.Record(blocked_edge_count);
+}
+
+void DynamicRadarAirwayGraph::ClearForecastBlock() {
+    forecast_frames_.clear();
+    block_interval_map_.clear();
+}
+
+int DynamicRadarAirwayGraph::ForecastFrameIndex(double time) const {
+    // 早于第一帧的时刻没有帧，返回-1
+    auto iterator = std::upper_bound(forecast_frames_.begin(), forecast_frames_.end(), time,
+                                     [](double t, const ForecastFrame &frame) {return t < frame.valid_time;});
+    return static_cast<int>(iterator - forecast_frames_.begin()) - 1;
+}
+
+bool DynamicRadarAirwayGraph::FindDetour(const WaypointPair &waypoint_pair,
+                                         const WaypointInfo &info,
+                                         const RasterGraph &raster_graph,
+                                         const WorldFileInfo &world_file_info,
+                                         const WaypointPool &pool,
+                                         std::vector<WaypointPtr> &inserted_waypoints,
+                                         SearchStats *stats,
+                                         DetourEngine detour_engine) const {
+    const Pixel origin = CoordinateToPixel(waypoint_pair.first->coordinate, world_file_info);
+    const Pixel destination = CoordinateToPixel(waypoint_pair.second->coordinate, world_file_info);
+    auto previous_waypoint = info.previous.lock();
+    const Pixel previous_origin = previous_waypoint != nullptr ?
+    CoordinateToPixel(previous_waypoint->coordinate, world_file_info) : kNoPixel;
+    if (stats) {
+        stats->angle_search_calls++;
+    }
+    auto start_time = stats ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+    PixelPath pixel_path = raster_graph.FindPathWithAngle(origin, destination, previous_origin, detour_engine);
+    if (stats) {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_time;
+        stats->angle_search_milliseconds += elapsed.count();
+    }
+    if (pixel_path.empty()) {
+        if (stats) {
+            stats->failed_detours++;
+        }
+        return false;
+    }
+    // 去掉首尾
+    PixelsToWaypoints(pixel_path.begin() + 1, pixel_path.end() - 1, world_file_info, pool, inserted_waypoints);
+    return true;
+}
+
+// 绕行路径的各段在雷达图中都没有阻塞
+static bool IsDetourClear(const WaypointPair &waypoint_pair,
+                          const std::vector<WaypointPtr> &inserted_waypoints,
+                          const RasterGraph &raster_graph,
+                          const WorldFileInfo &world_file_info) {
+    const Waypoint *leg_start = waypoint_pair.first.get();
+    for (size_t i = 0; i <= inserted_waypoints.size(); i++) {
+        const Waypoint *leg_end = i < inserted_waypoints.size() ? inserted_waypoints[i].get() : waypoint_pair.second.get();
+        if (!raster_graph.CheckLine(CoordinateToPixel(leg_start->coordinate, world_file_info),
+                                    CoordinateToPixel(leg_end->coordinate, world_file_info))) {
+            return false;
+        }
+        leg_start = leg_end;
+    }
+    return true;
+}
+
+static GeoDistance DetourDistance(const WaypointPair &waypoint_pair, const std::vector<WaypointPtr> &inserted_waypoints) {
+    GeoDistance distance = 0;
+    const Waypoint *leg_start = waypoint_pair.first.get();
+    for (size_t i = 0; i <= inserted_waypoints.size(); i++) {
+        const Waypoint *leg_end = i < inserted_waypoints.size() ? inserted_waypoints[i].get() : waypoint_pair.second.get();
+        distance += Waypoint::Distance(*leg_start, *leg_end);
+        leg_start = leg_end;
+    }
+    return distance;
+}
+
+bool DynamicRadarAirwayGraph::FindRadarDetour(const WaypointPair &waypoint_pair,
+                                              const WaypointInfo &info,
+                                              const WaypointPool &pool,
+                                              std::vector<WaypointPtr> &inserted_waypoints,
+                                              SearchStats *stats,
+                                              DetourEngine detour_engine) const {
+    for (size_t i = 0; i < raster_sources_.size(); i++) {
+        const RasterSource &source = raster_sources_[i];
+        const WorldFileInfo &w = source.info.world_file_info;
+        // 只在覆盖航段两端的雷达中绕行
+        if (!source.Contains(CoordinateToPixel(waypoint_pair.first->coordinate, w)) ||
+            !source.Contains(CoordinateToPixel(waypoint_pair.second->coordinate, w))) {
+            continue;
+        }
+        if (!FindDetour(waypoint_pair, info, source.raster_graph, w, pool, inserted_waypoints, stats, detour_engine)) {
+            continue;
+        }
+        // 绕行路径不能穿过其他雷达中的天气
+        bool clear = true;
+        for (size_t j = 0; j < raster_sources_.size() && clear; j++) {
+            if (j == i) {
+                continue;
+            }
+            const RasterSource &other_source = raster_sources_[j];
+            clear = IsDetourClear(waypoint_pair, inserted_waypoints, other_source.raster_graph,
+                                  other_source.info.world_file_info);
+        }
+        if (clear) {
+            return true;
+        }
+        inserted_waypoints.clear();
+    }
+    return false;
+}
+
+std::function<bool(const WaypointPair &, const WaypointInfoPair &, std::vector<WaypointPtr> &)>
+DynamicRadarAirwayGraph::DetourCanSearch(const std::function<bool(const WaypointPair &,
+                                                                  const WaypointInfoPair &,
+                                                                  std::vector<WaypointPtr> &)> &can_search,
+                                         const WaypointPool &pool,
+                                         SearchStats *stats,
+                                         DetourEngine detour_engine,
+                                         RouteFootprint *footprint) const {
+    return [this, &can_search, &pool, stats, detour_engine, footprint](const WaypointPair &waypoint_pair,
+                                                                      const WaypointInfoPair &info_pair,
+                                                                      std::vector<WaypointPtr> &inserted_waypoints) {
+        if (!can_search(waypoint_pair, info_pair, inserted_waypoints)) {
+            return false;
+        }
+        if (block_set_.find(UndirectedWaypointPair(waypoint_pair)) == block_set_.end()) {
+            return Waypoint::IsAcuteTurn(info_pair.first.direction, *waypoint_pair.first, *waypoint_pair.second);
+        }
+        if (stats) {
+            stats->blocked_edges++;
+        }
+        if (footprint) {
+            AddDetourFootprint(waypoint_pair, *footprint);
+        }
+        return FindRadarDetour(waypoint_pair, info_pair.first, pool, inserted_waypoints, stats, detour_engine);
+    };
+}
+
+WaypointPath
+DynamicRadarAirwayGraph::FindDynamicFullPathInGraph(const ConstWaypointPtr &origin_waypoint,
+                                                    const ConstWaypointPtr &destination_waypoint,
+                                                    const std::function<bool(const WaypointPair &waypoint_pair,
+                                                                             const WaypointInfoPair &info_pair,
+                                                                             std::vector<WaypointPtr> &inserted_waypoints)> &can_search,
+                                                    SearchStats *stats,
+                                                    DetourEngine detour_engine,
+                                                    RouteFootprint *footprint) const {
+    WaypointPool pool;
+    auto inner_can_search = DetourCanSearch(can_search, pool, stats, detour_engine, footprint);
+    if (!HasIntensity()) {
+        WaypointPath path = FindTurnPathInGraph(origin_waypoint, destination_waypoint, inner_can_search, nullptr, stats);
+        if (stats) {
+            stats->workspace_bytes += pool.AllocatedBytes();
+        }
+        return path;
+    }
+    auto penalty = [&](const WaypointPair &waypoint_pair, const std::vector<WaypointPtr> &inserted_waypoints) {
+        return IntensityPenalty(waypoint_pair, inserted_waypoints);
+    };
+    WaypointPath path = FindTurnPathInGraph(origin_waypoint, destination_waypoint, inner_can_search, penalty, stats);
+    if (stats) {
+        stats->workspace_bytes += pool.AllocatedBytes();
+    }
+    // 搜索代价包含强度惩罚，返回的长度仍为实际距离
+    for (int i = 1; i < path.GetSize(); i++) {
+        path.lengths[i] = path.lengths[i - 1] + Waypoint::Distance(*path.waypoints[i - 1], *path.waypoints[i]);
+    }
+    return path;
+}
+
 WaypointPath
 DynamicRadarAirwayGraph::FindDynamicFullPath(WaypointIdentifier origin_identifier,
                                              WaypointIdentifier destination_identifier,
                                              const std::function<bool(const WaypointPair &waypoint_pair,
                                                                       const WaypointInfoPair &info_pair,
-                                                                      std::vector<WaypointPtr> &inserted_waypoints)> &can_search) const {
-    auto inner_can_search = [&](const WaypointPair &waypoint_pair,
-                                const WaypointInfoPair &info_pair,
-                                std::vector<WaypointPtr> &inserted_waypoints) {
-        if (!can_search(waypoint_pair, info_pair, inserted_waypoints)) {
-            return false;
+                                                                      std::vector<WaypointPtr> &inserted_waypoints)> &can_search,
+                                             SearchStats *stats,
+                                             DetourEngine detour_engine) const {
+    MetricsScope metrics_scope(find_dynamic_full_path_latency, stats);
+    auto origin_waypoint = WaypointFromIdentifier(origin_identifier);
+    auto destination_waypoint = WaypointFromIdentifier(destination_identifier);
+    if (origin_waypoint == nullptr || destination_waypoint == nullptr) {
+        return WaypointPath();
+    }
+    WaypointPath path = FindDynamicFullPathInGraph(origin_waypoint, destination_waypoint, can_search, stats, detour_engine);
+    path.MaterializeNames();
+    return path;
+}
+
+WaypointPath
+DynamicRadarAirwayGraph::FindCachedDynamicFullPath(WaypointIdentifier origin_identifier,
+                                                   WaypointIdentifier destination_identifier,
+                                                   SearchStats *stats,
+                                                   DetourEngine detour_engine) const {
+    MetricsScope metrics_scope(find_cached_dynamic_full_path_latency, stats);
+    auto can_search = [](const WaypointPair &, const WaypointInfoPair &, std::vector<WaypointPtr> &) {return true;};
+    // 强度惩罚依赖搜索到的所有航段，不缓存
+    if (HasIntensity()) {
+        return FindDynamicFullPath(origin_identifier, destination_identifier, can_search, stats, detour_engine);
+    }
+    RouteKey key = {origin_identifier, destination_identifier, detour_engine, turn_search_};
+    WaypointPath path;
+    if (route_cache_.Find(key, path)) {
+        return path;
+    }
+    auto origin_waypoint = WaypointFromIdentifier(origin_identifier);
+    auto destination_waypoint = WaypointFromIdentifier(destination_identifier);
+    if (origin_waypoint == nullptr || destination_waypoint == nullptr) {
+        return WaypointPath();
+    }
+    RouteFootprint footprint;
+    path = FindDynamicFullPathInGraph(origin_waypoint, destination_waypoint, can_search, stats, detour_engine, &footprint);
+    path.MaterializeNames();
+    // 路径经过的航段，绕行点不属于航路网
+    ConstWaypointPtr previous_waypoint;
+    for (auto &waypoint : path.waypoints) {
+        if (waypoint->user_waypoint) {
+            continue;
         }
-        const ConstWaypointPtr &waypoint1 = waypoint_pair.first;
-        const ConstWaypointPtr &waypoint2 = waypoint_pair.second;
-        const WaypointInfo &waypoint_info1 = info_pair.first;
-        if (block_set_.find(UndirectedWaypointPair(waypoint_pair)) == block_set_.end()) {
-            if (waypoint_info1.previous.lock() == nullptr) {
-                return true;
-            } else if (Waypoint::CosinTurnAngle(*waypoint_info1.previous.lock(), *waypoint1, *waypoint2) > 0) {
+        if (previous_waypoint != nullptr) {
+            footprint.edges.insert(UndirectedWaypointPair(WaypointPair(previous_waypoint, waypoint)));
+        }
+        previous_waypoint = waypoint;
+    }
+    route_cache_.Insert(key, path, footprint.edges, footprint.tiles);
+    return path;
+}
+
+std::vector<WaypointPtr> DynamicRadarAirwayGraph::AttachWaypoints(const Waypoint &location_waypoint) const {
+    const int kCandidateCount = 8;
+    // 只连接航路上的航路点
+    auto candidates = waypoint_index_.Nearest(location_waypoint.GetLocation(), kCandidateCount, [](const Waypoint &waypoint) {
+        return !waypoint.neibors.empty() && !waypoint.user_waypoint;
+    });
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](const WaypointPtr &candidate) {
+        for (auto &source : raster_sources_) {
+            const WorldFileInfo &w = source.info.world_file_info;
+            if (!source.raster_graph.CheckLine(CoordinateToPixel(location_waypoint.coordinate, w),
+                                               CoordinateToPixel(candidate->coordinate, w))) {
                 return true;
-            } else {
-                return false;
             }
         }
-        const Pixel origin = CoordinateToPixel(waypoint1->coordinate, world_file_info_);
-        const Pixel destination = CoordinateToPixel(waypoint2->coordinate, world_file_info_);
-        const Pixel previous_origin = waypoint_info1.previous.lock() != nullptr ?
-        CoordinateToPixel(waypoint_info1.previous.lock()->coordinate, world_file_info_) : kNoPixel;
-        PixelPath pixel_path = raster_graph_.FindPathWithAngle(origin, destination, previous_origin);
-        if (pixel_path.empty()) {
+        return false;
+    }), candidates.end());
+    return candidates;
+}
+
+WaypointPath
+DynamicRadarAirwayGraph::FindDynamicFullPath(const GeoPoint &origin_location,
+                                             const GeoPoint &destination_location,
+                                             const std::function<bool(const WaypointPair &waypoint_pair,
+                                                                      const WaypointInfoPair &info_pair,
+                                                                      std::vector<WaypointPtr> &inserted_waypoints)> &can_search,
+                                             SearchStats *stats,
+                                             DetourEngine detour_engine) const {
+    MetricsScope metrics_scope(find_dynamic_full_path_latency, stats);
+    auto make_location_waypoint = [](const GeoPoint &location) {
+        auto waypoint = std::make_shared<Waypoint>(kNoWaypointIdentifier, std::string(), location.longitude, location.latitude);
+        LonLatToMerc(location.longitude, location.latitude, &waypoint->coordinate.x, &waypoint->coordinate.y);
+        waypoint->user_waypoint = true;
+        return waypoint;
+    };
+    auto origin_waypoint = make_location_waypoint(origin_location);
+    auto destination_waypoint = make_location_waypoint(destination_location);
+    auto origin_attach_waypoints = AttachWaypoints(*origin_waypoint);
+    if (origin_attach_waypoints.empty()) {
+        return WaypointPath();
+    }
+    auto &origin_attach_waypoint = origin_attach_waypoints.front();
+    // 起点只有指向航路的单向连接，不修改图本身
+    origin_waypoint->neibors.push_back(Neighbor(origin_attach_waypoint,
+                                                Waypoint::Distance(*origin_waypoint, *origin_attach_waypoint),
+                                                Waypoint::Direction(*origin_waypoint, *origin_attach_waypoint)));
+    // 到达连接点的航路与终点航段的转角也须小于90度，不满足时改用下一个连接点
+    for (auto &destination_attach_waypoint : AttachWaypoints(*destination_waypoint)) {
+        WaypointPath path = FindDynamicFullPathInGraph(origin_waypoint, destination_attach_waypoint, can_search, stats, detour_engine);
+        if (path.GetSize() == 0) {
+            continue;
+        }
+        const Waypoint &previous_waypoint = *path.waypoints[path.GetSize() - 2];
+        if (!Waypoint::IsAcuteTurn(Waypoint::Direction(previous_waypoint, *destination_attach_waypoint),
+                                   *destination_attach_waypoint, *destination_waypoint)) {
+            continue;
+        }
+        path.waypoints.push_back(destination_waypoint);
+        path.lengths.push_back(path.lengths.back() + Waypoint::Distance(*destination_attach_waypoint, *destination_waypoint));
+        path.MaterializeNames();
+        return path;
+    }
+    return WaypointPath();
+}
+
+std::vector<WaypointPtr> DynamicRadarAirwayGraph::NearestWaypoints(const GeoPoint &location, int k) const {
+    return waypoint_index_.Nearest(location, k);
+}
+
+std::vector<WaypointPtr> DynamicRadarAirwayGraph::WaypointsWithin(const GeoPoint &location, GeoDistance radius) const {
+    return waypoint_index_.Within(location, radius);
+}
+
+WaypointPath
+DynamicRadarAirwayGraph::FindTimeDependentPath(WaypointIdentifier origin_identifier,
+                                               WaypointIdentifier destination_identifier,
+                                               double departure_time,
+                                               double ground_speed,
+                                               SearchStats *stats) const {
+    if (ground_speed <= 0) {
+        throw std::invalid_argument("ground speed must be positive");
+    }
+    MetricsScope metrics_scope(find_time_dependent_path_latency, stats);
+    if (forecast_frames_.empty()) {
+        return FindDynamicFullPath(origin_identifier, destination_identifier,
+                                   [](const WaypointPair &, const WaypointInfoPair &, std::vector<WaypointPtr> &) {return true;},
+                                   stats);
+    }
+    WaypointPool pool;
+    auto time_can_search = [&](const WaypointPair &waypoint_pair,
+                               const WaypointInfoPair &info_pair,
+                               std::vector<WaypointPtr> &inserted_waypoints) {
+        // 飞越该航段期间涉及的帧
+        double enter_time = departure_time + info_pair.first.actual_distance / ground_speed;
+        double leave_time = enter_time + Waypoint::Distance(*waypoint_pair.first, *waypoint_pair.second) / ground_speed;
+        int enter_frame = ForecastFrameIndex(enter_time);
+        int leave_frame = ForecastFrameIndex(leave_time);
+        int blocked_frame = -1;
+        auto iterator = block_interval_map_.find(UndirectedWaypointPair(waypoint_pair));
+        if (iterator != block_interval_map_.end()) {
+            for (auto &interval : iterator->second) {
+                if (interval.begin_frame <= leave_frame && enter_frame < interval.end_frame) {
+                    blocked_frame = std::max(interval.begin_frame, enter_frame);
+                    break;
+                }
+            }
+        }
+        if (blocked_frame < 0) {
+            return Waypoint::IsAcuteTurn(info_pair.first.direction, *waypoint_pair.first, *waypoint_pair.second);
+        }
+        if (stats) {
+            stats->blocked_edges++;
+        }
+        // 绕行在第一个发生阻塞的帧中搜索
+        const WorldFileInfo &world_file_info = raster_sources_.front().info.world_file_info;
+        if (!FindDetour(waypoint_pair, info_pair.first, forecast_frames_[blocked_frame].raster_graph,
+                        world_file_info, pool, inserted_waypoints, stats, DetourEngine::kLadder)) {
             return false;
-        } else {
-            // 去掉首尾
-            inserted_waypoints.resize(pixel_path.size() - 2);
-            std::transform(pixel_path.begin() + 1,
-                           pixel_path.end() - 1,
-                           inserted_waypoints.begin(),
-                           [&](const Pixel &pixel){
-                return PixelToWaypoint(pixel, world_file_info_);
-            });
-            return true;
         }
+        // 绕行比航段长，飞越期间的每一帧都不能阻塞绕行路径
+        int detour_leave_frame = ForecastFrameIndex(enter_time + DetourDistance(waypoint_pair, inserted_waypoints) / ground_speed);
+        for (int frame = std::max(enter_frame, 0); frame <= detour_leave_frame; frame++) {
+            if (frame != blocked_frame &&
+                !IsDetourClear(waypoint_pair, inserted_waypoints, forecast_frames_[frame].raster_graph, world_file_info)) {
+                inserted_waypoints.clear();
+                return false;
+            }
+        }
+        return true;
     };
-    return FindPath(origin_identifier, destination_identifier, inner_can_search);
+    WaypointPath path = FindTurnPath(origin_identifier, destination_identifier, time_can_search, stats);
+    if (stats) {
+        stats->workspace_bytes += pool.AllocatedBytes();
+    }
+    path.MaterializeNames();
+    return path;
 }
 
 std::vector<WaypointPath>
 DynamicRadarAirwayGraph::FindKDynamicFullPath(WaypointIdentifier origin_identifier,
                                               WaypointIdentifier destination_identifier,
-                                              int k) const {
+                                              int k,
+                                              SearchStats *stats,
+                                              DetourEngine detour_engine) const {
+    MetricsScope metrics_scope(find_k_dynamic_full_path_latency, stats);
     auto find_path = [&](const ConstWaypointPtr &spur_waypoint,
                          const ConstWaypointPtr &destination_waypoint,
                          const std::set<WaypointPair> &block_set) {
@@ -209,9 +902,48 @@ DynamicRadarAirwayGraph::FindKDynamicFullPath(WaypointIdentifier origin_identifi
         };
         return FindDynamicFullPath(spur_waypoint->identifier,
                                    destination_waypoint->identifier,
-                                   can_search);
+                                   can_search,
+                                   stats,
+                                   detour_engine);
     };
-    return FindKPath(origin_identifier, destination_identifier, k, find_path);
+    return FindKPath(origin_identifier, destination_identifier, k, find_path, stats);
+}
+
+std::vector<WaypointPath>
+DynamicRadarAirwayGraph::FindParetoDynamicFullPath(WaypointIdentifier origin_identifier,
+                                                   WaypointIdentifier destination_identifier,
+                                                   double turn_epsilon,
+                                                   SearchStats *stats,
+                                                   DetourEngine detour_engine) const {
+    MetricsScope metrics_scope(find_pareto_dynamic_full_path_latency, stats);
+    auto origin_waypoint = WaypointFromIdentifier(origin_identifier);
+    auto destination_waypoint = WaypointFromIdentifier(destination_identifier);
+    if (origin_waypoint == nullptr || destination_waypoint == nullptr) {
+        return std::vector<WaypointPath>();
+    }
+    WaypointPool pool;
+    std::function<bool(const WaypointPair &, const WaypointInfoPair &, std::vector<WaypointPtr> &)> can_search =
+    [](const WaypointPair &, const WaypointInfoPair &, std::vector<WaypointPtr> &) {return true;};
+    auto inner_can_search = DetourCanSearch(can_search, pool, stats, detour_engine, nullptr);
+    std::function<GeoDistance(const WaypointPair &, const std::vector<WaypointPtr> &)> penalty;
+    if (HasIntensity()) {
+        penalty = [&](const WaypointPair &waypoint_pair, const std::vector<WaypointPtr> &inserted_waypoints) {
+            return IntensityPenalty(waypoint_pair, inserted_waypoints);
+        };
+    }
+    std::vector<WaypointPath> paths = FindParetoPathInGraph(origin_waypoint, destination_waypoint, inner_can_search,
+                                                            turn_epsilon, penalty, stats);
+    if (stats) {
+        stats->workspace_bytes += pool.AllocatedBytes();
+    }
+    for (auto &path : paths) {
+        // 搜索代价包含强度惩罚，返回的长度仍为实际距离
+        for (int i = 1; i < path.GetSize(); i++) {
+            path.lengths[i] = path.lengths[i - 1] + Waypoint::Distance(*path.waypoints[i - 1], *path.waypoints[i]);
+        }
+        path.MaterializeNames();
+    }
+    return paths;
 }
 
 }  // namespace dwr
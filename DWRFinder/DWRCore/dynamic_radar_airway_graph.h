@@ -9,11 +9,16 @@
 #ifndef dynamic_radar_airway_graph_h
 #define dynamic_radar_airway_graph_h
 
+#include <map>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
 #include "dynamic_airway_graph.h"
 #include "raster_graph.h"
+#include "route_cache.h"
+#include "route_registry.h"
+#include "waypoint_index.h"
 
 namespace dwr {
 
@@ -31,7 +36,55 @@ struct WorldFileInfo {
     WorldFileInfo(const char *path);
 };
 
+/**
+ A radar whose frames are georeferenced by a world file. Edges are indexed only on the
+ pixels inside the width and height, and a width or height of 0 indexes the whole pixel
+ plane.
+ */
+struct RasterSourceInfo {
+    WorldFileInfo world_file_info;
+    int width;
+    int height;
+    RasterSourceInfo() : width(0), height(0) {}
+    RasterSourceInfo(const WorldFileInfo &world_file_info, int width = 0, int height = 0)
+    : world_file_info(world_file_info), width(width), height(height) {}
+};
+
+/**
+ Frames [begin_frame, end_frame) of the forecast sequence in which an edge is blocked.
+ */
+struct BlockInterval {
+    int begin_frame;
+    int end_frame;
+};
+
+/**
+ Ring of a weather area such as a SIGMET or convective polygon, in radian. The ring is
+ closed implicitly.
+ */
+using GeoPolygon = std::vector<GeoPoint>;
+
+/**
+ What an update changed, e.g. for repairing the routes of a FlightPlanner.
+ */
+struct BlockChange {
+    // Edges whose blocking changed.
+    std::vector<UndirectedWaypointPair> blocked_edges;
+    std::vector<UndirectedWaypointPair> cleared_edges;
+    // Tiles whose weather changed, so the detours through them may change.
+    std::vector<RouteCache::TileKey> changed_tiles;
+    // The raster was resized and every detour may change.
+    bool all_tiles_changed = false;
+    // Registered routes flying the newly blocked edges or detouring through the changed tiles,
+    // see RegisterRoute.
+    std::vector<RouteImpact> route_impacts;
+};
+
+class WaypointPool;
+
 class DynamicRadarAirwayGraph: public DynamicAirwayGraph {
+    // Searches with the block set and the detours.
+    friend class FlightPlanner;
 public:
     /**
      SingleBuild all waypoint with world file.
@@ -39,6 +92,18 @@ public:
      @param world_file_info World file.
      */
     void Build(const WorldFileInfo &world_file_info);
+
+    /**
+     SingleBuild all waypoint with several radars. The pixel to edge index of each source is
+     built on its own thread. An edge is blocked when any source blocks it.
+
+     Blocks, polygons and forecast frames of a previous Build are discarded.
+
+     @param raster_sources Radars, addressed by their index in UpdateBlock.
+     */
+    void Build(const std::vector<RasterSourceInfo> &raster_sources);
+
+    int GetRasterSourceCount() const {return static_cast<int>(raster_sources_.size());}
     
     /**
      SingleBuild single waypoint if necessary after prebuilding.
@@ -49,16 +114,68 @@ public:
     /**
      Update the mask.
 
-     @param mask Bitmap that 1 means block and 0 means non-block.
+     @param mask Bitmap in which positive values block and 0 means non-block.
+     @param width Width of mask pixel
+     @param height Height of mask pixel
+     @return Edges whose blocking changed.
+     */
+    BlockChange UpdateBlock(char *mask, int width, int height);
+
+    /**
+     Update the mask of one radar. The other radars keep their last frame, and only the edges
+     whose blocking changes are updated. Frames of different radars may be given from
+     different threads at the same time, but not while searching.
+
+     @param source_index Index of the radar in Build.
+     @param mask Bitmap in which positive values block and 0 means non-block.
      @param width Width of mask pixel
      @param height Height of mask pixel
+     @return Edges whose blocking changed.
+     */
+    BlockChange UpdateBlock(int source_index, char *mask, int width, int height);
+
+    /**
+     Update the weather with a quantized intensity raster. Pixels from block_level block the
+     airways crossing them, lower non-zero levels make the airways and detours more expensive.
+
+     @param intensity Bitmap of intensity level, 0 means clear sky.
+     @param width Width of intensity pixel
+     @param height Height of intensity pixel
+     @param block_level Level from which a pixel blocks, 1 to 255.
+     @param intensity_weight Crossing a pixel of level L costs (1 + intensity_weight * L) times its length.
+     @return Edges whose blocking changed.
+     @throw std::invalid_argument When block_level is out of range.
      */
-    void UpdateBlock(char *mask, int width, int height);
+    BlockChange UpdateIntensity(char *intensity, int width, int height, int block_level, double intensity_weight);
+
+    /**
+     Update the intensity raster of one radar, see UpdateBlock and UpdateIntensity above.
+     */
+    BlockChange UpdateIntensity(int source_index, char *intensity, int width, int height,
+                                int block_level, double intensity_weight);
+
+    /**
+     Block the weather areas given as polygons. The areas are scanline filled on the pixel grid
+     of the world file and merged with the radar mask, so both the blocked airways and the
+     detours avoid them. Each call replaces the polygons of the previous one.
+
+     @param polygons Weather areas.
+     @return Edges whose blocking changed.
+     */
+    BlockChange UpdateBlockPolygons(const std::vector<GeoPolygon> &polygons);
+
+    /**
+     Remove the weather areas given by UpdateBlockPolygons.
+     */
+    BlockChange ClearBlockPolygons();
     /**
      Find path with double scale A* search.
 
      @param origin_identifier Origin waypoint identifier.
      @param destination_identifier Destination waypoint identifier.
+     @param can_search The function using to determine whether the edge can be access.
+     @param stats Counters of the search are added to it, nullptr for none.
+     @param detour_engine Search for the detours around the blocked edges.
      @return Path consists of waypoints.
      */
     WaypointPath
@@ -69,18 +186,274 @@ public:
                                                  std::vector<WaypointPtr> &inserted_waypoints)> &can_search
                         = [](const WaypointPair &,
                              const WaypointInfoPair &,
-                             std::vector<WaypointPtr> &inserted_waypoints) {return true;}
-                        ) const;
+                             std::vector<WaypointPtr> &inserted_waypoints) {return true;},
+                        SearchStats *stats = nullptr,
+                        DetourEngine detour_engine = DetourEngine::kLadder) const;
     
+    /**
+     Find path between two locations off the airway network. Each location is connected by a
+     straight leg to the nearest waypoint which is on an airway and can be reached without
+     crossing the weather. The turn onto the destination leg is kept less than 90 degrees as
+     along the airways, and a farther waypoint is tried for the destination when it is not.
+
+     @param origin_location Origin location.
+     @param destination_location Destination location.
+     @param can_search The function using to determine whether the edge can be access.
+     @param stats Counters of the search are added to it, nullptr for none.
+     @param detour_engine Search for the detours around the blocked edges.
+     @return Path from origin location to destination location, empty when either has no reachable waypoint.
+     */
+    WaypointPath
+    FindDynamicFullPath(const GeoPoint &origin_location,
+                        const GeoPoint &destination_location,
+                        const std::function<bool(const WaypointPair &waypoint_pair,
+                                                 const WaypointInfoPair &info_pair,
+                                                 std::vector<WaypointPtr> &inserted_waypoints)> &can_search
+                        = [](const WaypointPair &,
+                             const WaypointInfoPair &,
+                             std::vector<WaypointPtr> &inserted_waypoints) {return true;},
+                        SearchStats *stats = nullptr,
+                        DetourEngine detour_engine = DetourEngine::kLadder) const;
+
+    /**
+     Find the nearest waypoints of a location, using the index made by Build.
+
+     @param location Location.
+     @param k Number of waypoints.
+     @return At most k waypoints ordered by distance.
+     */
+    std::vector<WaypointPtr> NearestWaypoints(const GeoPoint &location, int k) const;
+
+    /**
+     Find the waypoints within a distance of a location, using the index made by Build.
+
+     @param location Location.
+     @param radius Distance in meter.
+     @return Waypoints ordered by distance.
+     */
+    std::vector<WaypointPtr> WaypointsWithin(const GeoPoint &location, GeoDistance radius) const;
+
+    /**
+     Find path as FindDynamicFullPath, answering repeated queries from the route cache. A
+     cached route is kept across radar and polygon updates until the blocking of an edge it
+     uses or whose detour it tried changes, or the weather changes in the tiles around those
+     detours. Routes are searched without caching while intensity weighting is on.
+
+     @param origin_identifier Origin waypoint identifier.
+     @param destination_identifier Destination waypoint identifier.
+     @param stats Counters of the search are added to it, nullptr for none. Nothing is added on a cache hit.
+     @param detour_engine Search for the detours around the blocked edges.
+     @return Path consists of waypoints.
+     */
+    WaypointPath
+    FindCachedDynamicFullPath(WaypointIdentifier origin_identifier,
+                              WaypointIdentifier destination_identifier,
+                              SearchStats *stats = nullptr,
+                              DetourEngine detour_engine = DetourEngine::kLadder) const;
+
+    /**
+     Set the number of routes kept by FindCachedDynamicFullPath, 1024 by default.
+     */
+    void SetRouteCacheCapacity(size_t capacity) {route_cache_.SetCapacity(capacity);}
+
+    void ClearRouteCache() {route_cache_.Clear();}
+
+    size_t GetRouteCacheSize() const {return route_cache_.GetSize();}
+
+    /**
+     Register an active route. Each update reports in BlockChange::route_impacts the registered
+     routes flying an edge it blocks, or detouring through a tile whose weather it changes, found
+     from the changed edges and tiles only.
+
+     @param route_identifier Identifier chosen by the caller, replacing the route registered with it.
+     @param path Route, e.g. returned by FindDynamicFullPath.
+     */
+    void RegisterRoute(RouteIdentifier route_identifier, const WaypointPath &path);
+
+    /**
+     @return False when the route is not registered.
+     */
+    bool UnregisterRoute(RouteIdentifier route_identifier) {return route_registry_.Unregister(route_identifier);}
+
+    size_t GetRegisteredRouteCount() const {return route_registry_.GetSize();}
+
     std::vector<WaypointPath>
     FindKDynamicFullPath(WaypointIdentifier origin_identifier,
                          WaypointIdentifier destination_identifier,
-                         int k) const;
+                         int k,
+                         SearchStats *stats = nullptr,
+                         DetourEngine detour_engine = DetourEngine::kLadder) const;
+
+    /**
+     Intensity cost added by the search for flying an edge, directly or through a detour: the
+     length of each leg times the intensity weight and the mean level of the pixels on it. The
+     largest cost among the radars covering the edge is taken.
+
+     @param waypoint_pair Edge.
+     @param inserted_waypoints Detour points, empty for the direct edge.
+     @return The cost in meters, 0 without UpdateIntensity.
+     */
+    GeoDistance IntensityPenalty(const WaypointPair &waypoint_pair,
+                                 const std::vector<WaypointPtr> &inserted_waypoints) const;
+
+    /**
+     Find the routes trading distance against the sum of the turn angles in one search, instead
+     of ranking k shortest paths by WaypointPath::GetSumTurn. See FindParetoPathInGraph.
+
+     @param origin_identifier Origin waypoint identifier.
+     @param destination_identifier Destination waypoint identifier.
+     @param turn_epsilon Turn in radians by which a returned route may exceed a dropped one, 0 for the whole front.
+     @param stats Counters of the search are added to it, nullptr for none.
+     @param detour_engine Search for the detours around the blocked edges.
+     @return Routes none of which is both longer and turning more than another, shortest first.
+     @throw std::invalid_argument When turn_epsilon is negative.
+     */
+    std::vector<WaypointPath>
+    FindParetoDynamicFullPath(WaypointIdentifier origin_identifier,
+                              WaypointIdentifier destination_identifier,
+                              double turn_epsilon = 0,
+                              SearchStats *stats = nullptr,
+                              DetourEngine detour_engine = DetourEngine::kLadder) const;
+
+    /**
+     Append a forecast frame on the grid of the first radar. Frames must be added in ascending
+     valid time, and each one applies from its valid time until the next frame. No weather is
+     forecast before the valid time of the first frame.
+
+     @param valid_time Seconds after the reference time from which the frame applies.
+     @param mask Bitmap in which positive values block and 0 means non-block.
+     @param width Width of mask pixel
+     @param height Height of mask pixel
+     @throw std::logic_error When the graph is not built.
+     @throw std::invalid_argument When valid_time is not after the last frame or the size differs from the first radar.
+     */
+    void AddForecastBlock(double valid_time, char *mask, int width, int height);
+
+    /**
+     Remove all forecast frames.
+     */
+    void ClearForecastBlock();
+
+    /**
+     Find path over the forecast frames. Blocks and detours of an edge are taken from the
+     frames covering the time the flight spends on it. A detour is searched in the first frame
+     blocking the edge, and its legs must be clear in every frame until the flight leaves the
+     longer detour. The frames replace the observed weather:
+     the blocks of UpdateBlock, UpdateIntensity and UpdateBlockPolygons are only used when no
+     frame is added, as by FindDynamicFullPath.
+
+     @param origin_identifier Origin waypoint identifier.
+     @param destination_identifier Destination waypoint identifier.
+     @param departure_time Seconds after the reference time when leaving the origin.
+     @param ground_speed Ground speed in meter per second.
+     @param stats Counters of the search are added to it, nullptr for none.
+     @return Path consists of waypoints.
+     @throw std::invalid_argument When ground_speed is not positive.
+     */
+    WaypointPath
+    FindTimeDependentPath(WaypointIdentifier origin_identifier,
+                          WaypointIdentifier destination_identifier,
+                          double departure_time,
+                          double ground_speed,
+                          SearchStats *stats = nullptr) const;
 
 private:
-    std::unordered_map<Pixel, std::vector<UndirectedWaypointPair>> pixel_to_edge_table_;
-    RasterGraph raster_graph_;
-    WorldFileInfo world_file_info_;
+    struct ForecastFrame {
+        double valid_time;
+        RasterGraph raster_graph;
+    };
+
+    struct RasterSource {
+        RasterSourceInfo info;
+        std::unordered_map<Pixel, std::vector<UndirectedWaypointPair>> pixel_to_edge_table;
+        RasterGraph raster_graph;
+        std::set<UndirectedWaypointPair> block_set;
+        // Sum of the intensity levels on the pixels of the edges which are penalized but not blocked.
+        std::map<UndirectedWaypointPair, int> intensity_map;
+
+        bool Contains(const Pixel &pixel) const;
+        void IndexEdge(const UndirectedWaypointPair &edge);
+    };
+
+    std::vector<RasterSource> raster_sources_;
+    WaypointIndex waypoint_index_;
+    std::vector<ForecastFrame> forecast_frames_;
+    std::map<UndirectedWaypointPair, std::vector<BlockInterval>> block_interval_map_;
+    std::set<UndirectedWaypointPair> polygon_block_set_;
+    // Number of sources and polygons blocking each edge of block_set_.
+    std::map<UndirectedWaypointPair, int> block_count_map_;
+    std::mutex update_mutex_;
+    mutable RouteCache route_cache_;
+    RouteRegistry route_registry_;
+
+    // Edges and tiles a route depends on, see FindCachedDynamicFullPath.
+    struct RouteFootprint {
+        std::set<UndirectedWaypointPair> edges;
+        std::set<RouteCache::TileKey> tiles;
+    };
+
+    RasterSource &RasterSourceAt(int source_index);
+
+    BlockChange ReplaceRaster(int source_index, RasterGraph raster_graph);
+
+    BlockChange ReplaceBlockSet(std::set<UndirectedWaypointPair> &current_block_set,
+                                std::set<UndirectedWaypointPair> block_set);
+
+    void AddDetourFootprint(const WaypointPair &waypoint_pair, RouteFootprint &footprint) const;
+
+    void ForEachWeatherEdge(const RasterSource &source,
+                            const RasterGraph &raster_graph,
+                            const std::function<void(const UndirectedWaypointPair &edge, char value)> &traverse_function) const;
+
+    bool HasIntensity() const;
+
+    // Frame applying at a time, -1 before the first frame.
+    int ForecastFrameIndex(double time) const;
+
+    /**
+     Waypoints on an airway among the nearest ones of a location, reachable by a straight leg
+     clear of the weather, nearest first.
+     */
+    std::vector<WaypointPtr> AttachWaypoints(const Waypoint &location_waypoint) const;
+
+    /**
+     can_search of the full path searches: the edges accepted by can_search are searched around
+     the weather, and the turn of less than 90 degrees is kept.
+     */
+    std::function<bool(const WaypointPair &, const WaypointInfoPair &, std::vector<WaypointPtr> &)>
+    DetourCanSearch(const std::function<bool(const WaypointPair &waypoint_pair,
+                                             const WaypointInfoPair &info_pair,
+                                             std::vector<WaypointPtr> &inserted_waypoints)> &can_search,
+                    const WaypointPool &pool,
+                    SearchStats *stats,
+                    DetourEngine detour_engine,
+                    RouteFootprint *footprint) const;
+
+    WaypointPath
+    FindDynamicFullPathInGraph(const ConstWaypointPtr &origin_waypoint,
+                               const ConstWaypointPtr &destination_waypoint,
+                               const std::function<bool(const WaypointPair &waypoint_pair,
+                                                        const WaypointInfoPair &info_pair,
+                                                        std::vector<WaypointPtr> &inserted_waypoints)> &can_search,
+                               SearchStats *stats,
+                               DetourEngine detour_engine,
+                               RouteFootprint *footprint = nullptr) const;
+
+    bool FindDetour(const WaypointPair &waypoint_pair,
+                    const WaypointInfo &info,
+                    const RasterGraph &raster_graph,
+                    const WorldFileInfo &world_file_info,
+                    const WaypointPool &pool,
+                    std::vector<WaypointPtr> &inserted_waypoints,
+                    SearchStats *stats,
+                    DetourEngine detour_engine) const;
+
+    bool FindRadarDetour(const WaypointPair &waypoint_pair,
+                         const WaypointInfo &info,
+                         const WaypointPool &pool,
+                         std::vector<WaypointPtr> &inserted_waypoints,
+                         SearchStats *stats,
+                         DetourEngine detour_engine) const;
 };
     
 }
@@ -0,0 +1,347 @@
+//
+//  flight_planner.cc
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/23.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include "flight_planner.h"
+
+#include <stdexcept>
+
+#include "metrics.h"
+
+namespace dwr {
+
+static const Histogram flight_planner_plan_latency =
+MetricsRegistry::Default().AddHistogram("dwr_flight_planner_plan_seconds", "Latency of FlightPlanner::Plan.", 1e-6);
+
+static const GeoDistance kInfinity = std::numeric_limits<GeoDistance>::infinity();
+
+FlightPlanner::FlightPlanner(const DynamicRadarAirwayGraph &graph,
+                             WaypointIdentifier origin_identifier,
+                             WaypointIdentifier destination_identifier,
+                             DetourEngine detour_engine) :
+graph_(graph), detour_engine_(detour_engine) {
+    ConstWaypointPtr origin_waypoint = graph_.WaypointFromIdentifier(origin_identifier);
+    destination_ = graph_.WaypointFromIdentifier(destination_identifier);
+    if (origin_waypoint == nullptr || destination_ == nullptr) {
+        throw std::invalid_argument("waypoint not in the graph");
+    }
+    start_ = {nullptr, origin_waypoint};
+    last_start_ = start_;
+    // 到达终点的所有状态都是目标
+    for (auto &neibor : destination_->neibors) {
+        State goal = {neibor.target.lock(), destination_};
+        Enqueue(goal, Info(goal));
+    }
+}
+
+FlightPlanner::StateInfo &FlightPlanner::Info(const State &state) {
+    auto result = state_map_.emplace(state, StateInfo());
+    if (result.second && IsGoal(state)) {
+        result.first->second.rhs = 0;
+    }
+    return result.first->second;
+}
+
+GeoDistance FlightPlanner::GetG(const State &state) const {
+    auto iterator = state_map_.find(state);
+    return iterator != state_map_.end() ? iterator->second.g : kInfinity;
+}
+
+GeoDistance FlightPlanner::Heuristic(const State &state) const {
+    return Waypoint::ChordDistance(*start_.waypoint, *state.waypoint);
+}
+
+FlightPlanner::Key FlightPlanner::CalculateKey(const State &state, const StateInfo &info) const {
+    GeoDistance cost = std::min(info.g, info.rhs);
+    return Key(cost + Heuristic(state) + key_modifier_, cost);
+}
+
+void FlightPlanner::Enqueue(const State &state, StateInfo &info) {
+    info.key = CalculateKey(state, info);
+    info.queued = true;
+    open_list_.insert(std::make_pair(info.key, state));
+    if (stats_) {
+        stats_->heap_pushes++;
+    }
+}
+
+void FlightPlanner::Dequeue(const State &state, StateInfo &info) {
+    if (info.queued) {
+        open_list_.erase(std::make_pair(info.key, state));
+        info.queued = false;
+    }
+}
+
+GeoDistance FlightPlanner::TransitionCost(const Transition &transition, GeoDistance distance) {
+    if (stats_) {
+        stats_->can_search_calls++;
+    }
+    UndirectedWaypointPair edge(WaypointPair(transition.waypoint, transition.next));
+    if (graph_.block_set_.find(edge) == graph_.block_set_.end()) {
+        GeoProj direction = transition.previous != nullptr ?
+        Waypoint::Direction(*transition.previous, *transition.waypoint) : kNoDirection;
+        return Waypoint::IsAcuteTurn(direction, *transition.waypoint, *transition.next) ? distance : kInfinity;
+    }
+    auto iterator = detour_map_.find(transition);
+    if (iterator != detour_map_.end()) {
+        return iterator->second.cost;
+    }
+    if (stats_) {
+        stats_->blocked_edges++;
+    }
+    // 绕行依赖前一航路点，按转移缓存
+    Detour detour;
+    WaypointInfo info;
+    info.previous = transition.previous;
+    detour.cost = kInfinity;
+    if (graph_.FindRadarDetour(WaypointPair(transition.waypoint, transition.next), info, pool_,
+                               detour.inserted_waypoints, stats_, detour_engine_)) {
+        const Waypoint *leg_start = transition.waypoint.get();
+        detour.cost = 0;
+        for (auto &waypoint : detour.inserted_waypoints) {
+            detour.cost += Waypoint::Distance(*leg_start, *waypoint);
+            leg_start = waypoint.get();
+        }
+        detour.cost += Waypoint::Distance(*leg_start, *transition.next);
+        if (stats_) {
+            stats_->inserted_waypoints += detour.inserted_waypoints.size();
+        }
+    }
+    GeoDistance cost = detour.cost;
+    detour_map_.emplace(transition, std::move(detour));
+    std::vector<Transition> &transitions = detour_edge_map_[edge];
+    if (transitions.empty()) {
+        // 与路径缓存相同的绕行窗口
+        DynamicRadarAirwayGraph::RouteFootprint footprint;
+        graph_.AddDetourFootprint(edge, footprint);
+        for (auto tile : footprint.tiles) {
+            tile_edge_map_[tile].insert(edge);
+        }
+    }
+    transitions.push_back(transition);
+    return cost;
+}
+
+void FlightPlanner::ForEachPredecessor(const State &state,
+                                       const std::function<void(const State &predecessor, GeoDistance distance)> &function) const {
+    GeoDistance distance = kInfinity;
+    for (auto &neibor : state.waypoint->neibors) {
+        if (neibor.target.lock() == state.previous) {
+            distance = neibor.distance;
+            break;
+        }
+    }
+    if (state.previous == nullptr || distance == kInfinity) {
+        return;
+    }
+    // 航路无向，前一航路点的邻居即为前驱状态的来向
+    bool start_found = false;
+    for (auto &neibor : state.previous->neibors) {
+        State predecessor = {neibor.target.lock(), state.previous};
+        start_found = start_found || predecessor == start_;
+        function(predecessor, distance);
+    }
+    if (!start_found && start_.waypoint == state.previous) {
+        function(start_, distance);
+    }
+}
+
+void FlightPlanner::UpdateState(const State &state) {
+    StateInfo &info = Info(state);
+    if (!IsGoal(state)) {
+        info.rhs = kInfinity;
+        for (auto &neibor : state.waypoint->neibors) {
+            State successor = {state.waypoint, neibor.target.lock()};
+            GeoDistance g = GetG(successor);
+            if (g == kInfinity) {
+                continue;
+            }
+            info.rhs = std::min(info.rhs, TransitionCost({state.previous, state.waypoint, successor.waypoint}, neibor.distance) + g);
+        }
+    }
+    Dequeue(state, info);
+    if (info.g != info.rhs) {
+        Enqueue(state, info);
+    }
+}
+
+void FlightPlanner::ComputeShortestPath() {
+    Info(start_);
+    while (!open_list_.empty()) {
+        const StateInfo &start_info = state_map_[start_];
+        if (!(open_list_.begin()->first < CalculateKey(start_, start_info)) && start_info.rhs <= start_info.g) {
+            break;
+        }
+        State state = open_list_.begin()->second;
+        StateInfo &info = state_map_[state];
+        Key new_key = CalculateKey(state, info);
+        if (info.key < new_key) {
+            // 起点移动后键值过期
+            Dequeue(state, info);
+            Enqueue(state, info);
+        } else if (info.g > info.rhs) {
+            Dequeue(state, info);
+            info.g = info.rhs;
+            if (stats_) {
+                stats_->nodes_settled++;
+            }
+            GeoDistance g = info.g;
+            ForEachPredecessor(state, [&](const State &predecessor, GeoDistance distance) {
+                if (IsGoal(predecessor)) {
+                    return;
+                }
+                GeoDistance cost = TransitionCost({predecessor.previous, predecessor.waypoint, state.waypoint}, distance);
+                StateInfo &predecessor_info = Info(predecessor);
+                if (cost + g < predecessor_info.rhs) {
+                    predecessor_info.rhs = cost + g;
+                    Dequeue(predecessor, predecessor_info);
+                    if (predecessor_info.g != predecessor_info.rhs) {
+                        Enqueue(predecessor, predecessor_info);
+                    }
+                }
+            });
+        } else {
+            info.g = kInfinity;
+            ForEachPredecessor(state, [&](const State &predecessor, GeoDistance) {
+                if (state_map_.count(predecessor)) {
+                    UpdateState(predecessor);
+                }
+            });
+            UpdateState(state);
+        }
+    }
+}
+
+void FlightPlanner::Update(const BlockChange &change) {
+    if (change.all_tiles_changed) {
+        for (auto &pair : detour_edge_map_) {
+            changed_edges_.insert(pair.first);
+        }
+        tile_edge_map_.clear();
+    }
+    changed_edges_.insert(change.blocked_edges.begin(), change.blocked_edges.end());
+    changed_edges_.insert(change.cleared_edges.begin(), change.cleared_edges.end());
+    for (auto tile : change.changed_tiles) {
+        auto iterator = tile_edge_map_.find(tile);
+        if (iterator == tile_edge_map_.end()) {
+            continue;
+        }
+        changed_edges_.insert(iterator->second.begin(), iterator->second.end());
+        tile_edge_map_.erase(iterator);
+    }
+}
+
+void FlightPlanner::ApplyChangedEdges() {
+    // 先丢弃所有失效的绕行，再更新受影响的状态，每个绕行至多重新搜索一次
+    std::set<State> states;
+    for (auto &edge : changed_edges_) {
+        auto iterator = detour_edge_map_.find(edge);
+        if (iterator != detour_edge_map_.end()) {
+            for (auto &transition : iterator->second) {
+                detour_map_.erase(transition);
+            }
+            detour_edge_map_.erase(iterator);
+        }
+        // 两个方向上经过该航段的转移代价都变化，未访问的状态不受影响
+        for (auto &waypoint : {edge.first, edge.second}) {
+            const ConstWaypointPtr &next = waypoint == edge.first ? edge.second : edge.first;
+            ForEachPredecessor({waypoint, next}, [&](const State &predecessor, GeoDistance) {
+                if (!IsGoal(predecessor) && state_map_.count(predecessor)) {
+                    states.insert(predecessor);
+                }
+            });
+        }
+    }
+    changed_edges_.clear();
+    for (auto &state : states) {
+        UpdateState(state);
+    }
+}
+
+void FlightPlanner::MoveStart(WaypointIdentifier identifier, WaypointIdentifier previous_identifier) {
+    ConstWaypointPtr waypoint = graph_.WaypointFromIdentifier(identifier);
+    ConstWaypointPtr previous_waypoint = previous_identifier >= 0 ? graph_.WaypointFromIdentifier(previous_identifier) : nullptr;
+    if (waypoint == nullptr || (previous_identifier >= 0 && previous_waypoint == nullptr)) {
+        throw std::invalid_argument("waypoint not in the graph");
+    }
+    start_ = {previous_waypoint, waypoint};
+    // 起点移动后所有键值的启发项减少，由键值修正量补偿
+    key_modifier_ += Waypoint::Distance(*last_start_.waypoint, *start_.waypoint);
+    last_start_ = start_;
+}
+
+void FlightPlanner::ExtractPath() {
+    path_ = WaypointPath();
+    // 起点可能未出队，由rhs判断是否可达
+    auto start_iterator = state_map_.find(start_);
+    if (!IsGoal(start_) && (start_iterator == state_map_.end() || start_iterator->second.rhs == kInfinity)) {
+        return;
+    }
+    State state = start_;
+    path_.waypoints.push_back(state.waypoint);
+    path_.lengths.push_back(0);
+    // 代价为正，沿最小代价后继前进不会成环，步数上限只为防御
+    for (size_t step = 0; !IsGoal(state) && step <= state_map_.size(); step++) {
+        GeoDistance best_cost = kInfinity;
+        State best_state;
+        GeoDistance best_distance = 0;
+        for (auto &neibor : state.waypoint->neibors) {
+            State successor = {state.waypoint, neibor.target.lock()};
+            GeoDistance g = IsGoal(successor) ? 0 : GetG(successor);
+            if (g == kInfinity) {
+                continue;
+            }
+            GeoDistance cost = TransitionCost({state.previous, state.waypoint, successor.waypoint}, neibor.distance) + g;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_state = successor;
+                best_distance = neibor.distance;
+            }
+        }
+        if (best_cost == kInfinity) {
+            path_ = WaypointPath();
+            return;
+        }
+        Transition transition = {state.previous, state.waypoint, best_state.waypoint};
+        auto iterator = detour_map_.find(transition);
+        if (iterator != detour_map_.end()) {
+            for (auto &waypoint : iterator->second.inserted_waypoints) {
+                path_.lengths.push_back(path_.lengths.back() + Waypoint::Distance(*path_.waypoints.back(), *waypoint));
+                path_.waypoints.push_back(waypoint);
+            }
+            path_.lengths.push_back(path_.lengths.back() + Waypoint::Distance(*path_.waypoints.back(), *best_state.waypoint));
+        } else {
+            path_.lengths.push_back(path_.lengths.back() + best_distance);
+        }
+        path_.waypoints.push_back(best_state.waypoint);
+        state = best_state;
+    }
+    if (!IsGoal(state)) {
+        path_ = WaypointPath();
+        return;
+    }
+    path_.MaterializeNames();
+}
+
+WaypointPath FlightPlanner::Plan(SearchStats *stats) {
+    MetricsScope metrics_scope(flight_planner_plan_latency, stats);
+    stats_ = stats;
+    if (stats_) {
+        stats_->path_searches++;
+    }
+    ApplyChangedEdges();
+    if (!IsGoal(start_)) {
+        // 起点可能是新的状态
+        UpdateState(start_);
+        ComputeShortestPath();
+    }
+    ExtractPath();
+    stats_ = nullptr;
+    return path_;
+}
+
+}  // namespace dwr
@@ -0,0 +1,192 @@
+//
+//  flight_planner.h
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/23.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#ifndef flight_planner_h
+#define flight_planner_h
+
+#include <functional>
+#include <limits>
+#include <map>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "dynamic_radar_airway_graph.h"
+#include "waypoint_pool.h"
+
+namespace dwr {
+
+/**
+ Route of one tracked flight kept across radar frames with D* Lite. The search runs backward
+ from the destination, so its costs to go stay valid when the aircraft moves, and a frame only
+ repairs the part of the search depending on the edges whose blocking changed.
+
+ A search state is the edge arriving at a waypoint, so the turn of less than 90 degrees and
+ the detours depending on the previous waypoint are costs of the transitions between states.
+ The turn after a detour is checked against the blocked edge instead of the last detour leg,
+ and intensity penalties are not applied. A detour is searched again when its edge is blocked
+ or cleared, or when the weather changes in the tiles around it.
+
+ The planner refers to the graph, which must outlive it. Not thread safe, and not to be used
+ while the graph is being updated.
+ */
+class FlightPlanner {
+ public:
+    /**
+     @param graph Built graph.
+     @param origin_identifier Origin waypoint identifier.
+     @param destination_identifier Destination waypoint identifier.
+     @param detour_engine Search for the detours around the blocked edges.
+     @throw std::invalid_argument When either waypoint is not in the graph.
+     */
+    FlightPlanner(const DynamicRadarAirwayGraph &graph,
+                  WaypointIdentifier origin_identifier,
+                  WaypointIdentifier destination_identifier,
+                  DetourEngine detour_engine = DetourEngine::kLadder);
+
+    /**
+     Record the edges whose blocking changed and the tiles whose weather changed, as returned by
+     the updates of the graph. The route is repaired by the next Plan, so the changes of several
+     updates are applied once.
+     */
+    void Update(const BlockChange &change);
+
+    /**
+     Move the start when the aircraft passes a waypoint.
+
+     @param identifier Waypoint reached.
+     @param previous_identifier Waypoint the aircraft came from, or -1 when the arriving direction does not matter.
+     @throw std::invalid_argument When either waypoint is not in the graph.
+     */
+    void MoveStart(WaypointIdentifier identifier, WaypointIdentifier previous_identifier = -1);
+
+    /**
+     Repair the search and return the route from the start.
+
+     @param stats Counters of the repair are added to it, nullptr for none.
+     @return Path consists of waypoints, empty when the destination cannot be reached.
+     */
+    WaypointPath Plan(SearchStats *stats = nullptr);
+
+    /**
+     Route returned by the last Plan.
+     */
+    const WaypointPath &GetPath() const {return path_;}
+
+    /**
+     Number of states whose cost to go is kept.
+     */
+    size_t GetStateCount() const {return state_map_.size();}
+
+ private:
+    // Waypoint and the waypoint of the arriving edge, nullptr at the start.
+    struct State {
+        ConstWaypointPtr previous;
+        ConstWaypointPtr waypoint;
+
+        bool operator == (const State &other) const {
+            return previous == other.previous && waypoint == other.waypoint;
+        }
+
+        bool operator < (const State &other) const {
+            return std::tie(previous, waypoint) < std::tie(other.previous, other.waypoint);
+        }
+    };
+
+    struct StateHash {
+        size_t operator () (const State &state) const {
+            return std::hash<const Waypoint *>()(state.previous.get()) * 31 + std::hash<const Waypoint *>()(state.waypoint.get());
+        }
+    };
+
+    using Key = std::pair<GeoDistance, GeoDistance>;
+
+    struct StateInfo {
+        GeoDistance g = std::numeric_limits<GeoDistance>::infinity();
+        GeoDistance rhs = std::numeric_limits<GeoDistance>::infinity();
+        // Key in open_list_ when queued.
+        bool queued = false;
+        Key key;
+    };
+
+    // Transition from (previous, waypoint) to (waypoint, next).
+    struct Transition {
+        ConstWaypointPtr previous;
+        ConstWaypointPtr waypoint;
+        ConstWaypointPtr next;
+
+        bool operator == (const Transition &other) const {
+            return previous == other.previous && waypoint == other.waypoint && next == other.next;
+        }
+    };
+
+    struct TransitionHash {
+        size_t operator () (const Transition &transition) const {
+            return (std::hash<const Waypoint *>()(transition.previous.get()) * 31 +
+                    std::hash<const Waypoint *>()(transition.waypoint.get())) * 31 +
+            std::hash<const Waypoint *>()(transition.next.get());
+        }
+    };
+
+    // Cost of a blocked transition and its detour.
+    struct Detour {
+        GeoDistance cost;
+        std::vector<WaypointPtr> inserted_waypoints;
+    };
+
+    const DynamicRadarAirwayGraph &graph_;
+    DetourEngine detour_engine_;
+    ConstWaypointPtr destination_;
+    State start_;
+    // Start of the last repair, for the key modifier.
+    State last_start_;
+    GeoDistance key_modifier_ = 0;
+    std::unordered_map<State, StateInfo, StateHash> state_map_;
+    std::set<std::pair<Key, State>> open_list_;
+    std::unordered_map<Transition, Detour, TransitionHash> detour_map_;
+    // Blocked edges of the cached detours, for dropping them on a change.
+    std::map<UndirectedWaypointPair, std::vector<Transition>> detour_edge_map_;
+    // Edges whose detours were searched in each tile.
+    std::unordered_map<RouteCache::TileKey, std::set<UndirectedWaypointPair>> tile_edge_map_;
+    // Edges changed since the last Plan.
+    std::set<UndirectedWaypointPair> changed_edges_;
+    WaypointPool pool_;
+    WaypointPath path_;
+    SearchStats *stats_ = nullptr;
+
+    GeoDistance Heuristic(const State &state) const;
+
+    Key CalculateKey(const State &state, const StateInfo &info) const;
+
+    StateInfo &Info(const State &state);
+
+    bool IsGoal(const State &state) const {return state.waypoint == destination_;}
+
+    GeoDistance GetG(const State &state) const;
+
+    GeoDistance TransitionCost(const Transition &transition, GeoDistance distance);
+
+    void Enqueue(const State &state, StateInfo &info);
+
+    void Dequeue(const State &state, StateInfo &info);
+
+    void UpdateState(const State &state);
+
+    void ForEachPredecessor(const State &state, const std::function<void(const State &predecessor, GeoDistance distance)> &function) const;
+
+    void ApplyChangedEdges();
+
+    void ComputeShortestPath();
+
+    void ExtractPath();
+};
+
+}  // namespace dwr
+#endif /* flight_planner_h */
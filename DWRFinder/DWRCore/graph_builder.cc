@@ -0,0 +1,121 @@
+//
+//  graph_builder.cc
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/25.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include "graph_builder.h"
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <utility>
+
+#include "Utils/coordinate_convert.h"
+#include "metrics.h"
+
+namespace dwr {
+
+static const Histogram graph_build_latency =
+MetricsRegistry::Default().AddHistogram("dwr_graph_build_seconds", "Latency of GraphBuilder::Build.", 1e-6);
+
+void GraphBuilder::Reserve(size_t waypoint_count, size_t segment_count) {
+    waypoints_.reserve(waypoint_count);
+    segments_.reserve(segment_count);
+}
+
+void GraphBuilder::AddWaypoint(WaypointIdentifier identifier,
+                               const std::string &name,
+                               GeoRad longitude,
+                               GeoRad latitude) {
+    waypoints_.push_back(WaypointRecord{identifier, name, longitude, latitude});
+}
+
+void GraphBuilder::AddWaypoints(const std::vector<WaypointRecord> &waypoints) {
+    waypoints_.insert(waypoints_.end(), waypoints.begin(), waypoints.end());
+}
+
+void GraphBuilder::AddAirwaySegment(WaypointIdentifier identifier1, WaypointIdentifier identifier2) {
+    segments_.push_back(std::make_pair(identifier1, identifier2));
+}
+
+void GraphBuilder::AddAirwaySegments(const std::vector<SegmentRecord> &segments) {
+    segments_.insert(segments_.end(), segments.begin(), segments.end());
+}
+
+void GraphBuilder::Build(AirwayGraph &graph) const {
+    MetricsScope metrics_scope(graph_build_latency);
+    // 按ID稳定排序，同ID保留最后加入的
+    std::vector<size_t> order(waypoints_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](size_t index1, size_t index2) {
+        return waypoints_[index1].identifier < waypoints_[index2].identifier;
+    });
+    std::vector<WaypointPtr> waypoints;
+    waypoints.reserve(order.size());
+    IdentifierTable identifier_table;
+    for (size_t i = 0; i < order.size(); i++) {
+        const WaypointRecord &record = waypoints_[order[i]];
+        if (i + 1 < order.size() && waypoints_[order[i + 1]].identifier == record.identifier) {
+            continue;
+        }
+        auto waypoint = std::make_shared<Waypoint>(record.identifier, record.name, record.longitude, record.latitude);
+        waypoint->index = static_cast<int>(waypoints.size());
+        identifier_table.Insert(record.identifier, waypoint->index);
+        waypoints.push_back(std::move(waypoint));
+    }
+    // 批量投影坐标，使航段带有方向
+    std::vector<double> longitude(waypoints.size()), latitude(waypoints.size()), x(waypoints.size()), y(waypoints.size());
+    for (size_t i = 0; i < waypoints.size(); i++) {
+        longitude[i] = waypoints[i]->GetLocation().longitude;
+        latitude[i] = waypoints[i]->GetLocation().latitude;
+    }
+    LonLatToMercBatch(longitude.data(), latitude.data(), x.data(), y.data(), waypoints.size());
+    for (size_t i = 0; i < waypoints.size(); i++) {
+        waypoints[i]->coordinate = {x[i], y[i]};
+    }
+    // 航段转为升序索引对后排序去重
+    std::vector<std::pair<int32_t, int32_t>> index_pairs;
+    index_pairs.reserve(segments_.size());
+    for (auto &segment : segments_) {
+        int32_t index1 = identifier_table.Find(segment.first);
+        int32_t index2 = identifier_table.Find(segment.second);
+        if (index1 == IdentifierTable::kNoIndex || index2 == IdentifierTable::kNoIndex || index1 == index2) {
+            continue;
+        }
+        index_pairs.push_back(std::make_pair(std::min(index1, index2), std::max(index1, index2)));
+    }
+    std::sort(index_pairs.begin(), index_pairs.end());
+    index_pairs.erase(std::unique(index_pairs.begin(), index_pairs.end()), index_pairs.end());
+    // 先统计度数预留邻接表，再一次填充
+    std::vector<uint32_t> degrees(waypoints.size(), 0);
+    for (auto &index_pair : index_pairs) {
+        degrees[index_pair.first]++;
+        degrees[index_pair.second]++;
+    }
+    for (size_t i = 0; i < waypoints.size(); i++) {
+        waypoints[i]->neibors.reserve(degrees[i]);
+    }
+    for (auto &index_pair : index_pairs) {
+        const WaypointPtr &waypoint1 = waypoints[index_pair.first];
+        const WaypointPtr &waypoint2 = waypoints[index_pair.second];
+        GeoDistance distance = Waypoint::Distance(*waypoint1, *waypoint2);
+        GeoProj direction = Waypoint::Direction(*waypoint1, *waypoint2);
+        waypoint1->neibors.push_back(Neighbor(waypoint2, distance, direction));
+        waypoint2->neibors.push_back(Neighbor(waypoint1, distance, {-direction.x, -direction.y}));
+    }
+    for (auto &waypoint : graph.waypoints_) {
+        waypoint->index = -1;
+    }
+    graph.waypoints_ = std::move(waypoints);
+    graph.identifier_table_ = std::move(identifier_table);
+}
+
+void GraphBuilder::Clear() {
+    waypoints_.clear();
+    segments_.clear();
+}
+
+}  // namespace dwr
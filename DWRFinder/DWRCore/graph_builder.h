@@ -0,0 +1,65 @@
+//
+//  graph_builder.h
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/25.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#ifndef graph_builder_h
+#define graph_builder_h
+
+#include <string>
+#include <vector>
+
+#include "airway_graph.h"
+
+namespace dwr {
+
+/**
+ Collector of waypoints and segments built into a graph at once, e.g. when importing a new AIRAC
+ cycle. Waypoints are deduplicated by sorting the identifiers and segments by sorting the index
+ pairs, and each neighbour list is reserved and filled in one pass, instead of searching it for
+ every added segment as AirwayGraph::AddAirwaySegment does.
+ */
+class GraphBuilder {
+ public:
+    void Reserve(size_t waypoint_count, size_t segment_count);
+
+    /**
+     Add a waypoint. The last one added of an identifier is kept.
+     */
+    void AddWaypoint(WaypointIdentifier identifier, const std::string &name, GeoRad longitude, GeoRad latitude);
+
+    void AddWaypoints(const std::vector<WaypointRecord> &waypoints);
+
+    /**
+     Add an undirected segment. Repeated segments are kept once, and segments with an unknown
+     waypoint or to the waypoint itself are ignored.
+     */
+    void AddAirwaySegment(WaypointIdentifier identifier1, WaypointIdentifier identifier2);
+
+    void AddAirwaySegments(const std::vector<SegmentRecord> &segments);
+
+    /**
+     Replace the waypoints and segments of a graph with those added. The builder keeps them, so
+     it can build several graphs. State derived from the segments, e.g. that of
+     DynamicRadarAirwayGraph::Build, has to be built afterwards.
+
+     @param graph Graph to fill.
+     */
+    void Build(AirwayGraph &graph) const;
+
+    void Clear();
+
+    size_t GetWaypointCount() const {return waypoints_.size();}
+
+    size_t GetSegmentCount() const {return segments_.size();}
+
+ private:
+    std::vector<WaypointRecord> waypoints_;
+    std::vector<SegmentRecord> segments_;
+};
+
+}  // namespace dwr
+#endif /* graph_builder_h */
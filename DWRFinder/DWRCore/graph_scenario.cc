@@ -0,0 +1,173 @@
+//
+//  graph_scenario.cc
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/26.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include "graph_scenario.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+#include "Utils/coordinate_convert.h"
+#include "metrics.h"
+
+namespace dwr {
+
+static const Histogram scenario_find_path_latency =
+MetricsRegistry::Default().AddHistogram("dwr_scenario_find_path_seconds", "Latency of GraphScenario::FindPath.", 1e-6);
+
+WaypointPtr GraphScenario::FindWaypoint(WaypointIdentifier identifier) const {
+    auto iterator = added_waypoints_.find(identifier);
+    if (iterator != added_waypoints_.end()) {
+        return iterator->second;
+    }
+    WaypointPtr waypoint = base_->WaypointFromIdentifier(identifier);
+    if (waypoint == nullptr || overlay_.removed_waypoints.count(waypoint.get()) > 0) {
+        return nullptr;
+    }
+    return waypoint;
+}
+
+ConstWaypointPtr GraphScenario::WaypointFromIdentifier(WaypointIdentifier identifier) const {
+    return FindWaypoint(identifier);
+}
+
+void GraphScenario::AddWaypoint(WaypointIdentifier identifier,
+                                const std::string &name,
+                                GeoRad longitude,
+                                GeoRad latitude) {
+    if (FindWaypoint(identifier) != nullptr) {
+        throw std::invalid_argument("Waypoint " + std::to_string(identifier) + " is already in the scenario");
+    }
+    auto waypoint = std::make_shared<Waypoint>(identifier, name, longitude, latitude);
+    LonLatToMerc(longitude, latitude, &waypoint->coordinate.x, &waypoint->coordinate.y);
+    added_waypoints_[identifier] = std::move(waypoint);
+}
+
+void GraphScenario::RemoveWaypoint(WaypointIdentifier identifier) {
+    WaypointPtr waypoint = FindWaypoint(identifier);
+    if (waypoint == nullptr) {
+        return;
+    }
+    // 先删除情景中添加的航段
+    auto iterator = overlay_.added_neighbors.find(waypoint.get());
+    if (iterator != overlay_.added_neighbors.end()) {
+        std::vector<Neighbor> neighbors = std::move(iterator->second);
+        overlay_.added_neighbors.erase(iterator);
+        for (auto &neibor : neighbors) {
+            EraseAddedEdge(*neibor.target.lock(), *waypoint);
+        }
+    }
+    if (added_waypoints_.erase(identifier) == 0) {
+        overlay_.removed_waypoints.insert(waypoint.get());
+        for (auto &neibor : waypoint->neibors) {
+            overlay_.changed_waypoints.insert(neibor.target.lock().get());
+        }
+    }
+}
+
+bool GraphScenario::IsBaseEdge(const Waypoint &waypoint1, const Waypoint &waypoint2) const {
+    return std::any_of(waypoint1.neibors.begin(), waypoint1.neibors.end(), [&](const Neighbor &neibor) {
+        return neibor.target.lock().get() == &waypoint2;
+    });
+}
+
+// 从情景添加的邻接中删除一个方向，返回是否存在
+static bool EraseAddedNeighbor(GraphOverlay &overlay, const Waypoint &waypoint, const Waypoint &neighbor) {
+    auto iterator = overlay.added_neighbors.find(&waypoint);
+    if (iterator == overlay.added_neighbors.end()) {
+        return false;
+    }
+    auto &neighbors = iterator->second;
+    auto neighbor_iterator = std::find_if(neighbors.begin(), neighbors.end(), [&](const Neighbor &neibor) {
+        return neibor.target.lock().get() == &neighbor;
+    });
+    if (neighbor_iterator == neighbors.end()) {
+        return false;
+    }
+    neighbors.erase(neighbor_iterator);
+    if (neighbors.empty()) {
+        overlay.added_neighbors.erase(iterator);
+    }
+    return true;
+}
+
+bool GraphScenario::EraseAddedEdge(const Waypoint &waypoint1, const Waypoint &waypoint2) {
+    bool erased = EraseAddedNeighbor(overlay_, waypoint1, waypoint2);
+    return EraseAddedNeighbor(overlay_, waypoint2, waypoint1) || erased;
+}
+
+void GraphScenario::AddAirwaySegment(WaypointIdentifier identifier1, WaypointIdentifier identifier2) {
+    WaypointPtr waypoint1 = FindWaypoint(identifier1);
+    WaypointPtr waypoint2 = FindWaypoint(identifier2);
+    if (waypoint1 == nullptr || waypoint2 == nullptr || waypoint1 == waypoint2) {
+        return;
+    }
+    // 基础图中的航段只需取消删除
+    if (IsBaseEdge(*waypoint1, *waypoint2)) {
+        overlay_.removed_edges.erase(GraphOverlay::MakeEdge(*waypoint1, *waypoint2));
+        return;
+    }
+    auto &neighbors1 = overlay_.added_neighbors[waypoint1.get()];
+    bool connected = std::any_of(neighbors1.begin(), neighbors1.end(), [&](const Neighbor &neibor) {
+        return neibor.target.lock() == waypoint2;
+    });
+    if (connected) {
+        return;
+    }
+    GeoDistance distance = Waypoint::Distance(*waypoint1, *waypoint2);
+    GeoProj direction = Waypoint::Direction(*waypoint1, *waypoint2);
+    overlay_.changed_waypoints.insert(waypoint1.get());
+    overlay_.changed_waypoints.insert(waypoint2.get());
+    neighbors1.push_back(Neighbor(waypoint2, distance, direction));
+    overlay_.added_neighbors[waypoint2.get()].push_back(Neighbor(waypoint1, distance, {-direction.x, -direction.y}));
+}
+
+void GraphScenario::RemoveAirwaySegment(WaypointIdentifier identifier1, WaypointIdentifier identifier2) {
+    WaypointPtr waypoint1 = FindWaypoint(identifier1);
+    WaypointPtr waypoint2 = FindWaypoint(identifier2);
+    if (waypoint1 == nullptr || waypoint2 == nullptr) {
+        return;
+    }
+    if (EraseAddedEdge(*waypoint1, *waypoint2)) {
+        return;
+    }
+    if (IsBaseEdge(*waypoint1, *waypoint2)) {
+        overlay_.removed_edges.insert(GraphOverlay::MakeEdge(*waypoint1, *waypoint2));
+        overlay_.changed_waypoints.insert(waypoint1.get());
+        overlay_.changed_waypoints.insert(waypoint2.get());
+    }
+}
+
+WaypointPath
+GraphScenario::FindPath(WaypointIdentifier origin_identifier,
+                        WaypointIdentifier destination_identifier,
+                        const std::function<bool(const WaypointPair &,
+                                                 const WaypointInfoPair &,
+                                                 std::vector<WaypointPtr> &)> &can_search,
+                        const std::function<GeoDistance(const WaypointPair &,
+                                                        const std::vector<WaypointPtr> &)> &penalty,
+                        SearchStats *stats) const {
+    MetricsScope metrics_scope(scenario_find_path_latency, stats);
+    auto origin_waypoint = FindWaypoint(origin_identifier);
+    auto destination_waypoint = FindWaypoint(destination_identifier);
+    if (origin_waypoint == nullptr || destination_waypoint == nullptr) {
+        return WaypointPath();
+    }
+    return AirwayGraph::FindPathInGraph(origin_waypoint, destination_waypoint, can_search, penalty, stats, &overlay_);
+}
+
+size_t GraphScenario::GetChangeCount() const {
+    size_t added_neighbor_count = 0;
+    for (auto &entry : overlay_.added_neighbors) {
+        added_neighbor_count += entry.second.size();
+    }
+    return added_waypoints_.size() + overlay_.removed_waypoints.size() +
+    overlay_.removed_edges.size() + added_neighbor_count / 2;
+}
+
+}  // namespace dwr
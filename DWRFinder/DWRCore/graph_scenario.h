@@ -0,0 +1,150 @@
+//
+//  graph_scenario.h
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/26.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#ifndef graph_scenario_h
+#define graph_scenario_h
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "airway_graph.h"
+
+namespace dwr {
+
+/**
+ Edges and waypoints added to and removed from a graph without changing it. Read by
+ AirwayGraph::FindPathInGraph on top of the neighbour lists of the waypoints.
+ */
+struct GraphOverlay {
+    using Edge = std::pair<const Waypoint *, const Waypoint *>;
+
+    struct EdgeHash {
+        size_t operator () (const Edge &edge) const {
+            return std::hash<const Waypoint *>()(edge.first) * 31 + std::hash<const Waypoint *>()(edge.second);
+        }
+    };
+
+    static Edge MakeEdge(const Waypoint &waypoint1, const Waypoint &waypoint2) {
+        return &waypoint1 < &waypoint2 ? Edge(&waypoint1, &waypoint2) : Edge(&waypoint2, &waypoint1);
+    }
+
+    // Edges of the neighbour lists not to be searched.
+    std::unordered_set<Edge, EdgeHash> removed_edges;
+    // Waypoints not to be entered.
+    std::unordered_set<const Waypoint *> removed_waypoints;
+    // Neighbours searched after those of the neighbour list, both directions of every added edge.
+    std::unordered_map<const Waypoint *, std::vector<Neighbor>> added_neighbors;
+    // Waypoints whose neighbours may have changed, so the others are searched without lookups.
+    std::unordered_set<const Waypoint *> changed_waypoints;
+
+    bool IsChanged(const Waypoint &waypoint) const {
+        return !changed_waypoints.empty() && changed_waypoints.count(&waypoint) > 0;
+    }
+
+    /**
+     Whether the edge from a waypoint to a neighbour in its neighbour list is removed.
+     */
+    bool IsRemoved(const Waypoint &waypoint, const Waypoint &neighbor) const {
+        return (!removed_waypoints.empty() && removed_waypoints.count(&neighbor) > 0) ||
+        (!removed_edges.empty() && removed_edges.count(MakeEdge(waypoint, neighbor)) > 0);
+    }
+
+    /**
+     @return Added neighbours of a waypoint, nullptr when there are none.
+     */
+    const std::vector<Neighbor> *FindAddedNeighbors(const Waypoint &waypoint) const {
+        if (added_neighbors.empty()) {
+            return nullptr;
+        }
+        auto iterator = added_neighbors.find(&waypoint);
+        return iterator != added_neighbors.end() ? &iterator->second : nullptr;
+    }
+};
+
+/**
+ What-if view of a graph, e.g. with restricted areas closed or temporary routes added. The
+ scenario keeps only its changes in an overlay and shares the waypoints and neighbour lists of
+ the base graph, so making one costs nothing and each change costs about the degree of the
+ waypoints it touches. Copying a scenario copies its changes only, to branch a what-if from
+ another.
+
+ The base graph must outlive the scenario, and its waypoints and segments must not change while
+ the scenario is used. A scenario may be searched from several threads when it is not changed.
+ */
+class GraphScenario {
+ public:
+    explicit GraphScenario(const AirwayGraph &base) : base_(&base) {}
+
+    /**
+     Add a waypoint to the scenario.
+
+     @throw std::invalid_argument When the identifier is already in the scenario.
+     */
+    void AddWaypoint(WaypointIdentifier identifier, const std::string &name, GeoRad longitude, GeoRad latitude);
+
+    /**
+     Remove a waypoint and all of its connections from the scenario.
+     */
+    void RemoveWaypoint(WaypointIdentifier identifier);
+
+    /**
+     Add the connection between two waypoints, ignored when either is unknown or they are connected.
+     */
+    void AddAirwaySegment(WaypointIdentifier identifier1, WaypointIdentifier identifier2);
+
+    /**
+     Remove the connection between two waypoints.
+     */
+    void RemoveAirwaySegment(WaypointIdentifier identifier1, WaypointIdentifier identifier2);
+
+    /**
+     @return Waypoint in the scenario, nullptr when not found or removed.
+     */
+    ConstWaypointPtr WaypointFromIdentifier(WaypointIdentifier identifier) const;
+
+    /**
+     Get the path in the scenario using A* algorithm, see AirwayGraph::FindPath.
+     */
+    WaypointPath
+    FindPath(WaypointIdentifier origin_identifier,
+             WaypointIdentifier destination_identifier,
+             const std::function<bool(const WaypointPair &, const WaypointInfoPair &, std::vector<WaypointPtr> &)> &can_search
+             = [](const WaypointPair &, const WaypointInfoPair &,
+                  std::vector<WaypointPtr> &inserted_waypoints) {return true;},
+             const std::function<GeoDistance(const WaypointPair &, const std::vector<WaypointPtr> &)> &penalty
+             = nullptr,
+             SearchStats *stats = nullptr) const;
+
+    const AirwayGraph &GetBase() const {return *base_;}
+
+    const GraphOverlay &GetOverlay() const {return overlay_;}
+
+    /**
+     Number of waypoints and edges changed.
+     */
+    size_t GetChangeCount() const;
+
+ private:
+    const AirwayGraph *base_;
+    GraphOverlay overlay_;
+    // Waypoints of the scenario only, shared by its copies. Their connections are in the overlay.
+    std::unordered_map<WaypointIdentifier, WaypointPtr> added_waypoints_;
+
+    WaypointPtr FindWaypoint(WaypointIdentifier identifier) const;
+
+    bool IsBaseEdge(const Waypoint &waypoint1, const Waypoint &waypoint2) const;
+
+    bool EraseAddedEdge(const Waypoint &waypoint1, const Waypoint &waypoint2);
+};
+
+}  // namespace dwr
+#endif /* graph_scenario_h */
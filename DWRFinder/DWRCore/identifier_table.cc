@@ -0,0 +1,172 @@
+//
+//  identifier_table.cc
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/25.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include "identifier_table.h"
+
+#include <algorithm>
+
+namespace dwr {
+
+const int32_t IdentifierTable::kNoIndex;
+
+// 直接数组的范围不超过标识数的两倍加上该余量
+static const int64_t kDirectSlack = 1024;
+
+void IdentifierTable::Insert(WaypointIdentifier identifier, int32_t index) {
+    if (direct_) {
+        int64_t end = base_ + static_cast<int64_t>(direct_indices_.size());
+        if (direct_indices_.empty()) {
+            base_ = identifier;
+            end = base_;
+        }
+        int64_t new_base = std::min<int64_t>(base_, identifier);
+        int64_t new_end = std::max<int64_t>(end, static_cast<int64_t>(identifier) + 1);
+        if (new_end - new_base <= 2 * static_cast<int64_t>(size_ + 1) + kDirectSlack) {
+            if (new_base < base_) {
+                direct_indices_.insert(direct_indices_.begin(), static_cast<size_t>(base_ - new_base), kNoIndex);
+                base_ = new_base;
+            }
+            if (new_end > end) {
+                direct_indices_.resize(static_cast<size_t>(new_end - base_), kNoIndex);
+            }
+            int32_t &slot = direct_indices_[static_cast<size_t>(identifier - base_)];
+            if (slot == kNoIndex) {
+                size_++;
+            }
+            slot = index;
+            return;
+        }
+        ConvertToHash();
+    }
+    min_identifier_ = std::min<int64_t>(min_identifier_, identifier);
+    max_identifier_ = std::max<int64_t>(max_identifier_, identifier);
+    // 负载不超过一半
+    if ((size_ + 1) * 2 > slot_identifiers_.size()) {
+        if (max_identifier_ - min_identifier_ + 1 <= 2 * static_cast<int64_t>(size_ + 1) + kDirectSlack) {
+            ConvertToDirect();
+            Insert(identifier, index);
+            return;
+        }
+        Rehash(std::max<size_t>(16, slot_identifiers_.size() * 2));
+    }
+    InsertSlot(identifier, index);
+}
+
+void IdentifierTable::InsertSlot(WaypointIdentifier identifier, int32_t index) {
+    for (size_t slot = Slot(identifier); ; slot = (slot + 1) & mask_) {
+        if (slot_indices_[slot] == kNoIndex) {
+            slot_identifiers_[slot] = identifier;
+            slot_indices_[slot] = index;
+            size_++;
+            return;
+        }
+        if (slot_identifiers_[slot] == identifier) {
+            slot_indices_[slot] = index;
+            return;
+        }
+    }
+}
+
+void IdentifierTable::Rehash(size_t capacity) {
+    std::vector<WaypointIdentifier> identifiers;
+    std::vector<int32_t> indices;
+    identifiers.swap(slot_identifiers_);
+    indices.swap(slot_indices_);
+    slot_identifiers_.assign(capacity, 0);
+    slot_indices_.assign(capacity, kNoIndex);
+    mask_ = capacity - 1;
+    size_ = 0;
+    for (size_t i = 0; i < identifiers.size(); i++) {
+        if (indices[i] != kNoIndex) {
+            InsertSlot(identifiers[i], indices[i]);
+        }
+    }
+}
+
+void IdentifierTable::ConvertToHash() {
+    std::vector<int32_t> direct_indices;
+    direct_indices.swap(direct_indices_);
+    direct_ = false;
+    size_t capacity = 16;
+    while (capacity < (size_ + 1) * 2) {
+        capacity *= 2;
+    }
+    slot_identifiers_.assign(capacity, 0);
+    slot_indices_.assign(capacity, kNoIndex);
+    mask_ = capacity - 1;
+    size_ = 0;
+    min_identifier_ = base_;
+    max_identifier_ = base_ + static_cast<int64_t>(direct_indices.size()) - 1;
+    for (size_t offset = 0; offset < direct_indices.size(); offset++) {
+        if (direct_indices[offset] != kNoIndex) {
+            InsertSlot(static_cast<WaypointIdentifier>(base_ + static_cast<int64_t>(offset)), direct_indices[offset]);
+        }
+    }
+}
+
+void IdentifierTable::ConvertToDirect() {
+    direct_ = true;
+    base_ = min_identifier_;
+    direct_indices_.assign(static_cast<size_t>(max_identifier_ - min_identifier_ + 1), kNoIndex);
+    for (size_t slot = 0; slot < slot_identifiers_.size(); slot++) {
+        if (slot_indices_[slot] != kNoIndex) {
+            direct_indices_[static_cast<size_t>(slot_identifiers_[slot] - base_)] = slot_indices_[slot];
+        }
+    }
+    slot_identifiers_.clear();
+    slot_indices_.clear();
+    mask_ = 0;
+}
+
+void IdentifierTable::Erase(WaypointIdentifier identifier) {
+    if (direct_) {
+        int64_t offset = static_cast<int64_t>(identifier) - base_;
+        if (offset >= 0 && offset < static_cast<int64_t>(direct_indices_.size()) &&
+            direct_indices_[static_cast<size_t>(offset)] != kNoIndex) {
+            direct_indices_[static_cast<size_t>(offset)] = kNoIndex;
+            size_--;
+        }
+        return;
+    }
+    if (slot_identifiers_.empty()) {
+        return;
+    }
+    size_t slot = Slot(identifier);
+    while (slot_indices_[slot] != kNoIndex && slot_identifiers_[slot] != identifier) {
+        slot = (slot + 1) & mask_;
+    }
+    if (slot_indices_[slot] == kNoIndex) {
+        return;
+    }
+    slot_indices_[slot] = kNoIndex;
+    size_--;
+    // 后移删除：把探测链上后续的项前移，保持链不断开
+    for (size_t next = (slot + 1) & mask_; slot_indices_[next] != kNoIndex; next = (next + 1) & mask_) {
+        size_t home = Slot(slot_identifiers_[next]);
+        // home不在(slot, next]之间时可以移到slot
+        bool movable = slot <= next ? (home <= slot || home > next) : (home <= slot && home > next);
+        if (movable) {
+            slot_identifiers_[slot] = slot_identifiers_[next];
+            slot_indices_[slot] = slot_indices_[next];
+            slot_indices_[next] = kNoIndex;
+            slot = next;
+        }
+    }
+}
+
+void IdentifierTable::Clear() {
+    direct_ = true;
+    size_ = 0;
+    base_ = 0;
+    direct_indices_.clear();
+    slot_identifiers_.clear();
+    slot_indices_.clear();
+    mask_ = 0;
+}
+
+}  // namespace dwr
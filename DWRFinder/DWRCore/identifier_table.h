@@ -0,0 +1,94 @@
+//
+//  identifier_table.h
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/25.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#ifndef identifier_table_h
+#define identifier_table_h
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "airway_type.h"
+
+namespace dwr {
+
+/**
+ Table from waypoint identifiers to dense indices. Identifiers spanning a range at most about
+ twice their number are looked up in a direct array, others in a flat open addressing hash
+ table with linear probing, so each lookup is one or a few array reads. The hash table turns
+ back into a direct array when it grows and the identifiers have become dense.
+ */
+class IdentifierTable {
+ public:
+    static const int32_t kNoIndex = -1;
+
+    /**
+     @return Index of the identifier, or kNoIndex.
+     */
+    int32_t Find(WaypointIdentifier identifier) const {
+        if (direct_) {
+            int64_t offset = static_cast<int64_t>(identifier) - base_;
+            return offset >= 0 && offset < static_cast<int64_t>(direct_indices_.size()) ?
+            direct_indices_[static_cast<size_t>(offset)] : kNoIndex;
+        }
+        if (slot_identifiers_.empty()) {
+            return kNoIndex;
+        }
+        for (size_t slot = Slot(identifier); ; slot = (slot + 1) & mask_) {
+            if (slot_indices_[slot] == kNoIndex) {
+                return kNoIndex;
+            }
+            if (slot_identifiers_[slot] == identifier) {
+                return slot_indices_[slot];
+            }
+        }
+    }
+
+    /**
+     Add or replace the index of an identifier.
+     */
+    void Insert(WaypointIdentifier identifier, int32_t index);
+
+    void Erase(WaypointIdentifier identifier);
+
+    void Clear();
+
+    size_t GetSize() const {return size_;}
+
+    bool IsDirect() const {return direct_;}
+
+ private:
+    bool direct_ = true;
+    size_t size_ = 0;
+    // Direct array of the indices of base_, base_ + 1, ...
+    int64_t base_ = 0;
+    std::vector<int32_t> direct_indices_;
+    // Hash slots, empty when the index is kNoIndex. The capacity is a power of two.
+    std::vector<WaypointIdentifier> slot_identifiers_;
+    std::vector<int32_t> slot_indices_;
+    size_t mask_ = 0;
+    // Range of the identifiers inserted into the hash table, not shrunk by Erase.
+    int64_t min_identifier_ = 0;
+    int64_t max_identifier_ = 0;
+
+    size_t Slot(WaypointIdentifier identifier) const {
+        // Fibonacci hashing
+        return static_cast<size_t>((static_cast<uint64_t>(static_cast<uint32_t>(identifier)) * 11400714819323198485ull) >> 32) & mask_;
+    }
+
+    void InsertSlot(WaypointIdentifier identifier, int32_t index);
+
+    void Rehash(size_t capacity);
+
+    void ConvertToHash();
+
+    void ConvertToDirect();
+};
+
+}  // namespace dwr
+#endif /* identifier_table_h */
@@ -0,0 +1,331 @@
+//
+//  metrics.cc
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/13.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace dwr {
+
+const int MetricsRegistry::kMaxCounters;
+const int MetricsRegistry::kMaxHistograms;
+const int MetricsRegistry::kBucketCount;
+
+void Counter::Increment(uint64_t value) const {
+    if (!registry_->IsEnabled()) {
+        return;
+    }
+    MetricsRegistry::Add(registry_->LocalShard().counters[index_], value);
+}
+
+void Histogram::Record(uint64_t value) const {
+    if (!registry_->IsEnabled()) {
+        return;
+    }
+    MetricsRegistry::Shard &shard = registry_->LocalShard();
+    MetricsRegistry::Add(shard.buckets[index_][MetricsRegistry::BucketIndex(value)], 1);
+    MetricsRegistry::Add(shard.sums[index_], value);
+}
+
+MetricsRegistry::Shard::Shard() {
+    for (auto &cell : counters) {
+        cell.store(0, std::memory_order_relaxed);
+    }
+    for (auto &cell : sums) {
+        cell.store(0, std::memory_order_relaxed);
+    }
+    for (auto &histogram : buckets) {
+        for (auto &cell : histogram) {
+            cell.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ Shards a thread took from the registries, given back when the thread exits.
+ */
+class MetricsRegistry::ShardHandle {
+ public:
+    ~ShardHandle() {
+        for (auto &pair : shards) {
+            pair.first->ReleaseShard(pair.second);
+        }
+    }
+
+    std::vector<std::pair<MetricsRegistry *, Shard *>> shards;
+};
+
+MetricsRegistry::MetricsRegistry() : enabled_(false) {
+    const char *names[][2] = {
+        {"dwr_search_nodes_settled", "Distinct waypoints popped from the open list."},
+        {"dwr_search_heap_pushes", "Waypoints pushed to the open list."},
+        {"dwr_search_stale_pops", "Pops of waypoints which had already been settled."},
+        {"dwr_search_can_search_calls", "Edges tested by can_search."},
+        {"dwr_search_blocked_edges", "Edges found in the block set."},
+        {"dwr_search_detours", "Detour searches on the raster."},
+        {"dwr_search_failed_detours", "Detour searches on the raster which found no path."},
+        {"dwr_search_inserted_waypoints", "Waypoints inserted by detours."},
+        {"dwr_search_paths", "Single path searches."},
+        {"dwr_search_spurs", "Spur searches of k-path queries."},
+        {"dwr_search_dominated_edges", "Edges skipped by the edge search as dominated."},
+        {"dwr_search_dominated_labels", "Labels dropped by the Pareto search as dominated."},
+        {"dwr_search_workspace_bytes", "Estimated bytes of the search containers and waypoint pools."},
+    };
+    for (auto &name : names) {
+        search_counters_.push_back(AddCounter(name[0], name[1]));
+    }
+}
+
+MetricsRegistry::~MetricsRegistry() = default;
+
+MetricsRegistry &MetricsRegistry::Default() {
+    // 不析构，避免退出较晚的线程访问已销毁的对象
+    static MetricsRegistry *registry = new MetricsRegistry();
+    return *registry;
+}
+
+Counter MetricsRegistry::AddCounter(const std::string &name, const std::string &help) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < counter_definitions_.size(); i++) {
+        if (counter_definitions_[i].name == name) {
+            return Counter(this, static_cast<int>(i));
+        }
+    }
+    if (counter_definitions_.size() == kMaxCounters) {
+        throw std::length_error("too many counters");
+    }
+    counter_definitions_.push_back({name, help, 1.0});
+    return Counter(this, static_cast<int>(counter_definitions_.size()) - 1);
+}
+
+Histogram MetricsRegistry::AddHistogram(const std::string &name, const std::string &help, double scale) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < histogram_definitions_.size(); i++) {
+        if (histogram_definitions_[i].name == name) {
+            return Histogram(this, static_cast<int>(i));
+        }
+    }
+    if (histogram_definitions_.size() == kMaxHistograms) {
+        throw std::length_error("too many histograms");
+    }
+    histogram_definitions_.push_back({name, help, scale});
+    return Histogram(this, static_cast<int>(histogram_definitions_.size()) - 1);
+}
+
+void MetricsRegistry::RecordSearchStats(const SearchStats &stats) {
+    const uint64_t values[] = {
+        stats.nodes_settled,
+        stats.heap_pushes,
+        stats.stale_pops,
+        stats.can_search_calls,
+        stats.blocked_edges,
+        stats.angle_search_calls,
+        stats.failed_detours,
+        stats.inserted_waypoints,
+        stats.path_searches,
+        stats.spur_searches,
+        stats.dominated_edges,
+        stats.dominated_labels,
+        stats.workspace_bytes,
+    };
+    for (size_t i = 0; i < search_counters_.size(); i++) {
+        if (values[i] > 0) {
+            search_counters_[i].Increment(values[i]);
+        }
+    }
+}
+
+int MetricsRegistry::BucketIndex(uint64_t value) {
+    if (value < 4) {
+        return static_cast<int>(value);
+    }
+    int exponent = 63;
+    while ((value >> exponent) == 0) {
+        exponent--;
+    }
+    int index = 4 + (exponent - 2) * 4 + static_cast<int>((value >> (exponent - 2)) & 3);
+    return std::min(index, kBucketCount - 1);
+}
+
+uint64_t MetricsRegistry::BucketUpperBound(int index) {
+    if (index < 4) {
+        return static_cast<uint64_t>(index);
+    }
+    int exponent = (index - 4) / 4 + 2;
+    uint64_t sub_bucket = (index - 4) % 4;
+    return ((5 + sub_bucket) << (exponent - 2)) - 1;
+}
+
+MetricsRegistry::Shard &MetricsRegistry::LocalShard() {
+    static thread_local ShardHandle handle;
+    for (auto &pair : handle.shards) {
+        if (pair.first == this) {
+            return *pair.second;
+        }
+    }
+    Shard *shard = AcquireShard();
+    handle.shards.push_back(std::make_pair(this, shard));
+    return *shard;
+}
+
+MetricsRegistry::Shard *MetricsRegistry::AcquireShard() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_shards_.empty()) {
+        Shard *shard = free_shards_.back();
+        free_shards_.pop_back();
+        return shard;
+    }
+    shards_.emplace_back(new Shard());
+    return shards_.back().get();
+}
+
+void MetricsRegistry::ReleaseShard(Shard *shard) {
+    // 分片保留已累计的值，供新线程继续使用
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_shards_.push_back(shard);
+}
+
+std::string MetricsRegistry::PrometheusText() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ostringstream os;
+    os.precision(12);
+    for (size_t i = 0; i < counter_definitions_.size(); i++) {
+        const Definition &definition = counter_definitions_[i];
+        uint64_t total = 0;
+        for (auto &shard : shards_) {
+            total += shard->counters[i].load(std::memory_order_relaxed);
+        }
+        os << "# HELP " << definition.name << "_total " << definition.help << "\n";
+        os << "# TYPE " << definition.name << "_total counter\n";
+        os << definition.name << "_total " << total << "\n";
+    }
+    for (size_t i = 0; i < histogram_definitions_.size(); i++) {
+        const Definition &definition = histogram_definitions_[i];
+        uint64_t sum = 0;
+        std::vector<uint64_t> buckets(kBucketCount, 0);
+        for (auto &shard : shards_) {
+            sum += shard->sums[i].load(std::memory_order_relaxed);
+            for (int j = 0; j < kBucketCount; j++) {
+                buckets[j] += shard->buckets[i][j].load(std::memory_order_relaxed);
+            }
+        }
+        os << "# HELP " << definition.name << " " << definition.help << "\n";
+        os << "# TYPE " << definition.name << " histogram\n";
+        uint64_t count = 0;
+        for (int j = 0; j < kBucketCount - 1; j++) {
+            count += buckets[j];
+            os << definition.name << "_bucket{le=\"" << BucketUpperBound(j) * definition.scale << "\"} " << count << "\n";
+        }
+        count += buckets[kBucketCount - 1];
+        os << definition.name << "_bucket{le=\"+Inf\"} " << count << "\n";
+        os << definition.name << "_sum " << sum * definition.scale << "\n";
+        os << definition.name << "_count " << count << "\n";
+    }
+    return os.str();
+}
+
+bool MetricsRegistry::ExportPrometheus(const std::string &path) const {
+    std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream of(temporary_path);
+        if (!of.is_open()) {
+            return false;
+        }
+        of << PrometheusText();
+        if (!of.good()) {
+            return false;
+        }
+    }
+    return std::rename(temporary_path.c_str(), path.c_str()) == 0;
+}
+
+static thread_local int metrics_scope_depth = 0;
+
+bool MetricsScope::Enter(const Histogram &latency) {
+    if (metrics_scope_depth++ > 0 || !MetricsRegistry::Default().IsEnabled()) {
+        return false;
+    }
+    latency_ = &latency;
+    start_time_ = std::chrono::steady_clock::now();
+    return true;
+}
+
+MetricsScope::MetricsScope(const Histogram &latency) {
+    Enter(latency);
+}
+
+MetricsScope::MetricsScope(const Histogram &latency, SearchStats *&stats) {
+    if (!Enter(latency)) {
+        return;
+    }
+    if (stats == nullptr) {
+        stats = &local_stats_;
+    }
+    // 调用方传入的统计可能已有累计值，只记录本次增量
+    stats_ = stats;
+    initial_stats_ = *stats;
+}
+
+MetricsScope::~MetricsScope() {
+    metrics_scope_depth--;
+    if (latency_ == nullptr) {
+        return;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time_);
+    latency_->Record(static_cast<uint64_t>(elapsed.count()));
+    if (stats_ != nullptr) {
+        SearchStats delta;
+        delta.nodes_settled = stats_->nodes_settled - initial_stats_.nodes_settled;
+        delta.heap_pushes = stats_->heap_pushes - initial_stats_.heap_pushes;
+        delta.stale_pops = stats_->stale_pops - initial_stats_.stale_pops;
+        delta.can_search_calls = stats_->can_search_calls - initial_stats_.can_search_calls;
+        delta.blocked_edges = stats_->blocked_edges - initial_stats_.blocked_edges;
+        delta.angle_search_calls = stats_->angle_search_calls - initial_stats_.angle_search_calls;
+        delta.failed_detours = stats_->failed_detours - initial_stats_.failed_detours;
+        delta.inserted_waypoints = stats_->inserted_waypoints - initial_stats_.inserted_waypoints;
+        delta.path_searches = stats_->path_searches - initial_stats_.path_searches;
+        delta.spur_searches = stats_->spur_searches - initial_stats_.spur_searches;
+        delta.dominated_edges = stats_->dominated_edges - initial_stats_.dominated_edges;
+        delta.dominated_labels = stats_->dominated_labels - initial_stats_.dominated_labels;
+        delta.workspace_bytes = stats_->workspace_bytes - initial_stats_.workspace_bytes;
+        MetricsRegistry::Default().RecordSearchStats(delta);
+    }
+}
+
+MetricsExporter::MetricsExporter(const std::string &path,
+                                 std::chrono::milliseconds interval,
+                                 const MetricsRegistry &registry) :
+path_(path), interval_(interval), registry_(registry) {
+    thread_ = std::thread(&MetricsExporter::Run, this);
+}
+
+MetricsExporter::~MetricsExporter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    condition_.notify_all();
+    thread_.join();
+    registry_.ExportPrometheus(path_);
+}
+
+void MetricsExporter::Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!condition_.wait_for(lock, interval_, [this] {return stopped_;})) {
+        lock.unlock();
+        registry_.ExportPrometheus(path_);
+        lock.lock();
+    }
+}
+
+}  // namespace dwr
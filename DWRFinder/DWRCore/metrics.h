@@ -0,0 +1,229 @@
+//
+//  metrics.h
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/13.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#ifndef metrics_h
+#define metrics_h
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "search_stats.h"
+
+namespace dwr {
+
+class MetricsRegistry;
+
+/**
+ Monotonic counter handle.
+ */
+class Counter {
+ public:
+    void Increment(uint64_t value = 1) const;
+
+ private:
+    friend class MetricsRegistry;
+    Counter(MetricsRegistry *registry, int index) : registry_(registry), index_(index) {}
+
+    MetricsRegistry *registry_;
+    int index_;
+};
+
+/**
+ Histogram handle. Buckets are log-linear: values below 4 get their own bucket, and every
+ power of two above is split into four, so a bucket is at most 25% wide.
+ */
+class Histogram {
+ public:
+    void Record(uint64_t value) const;
+
+ private:
+    friend class MetricsRegistry;
+    Histogram(MetricsRegistry *registry, int index) : registry_(registry), index_(index) {}
+
+    MetricsRegistry *registry_;
+    int index_;
+};
+
+/**
+ Process-wide counters and histograms.
+
+ Every thread writes its own shard with relaxed atomics, so recording takes no lock and
+ shares no cache line with other threads. Exporting sums the shards. Shards of exited
+ threads are kept and reused by new threads. Registries other than Default() must outlive
+ the threads recording to them.
+ */
+class MetricsRegistry {
+ public:
+    static const int kMaxCounters = 64;
+    static const int kMaxHistograms = 32;
+    static const int kBucketCount = 4 + 4 * 36;
+
+    MetricsRegistry();
+    ~MetricsRegistry();
+
+    /**
+     The registry used by the graphs.
+     */
+    static MetricsRegistry &Default();
+
+    /**
+     Recording is off until enabled, and costs a flag check in the meantime.
+     */
+    void SetEnabled(bool enabled) {enabled_.store(enabled, std::memory_order_relaxed);}
+
+    bool IsEnabled() const {return enabled_.load(std::memory_order_relaxed);}
+
+    /**
+     Register a counter, or get the existing one of the same name.
+
+     @param name Metric name, "_total" is appended on export.
+     @param help Help text.
+     @return Counter handle.
+     */
+    Counter AddCounter(const std::string &name, const std::string &help);
+
+    /**
+     Register a histogram, or get the existing one of the same name.
+
+     @param name Metric name.
+     @param help Help text.
+     @param scale Factor from the recorded integer to the exported unit, e.g. 1e-6 for microseconds exported as seconds.
+     @return Histogram handle.
+     */
+    Histogram AddHistogram(const std::string &name, const std::string &help, double scale = 1.0);
+
+    /**
+     Add the counters of a query to the search counters.
+     */
+    void RecordSearchStats(const SearchStats &stats);
+
+    /**
+     Format all metrics in Prometheus text exposition format.
+     */
+    std::string PrometheusText() const;
+
+    /**
+     Write the Prometheus text to a file. The text goes to a temporary file first and is
+     renamed over the path, so a reader never sees a partial file.
+
+     @param path File path.
+     @return True when succeed, otherwise false.
+     */
+    bool ExportPrometheus(const std::string &path) const;
+
+    static int BucketIndex(uint64_t value);
+
+    static uint64_t BucketUpperBound(int index);
+
+ private:
+    friend class Counter;
+    friend class Histogram;
+
+    struct Shard {
+        std::atomic<uint64_t> counters[kMaxCounters];
+        std::atomic<uint64_t> sums[kMaxHistograms];
+        std::atomic<uint64_t> buckets[kMaxHistograms][kBucketCount];
+
+        Shard();
+    };
+
+    struct Definition {
+        std::string name;
+        std::string help;
+        double scale;
+    };
+
+    class ShardHandle;
+
+    std::atomic<bool> enabled_;
+    mutable std::mutex mutex_;
+    std::vector<Definition> counter_definitions_;
+    std::vector<Definition> histogram_definitions_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::vector<Shard *> free_shards_;
+    std::vector<Counter> search_counters_;
+
+    Shard &LocalShard();
+
+    Shard *AcquireShard();
+
+    void ReleaseShard(Shard *shard);
+
+    static void Add(std::atomic<uint64_t> &cell, uint64_t value) {
+        // 每个分片只有一个写线程，无需原子加
+        cell.store(cell.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+};
+
+/**
+ Records the latency of a public entry point, and the search counters of a query, into the
+ default registry. Only the outermost scope on a thread records, so an entry point calling
+ another one is counted once.
+ */
+class MetricsScope {
+ public:
+    explicit MetricsScope(const Histogram &latency);
+
+    /**
+     @param latency Latency histogram of the entry point.
+     @param stats Stats pointer of the query. When it is nullptr and recording, it is pointed
+     to a local SearchStats for the duration of the scope.
+     */
+    MetricsScope(const Histogram &latency, SearchStats *&stats);
+
+    ~MetricsScope();
+
+    MetricsScope(const MetricsScope &) = delete;
+    MetricsScope &operator = (const MetricsScope &) = delete;
+
+ private:
+    const Histogram *latency_ = nullptr;
+    SearchStats *stats_ = nullptr;
+    SearchStats initial_stats_;
+    SearchStats local_stats_;
+    std::chrono::steady_clock::time_point start_time_;
+
+    bool Enter(const Histogram &latency);
+};
+
+/**
+ Writes the registry to a file periodically from a background thread, and once more when
+ destroyed.
+ */
+class MetricsExporter {
+ public:
+    MetricsExporter(const std::string &path,
+                    std::chrono::milliseconds interval,
+                    const MetricsRegistry &registry = MetricsRegistry::Default());
+
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter &) = delete;
+    MetricsExporter &operator = (const MetricsExporter &) = delete;
+
+ private:
+    std::string path_;
+    std::chrono::milliseconds interval_;
+    const MetricsRegistry &registry_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stopped_ = false;
+    std::thread thread_;
+
+    void Run();
+};
+
+}  // namespace dwr
+#endif /* metrics_h */
@@ -0,0 +1,180 @@
+//
+//  path_writer.cc
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/28.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include "path_writer.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace dwr {
+
+static const double kRadToDeg = 57.29577951308232;
+
+static void AppendInteger(std::string &buffer, long long value) {
+    char digits[24];
+    int count = 0;
+    unsigned long long magnitude = value < 0 ? 0ULL - static_cast<unsigned long long>(value) : value;
+    do {
+        digits[count++] = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0) {
+        buffer.push_back('-');
+    }
+    while (count > 0) {
+        buffer.push_back(digits[--count]);
+    }
+}
+
+// 与Waypoint::LocationName相同的格式
+static void AppendLocationName(std::string &buffer, const GeoPoint &location) {
+    char text[64];
+    double longitude_degree = location.longitude * kRadToDeg;
+    double latitude_degree = location.latitude * kRadToDeg;
+    int size = snprintf(text, sizeof(text), "%.2f%c%.2f%c",
+                        longitude_degree, longitude_degree >= 0 ? 'E' : 'W',
+                        latitude_degree, latitude_degree >= 0 ? 'N' : 'S');
+    buffer.append(text, static_cast<size_t>(size));
+}
+
+void TextPathEncoder::Encode(WaypointIdentifier origin_identifier,
+                             WaypointIdentifier destination_identifier,
+                             const WaypointPath &path,
+                             std::string &buffer) const {
+    AppendInteger(buffer, origin_identifier);
+    buffer.push_back(',');
+    AppendInteger(buffer, destination_identifier);
+    buffer.push_back(',');
+    for (size_t i = 0; i < path.waypoints.size(); i++) {
+        if (i > 0) {
+            buffer.append("->", 2);
+        }
+        const Waypoint &waypoint = *path.waypoints[i];
+        if (waypoint.user_waypoint && waypoint.name.empty()) {
+            AppendLocationName(buffer, waypoint.GetLocation());
+        } else {
+            buffer.append(waypoint.name);
+        }
+    }
+    buffer.push_back('\n');
+}
+
+template <typename T>
+static char *PutValue(char *cursor, T value) {
+    memcpy(cursor, &value, sizeof(value));
+    return cursor + sizeof(value);
+}
+
+// 用户航路点以无效ID标记，其后写位置
+static bool IsUserWaypoint(const Waypoint &waypoint) {
+    return waypoint.user_waypoint || waypoint.identifier == kNoWaypointIdentifier;
+}
+
+void BinaryPathEncoder::Encode(WaypointIdentifier origin_identifier,
+                               WaypointIdentifier destination_identifier,
+                               const WaypointPath &path,
+                               std::string &buffer) const {
+    // 先计算记录长度，一次扩展缓冲区
+    size_t record_size = 2 * sizeof(int32_t) + sizeof(uint32_t) + path.waypoints.size() * (sizeof(int32_t) + sizeof(double));
+    for (auto &waypoint : path.waypoints) {
+        if (IsUserWaypoint(*waypoint)) {
+            record_size += 2 * sizeof(double);
+        }
+    }
+    size_t offset = buffer.size();
+    buffer.resize(offset + record_size);
+    char *cursor = &buffer[offset];
+    cursor = PutValue(cursor, static_cast<int32_t>(origin_identifier));
+    cursor = PutValue(cursor, static_cast<int32_t>(destination_identifier));
+    cursor = PutValue(cursor, static_cast<uint32_t>(path.waypoints.size()));
+    for (size_t i = 0; i < path.waypoints.size(); i++) {
+        const Waypoint &waypoint = *path.waypoints[i];
+        bool user_waypoint = IsUserWaypoint(waypoint);
+        cursor = PutValue(cursor, static_cast<int32_t>(user_waypoint ? kNoWaypointIdentifier : waypoint.identifier));
+        cursor = PutValue(cursor, static_cast<double>(path.lengths[i]));
+        if (user_waypoint) {
+            cursor = PutValue(cursor, static_cast<double>(waypoint.GetLocation().longitude));
+            cursor = PutValue(cursor, static_cast<double>(waypoint.GetLocation().latitude));
+        }
+    }
+}
+
+template <typename T>
+static bool ReadValue(std::istream &stream, T &value) {
+    return static_cast<bool>(stream.read(reinterpret_cast<char *>(&value), sizeof(value)));
+}
+
+bool BinaryPathReader::Read(PathRecord &record) {
+    int32_t origin_identifier = 0;
+    int32_t destination_identifier = 0;
+    uint32_t waypoint_count = 0;
+    if (!ReadValue(stream_, origin_identifier) ||
+        !ReadValue(stream_, destination_identifier) ||
+        !ReadValue(stream_, waypoint_count)) {
+        return false;
+    }
+    record.origin_identifier = origin_identifier;
+    record.destination_identifier = destination_identifier;
+    record.identifiers.clear();
+    record.lengths.clear();
+    record.user_waypoints.clear();
+    // 数量来自输入，损坏的记录不应引起大块分配，只按上限预留
+    const uint32_t kReserveLimit = 1024;
+    record.identifiers.reserve(std::min(waypoint_count, kReserveLimit));
+    record.lengths.reserve(std::min(waypoint_count, kReserveLimit));
+    for (uint32_t i = 0; i < waypoint_count; i++) {
+        int32_t identifier = 0;
+        double length = 0.0;
+        if (!ReadValue(stream_, identifier) || !ReadValue(stream_, length)) {
+            return false;
+        }
+        record.identifiers.push_back(identifier);
+        record.lengths.push_back(length);
+        if (identifier == kNoWaypointIdentifier) {
+            GeoPoint location;
+            if (!ReadValue(stream_, location.longitude) || !ReadValue(stream_, location.latitude)) {
+                return false;
+            }
+            record.user_waypoints.push_back(std::make_pair(static_cast<int>(i), location));
+        }
+    }
+    return true;
+}
+
+PathWriter::PathWriter(std::ostream &stream, const PathEncoder &encoder, size_t buffer_capacity) :
+stream_(stream), encoder_(encoder), buffer_capacity_(buffer_capacity) {
+    buffer_.reserve(buffer_capacity);
+}
+
+PathWriter::~PathWriter() {
+    Flush();
+}
+
+void PathWriter::Write(WaypointIdentifier origin_identifier,
+                       WaypointIdentifier destination_identifier,
+                       const WaypointPath &path) {
+    encoder_.Encode(origin_identifier, destination_identifier, path, buffer_);
+    record_count_++;
+    if (buffer_.size() >= buffer_capacity_) {
+        Flush();
+    }
+}
+
+bool PathWriter::Flush() {
+    if (!buffer_.empty()) {
+        stream_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        // 清空但保留容量
+        buffer_.clear();
+    }
+    return static_cast<bool>(stream_);
+}
+
+}  // namespace dwr
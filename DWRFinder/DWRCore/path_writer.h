@@ -0,0 +1,141 @@
+//
+//  path_writer.h
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/28.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#ifndef path_writer_h
+#define path_writer_h
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "airway_type.h"
+
+namespace dwr {
+
+/**
+ Encoder of path records, appending to a buffer. Encoders keep no state, so one encoder may be
+ shared by all the workers of a batch.
+ */
+class PathEncoder {
+ public:
+    virtual ~PathEncoder() = default;
+
+    /**
+     Append the record of a path.
+
+     @param origin_identifier Origin waypoint identifier of the query.
+     @param destination_identifier Destination waypoint identifier of the query.
+     @param path Path found, empty when none.
+     @param buffer Buffer appended to.
+     */
+    virtual void Encode(WaypointIdentifier origin_identifier,
+                        WaypointIdentifier destination_identifier,
+                        const WaypointPath &path,
+                        std::string &buffer) const = 0;
+};
+
+/**
+ Text record of the form "origin,destination,NAME->NAME->NAME\n", the same as WaypointPath::ToString
+ gives, written without building a string per path.
+ */
+class TextPathEncoder: public PathEncoder {
+ public:
+    void Encode(WaypointIdentifier origin_identifier,
+                WaypointIdentifier destination_identifier,
+                const WaypointPath &path,
+                std::string &buffer) const override;
+};
+
+/**
+ Binary record in native byte order, like AirwayGraph::SaveToFile:
+ int32 origin, int32 destination, uint32 waypoint count, then for each waypoint int32 identifier
+ and double length from the origin. A user waypoint, e.g. a detour point, is written with
+ kNoWaypointIdentifier and followed by double longitude and latitude in radian.
+ */
+class BinaryPathEncoder: public PathEncoder {
+ public:
+    void Encode(WaypointIdentifier origin_identifier,
+                WaypointIdentifier destination_identifier,
+                const WaypointPath &path,
+                std::string &buffer) const override;
+};
+
+/**
+ Path record read back from the binary format.
+ */
+struct PathRecord {
+    WaypointIdentifier origin_identifier = kNoWaypointIdentifier;
+    WaypointIdentifier destination_identifier = kNoWaypointIdentifier;
+    std::vector<WaypointIdentifier> identifiers;
+    std::vector<GeoDistance> lengths;
+    // Index in the path and location of the user waypoints.
+    std::vector<std::pair<int, GeoPoint>> user_waypoints;
+};
+
+/**
+ Reader of the records written with BinaryPathEncoder.
+ */
+class BinaryPathReader {
+ public:
+    explicit BinaryPathReader(std::istream &stream) : stream_(stream) {}
+
+    /**
+     @param record Record read.
+     @return False at the end of the stream or on a truncated record.
+     */
+    bool Read(PathRecord &record);
+
+ private:
+    std::istream &stream_;
+};
+
+/**
+ Buffered writer of path records to a stream. Records are encoded into a reused buffer, which is
+ written to the stream when it is full. Not thread safe: give each batch worker its own writer
+ and stream, e.g. a file per worker, so no lock is taken.
+ */
+class PathWriter {
+ public:
+    /**
+     @param stream Stream written to, which must outlive the writer.
+     @param encoder Encoder of the records, which must outlive the writer.
+     @param buffer_capacity Bytes buffered before writing to the stream.
+     */
+    PathWriter(std::ostream &stream, const PathEncoder &encoder, size_t buffer_capacity = 1 << 20);
+
+    PathWriter(const PathWriter &) = delete;
+
+    PathWriter &operator = (const PathWriter &) = delete;
+
+    ~PathWriter();
+
+    void Write(WaypointIdentifier origin_identifier,
+               WaypointIdentifier destination_identifier,
+               const WaypointPath &path);
+
+    /**
+     Write the buffered records to the stream.
+
+     @return True when the stream is good.
+     */
+    bool Flush();
+
+    size_t GetRecordCount() const {return record_count_;}
+
+ private:
+    std::ostream &stream_;
+    const PathEncoder &encoder_;
+    std::string buffer_;
+    size_t buffer_capacity_;
+    size_t record_count_ = 0;
+};
+
+}  // namespace dwr
+#endif /* path_writer_h */
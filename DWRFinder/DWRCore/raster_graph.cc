@@ -13,69 +13,344 @@
 #include <algorithm>
 #include <utility>
 #include <vector>
+#include <cstring>
 
 #include "Utils/graphics_utils.h"
 
 namespace dwr {
 
+const int RasterGraph::kTileShift;
+const int RasterGraph::kTileSize;
+
+// 所有无天气的瓦片共用
+static const char kClearTile[RasterGraph::kTileSize * RasterGraph::kTileSize] = {};
+
+// 梯级长度超过该值时先在粗网格上搜索
+static const int kDirectLadderPixels = 128;
+// 粗网格上每个梯级的最多节点数
+static const int kCoarseLadderNodes = 32;
+// 细化时每个梯级在走廊内的最多节点数
+static const int kCorridorNodes = 16;
+// 每段的像素长度，决定分段数
+static const int kSegmentPixels = 64;
+static const int kMaxSegmentNumber = 8;
+// 任意角度搜索的窗口在每个方向上的最多格数
+static const int kAnyAngleWindowCells = 64;
+
+static int FloorDivide(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static PixelDistance HeuristicDistance(const Pixel &p1, const Pixel &p2) {
+    return Pixel::Distance(p1, p2) * 0.9;
+}
+
+void RasterGraph::Reset(int width, int height) {
+    width_ = width;
+    height_ = height;
+    tile_columns_ = (width + kTileSize - 1) >> kTileShift;
+    int tile_rows = (height + kTileSize - 1) >> kTileShift;
+    tile_table_.assign(static_cast<size_t>(tile_columns_) * tile_rows, kClearTile);
+    tile_storage_.clear();
+}
+
+void RasterGraph::SetRasterData(char *raster_data, int width, int height) {
+    std::unique_ptr<char[]> dense_data(raster_data);
+    Reset(width, height);
+    int tile_rows = static_cast<int>(tile_table_.size()) / std::max(tile_columns_, 1);
+    for (int tile_y = 0; tile_y < tile_rows; tile_y++) {
+        for (int tile_x = 0; tile_x < tile_columns_; tile_x++) {
+            int x0 = tile_x << kTileShift, y0 = tile_y << kTileShift;
+            int tile_width = std::min(kTileSize, width - x0), tile_height = std::min(kTileSize, height - y0);
+            bool clear = true;
+            for (int y = 0; y < tile_height && clear; y++) {
+                const char *row = dense_data.get() + static_cast<size_t>(y0 + y) * width + x0;
+                clear = std::memcmp(row, kClearTile, tile_width) == 0;
+            }
+            if (clear) {
+                continue;
+            }
+            // 边缘瓦片超出图像的部分保持为0
+            std::unique_ptr<char[]> tile(new char[kTileSize * kTileSize]());
+            for (int y = 0; y < tile_height; y++) {
+                std::memcpy(tile.get() + (y << kTileShift),
+                            dense_data.get() + static_cast<size_t>(y0 + y) * width + x0,
+                            tile_width);
+            }
+            tile_table_[tile_y * tile_columns_ + tile_x] = tile.get();
+            tile_storage_.push_back(std::move(tile));
+        }
+    }
+}
+
+void RasterGraph::SetPixelValue(const Pixel &pixel, char value) {
+    if (pixel.x < 0 || pixel.x >= width_ || pixel.y < 0 || pixel.y >= height_) {
+        return;
+    }
+    const char *&tile = tile_table_[(pixel.y >> kTileShift) * tile_columns_ + (pixel.x >> kTileShift)];
+    if (tile == kClearTile) {
+        if (value == 0) {
+            return;
+        }
+        tile_storage_.emplace_back(new char[kTileSize * kTileSize]());
+        tile = tile_storage_.back().get();
+    }
+    const_cast<char *>(tile)[((pixel.y & (kTileSize - 1)) << kTileShift) | (pixel.x & (kTileSize - 1))] = value;
+}
+
+bool RasterGraph::IsClearBox(const Pixel &pixel1, const Pixel &pixel2) const {
+    int x0 = std::max(std::min(pixel1.x, pixel2.x), 0), x1 = std::min(std::max(pixel1.x, pixel2.x), width_ - 1);
+    int y0 = std::max(std::min(pixel1.y, pixel2.y), 0), y1 = std::min(std::max(pixel1.y, pixel2.y), height_ - 1);
+    if (x0 > x1 || y0 > y1) {
+        return true;
+    }
+    for (int tile_y = y0 >> kTileShift; tile_y <= (y1 >> kTileShift); tile_y++) {
+        for (int tile_x = x0 >> kTileShift; tile_x <= (x1 >> kTileShift); tile_x++) {
+            if (tile_table_[tile_y * tile_columns_ + tile_x] != kClearTile) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool RasterGraph::FindBlockedSection(const Pixel &origin, const Pixel &destination, Pixel &head, Pixel &tail) const {
+    Line pixels = BresenhamLine(origin, destination);
+    int head_index = 0, tail_index = static_cast<int>(pixels.size()) - 1;
+    while (head_index < pixels.size() && !IsBlockValue(GetPixelValue(pixels[head_index]))) {
+        head_index++;
+    }
+    while (tail_index >= 0 && !IsBlockValue(GetPixelValue(pixels[tail_index]))) {
+        tail_index--;
+    }
+    if (head_index >= tail_index) {
+        return false;
+    }
+    head = pixels[head_index];
+    tail = pixels[tail_index];
+    return true;
+}
+
+bool RasterGraph::IsBlockedCell(const Pixel &cell, int factor) const {
+    Pixel first(cell.x * factor, cell.y * factor);
+    Pixel last(first.x + factor - 1, first.y + factor - 1);
+    if (block_spans_.empty() && IsClearBox(first, last)) {
+        return false;
+    }
+    for (int y = first.y; y <= last.y; y++) {
+        for (int x = first.x; x <= last.x; x++) {
+            if (IsBlockValue(GetPixelValue(Pixel(x, y)))) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void RasterGraph::ForEachTileInBox(const Pixel &pixel1, const Pixel &pixel2,
+                                   const std::function<void(int)> &function) const {
+    int x0 = std::max(std::min(pixel1.x, pixel2.x), 0), x1 = std::min(std::max(pixel1.x, pixel2.x), width_ - 1);
+    int y0 = std::max(std::min(pixel1.y, pixel2.y), 0), y1 = std::min(std::max(pixel1.y, pixel2.y), height_ - 1);
+    for (int tile_y = y0 >> kTileShift; x0 <= x1 && tile_y <= (y1 >> kTileShift); tile_y++) {
+        for (int tile_x = x0 >> kTileShift; tile_x <= (x1 >> kTileShift); tile_x++) {
+            function(tile_y * tile_columns_ + tile_x);
+        }
+    }
+}
+
+std::vector<int> RasterGraph::ChangedTiles(const RasterGraph &other) const {
+    std::vector<int> tile_indices;
+    for (int tile_index = 0; tile_index < std::min(tile_table_.size(), other.tile_table_.size()); tile_index++) {
+        const char *tile = tile_table_[tile_index], *other_tile = other.tile_table_[tile_index];
+        // 都无天气的瓦片不必比较
+        if (tile == other_tile) {
+            continue;
+        }
+        if (tile == kClearTile || other_tile == kClearTile ||
+            std::memcmp(tile, other_tile, kTileSize * kTileSize) != 0) {
+            tile_indices.push_back(tile_index);
+        }
+    }
+    return tile_indices;
+}
+
 std::vector<Line>
 RasterGraph::FetchCandidateLine(const Pixel &origin,
                                 const Pixel &destination,
                                 int segment_number,
                                 double vertical_factor) const {
     std::vector<Line> result;
-    Line pixels = BresenhamLine(origin, destination);
-    int head = 0, tail = static_cast<int>(pixels.size()) - 1;
-    while (head < pixels.size() && GetPixelValue(pixels[head]) == 0) {
-        head++;
-    }
-    while (tail >= 0 && GetPixelValue(pixels[tail]) == 0) {
-        tail--;
-    }
-    if (head >= tail) {
+    Pixel head, tail;
+    if (!FindBlockedSection(origin, destination, head, tail)) {
         return result;
     }
     PixelDistance direct_distance = Pixel::Distance(origin, destination);
-    result = VerticalEquantLine(pixels[head],
-                                pixels[tail],
+    result = VerticalEquantLine(head,
+                                tail,
                                 segment_number,
                                 direct_distance * vertical_factor);
     for (auto &node : result) {
         node.erase(std::remove_if(node.begin(), node.end(), [=](Pixel &p){
-            return GetPixelValue(p) > 0;
+            return IsBlockValue(GetPixelValue(p));
         }), node.end());
     }
     return result;
 }
 
 bool RasterGraph::CheckLine(const Pixel &start_pixel, const Pixel &end_pixel) const {
-    Line pixels = BresenhamLine(start_pixel, end_pixel);
-    for (int i = 0; i < pixels.size(); i++) {
-        if (GetPixelValue(pixels[i]) > 0) {
-            return false;
-        }
+    // 包围盒内的瓦片都无天气时不必逐像素检查
+    int tile_columns = (abs(end_pixel.x - start_pixel.x) >> kTileShift) + 1;
+    int tile_rows = (abs(end_pixel.y - start_pixel.y) >> kTileShift) + 1;
+    if (block_spans_.empty() && tile_columns * tile_rows <= 16 && IsClearBox(start_pixel, end_pixel)) {
+        return true;
     }
-    return true;
+    return WalkBresenhamLine(start_pixel, end_pixel, [this](const Pixel &pixel) {
+        return !IsBlockValue(GetPixelValue(pixel));
+    });
+}
+
+double RasterGraph::LineIntensity(const Pixel &start_pixel, const Pixel &end_pixel) const {
+    int level_sum = 0, pixel_count = 0;
+    WalkBresenhamLine(start_pixel, end_pixel, [&](const Pixel &pixel) {
+        level_sum += static_cast<unsigned char>(GetPixelValue(pixel));
+        pixel_count++;
+        return true;
+    });
+    return static_cast<double>(level_sum) / pixel_count;
+}
+
+PixelDistance RasterGraph::LineCost(const Pixel &start_pixel, const Pixel &end_pixel) const {
+    // 检查阻塞与累计强度在同一次遍历中完成
+    int level_sum = 0, pixel_count = 0;
+    bool passable = WalkBresenhamLine(start_pixel, end_pixel, [&](const Pixel &pixel) {
+        char value = GetPixelValue(pixel);
+        level_sum += static_cast<unsigned char>(value);
+        pixel_count++;
+        return !IsBlockValue(value);
+    });
+    if (!passable) {
+        return kMaxPixelDistance;
+    }
+    double mean_level = static_cast<double>(level_sum) / pixel_count;
+    return Pixel::Distance(start_pixel, end_pixel) * (1 + intensity_weight_ * mean_level);
 }
 
 void RasterGraph::ForEach(const std::function<void(int x, int y, char value)> &traverse_function) const {
     for (int i = 0; i < height_; i++)
         for (int j = 0; j < width_; j++)
-            traverse_function(j, i, raster_data_.get()[i * width_ + j]);
+            traverse_function(j, i, tile_table_[(i >> kTileShift) * tile_columns_ + (j >> kTileShift)]
+                              [((i & (kTileSize - 1)) << kTileShift) | (j & (kTileSize - 1))]);
+}
+
+void RasterGraph::ForEachNonZero(const std::function<void(int x, int y, char value)> &traverse_function) const {
+    for (int tile_index = 0; tile_index < tile_table_.size(); tile_index++) {
+        const char *tile = tile_table_[tile_index];
+        if (tile == kClearTile) {
+            continue;
+        }
+        int x0 = (tile_index % tile_columns_) << kTileShift, y0 = (tile_index / tile_columns_) << kTileShift;
+        // 边缘瓦片超出图像的部分为0，不会被访问
+        for (int y = 0; y < kTileSize; y++) {
+            for (int x = 0; x < kTileSize; x++) {
+                char value = tile[(y << kTileShift) | x];
+                if (value != 0) {
+                    traverse_function(x0 + x, y0 + y, value);
+                }
+            }
+        }
+    }
 }
 
 char RasterGraph::GetPixelValue(const Pixel &pixel) const {
+    char value = 0;
     if (pixel.x >= 0 && pixel.x < width_ && pixel.y >= 0 && pixel.y < height_) {
-        return raster_data_.get()[pixel.y * width_ + pixel.x];
-    } else {
-        return 0;
+        const char *tile = tile_table_[(pixel.y >> kTileShift) * tile_columns_ + (pixel.x >> kTileShift)];
+        value = tile[((pixel.y & (kTileSize - 1)) << kTileShift) | (pixel.x & (kTileSize - 1))];
+    }
+    if (!block_spans_.empty() && !IsBlockValue(value) && InBlockSpans(pixel)) {
+        return static_cast<char>(block_level_);
+    }
+    return value;
+}
+
+void RasterGraph::SetBlockSpans(std::vector<PixelSpan> spans) {
+    block_spans_.clear();
+    block_span_row_offsets_.clear();
+    if (spans.empty()) {
+        return;
+    }
+    std::sort(spans.begin(), spans.end());
+    for (auto &span : spans) {
+        if (!block_spans_.empty() && block_spans_.back().y == span.y && span.begin_x <= block_spans_.back().end_x) {
+            block_spans_.back().end_x = std::max(block_spans_.back().end_x, span.end_x);
+        } else {
+            block_spans_.push_back(span);
+        }
+    }
+    block_span_first_row_ = block_spans_.front().y;
+    int row_count = block_spans_.back().y - block_span_first_row_ + 1;
+    block_span_row_offsets_.assign(row_count + 1, 0);
+    // 每行起始下标，空行与下一行相同
+    int span_index = 0;
+    for (int row = 0; row <= row_count; row++) {
+        while (span_index < block_spans_.size() && block_spans_[span_index].y - block_span_first_row_ < row) {
+            span_index++;
+        }
+        block_span_row_offsets_[row] = span_index;
     }
 }
 
+bool RasterGraph::InBlockSpans(const Pixel &pixel) const {
+    int row = pixel.y - block_span_first_row_;
+    if (row < 0 || row + 1 >= block_span_row_offsets_.size()) {
+        return false;
+    }
+    auto first = block_spans_.begin() + block_span_row_offsets_[row];
+    auto last = block_spans_.begin() + block_span_row_offsets_[row + 1];
+    // 第一个起点大于x的区间之前的那个
+    auto iterator = std::upper_bound(first, last, pixel.x, [](int x, const PixelSpan &span) {return x < span.begin_x;});
+    return iterator != first && pixel.x < (iterator - 1)->end_x;
+}
+
 PixelPath
 RasterGraph::FindPathWithAngle(const Pixel &origin,
                                const Pixel &destination,
-                               const Pixel &previous_origin) const {
+                               const Pixel &previous_origin,
+                               DetourEngine engine) const {
+    // 起止点在天气中时任何绕行都不可行
+    if (IsBlockValue(GetPixelValue(origin)) || IsBlockValue(GetPixelValue(destination))) {
+        return Line();
+    }
+    if (engine == DetourEngine::kThetaStar) {
+        return FindAnyAnglePath(origin, destination, previous_origin);
+    }
+    Pixel head, tail;
+    if (!FindBlockedSection(origin, destination, head, tail)) {
+        return Line();
+    }
+    // 阻塞段越长分段越多
+    int segment_number = std::min(std::max(static_cast<int>(Pixel::Distance(head, tail)) / kSegmentPixels, 3),
+                                  kMaxSegmentNumber);
+    int radius = Pixel::Distance(origin, destination) * 0.5;
+    if (2 * radius > kDirectLadderPixels) {
+        return FindCoarseToFinePath(origin, destination, previous_origin, head, tail, segment_number, radius);
+    }
+    auto nodes = VerticalEquantLine(head, tail, segment_number, radius);
+    // 阻塞段很短时相邻梯级重合，只保留一个
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+    for (auto &node : nodes) {
+        node.erase(std::remove_if(node.begin(), node.end(), [=](Pixel &p){
+            return IsBlockValue(GetPixelValue(p));
+        }), node.end());
+    }
+    return FindLadderPath(origin, destination, previous_origin, nodes);
+}
+
+PixelPath
+RasterGraph::FindLadderPath(const Pixel &origin,
+                            const Pixel &destination,
+                            const Pixel &previous_origin,
+                            const std::vector<Line> &nodes) const {
     auto can_search = [&](const PixelPair &pixel_pair, const PixelInfoPair &info_pair){
         bool result = true;
         // 搜索第一个节点需要判断参数中传入的节点位置
@@ -83,80 +358,322 @@ RasterGraph::FindPathWithAngle(const Pixel &origin,
             if (previous_origin == kNoPixel) {
                 result = true;
             } else {
-                result = Pixel::CosinTurnAngle(previous_origin, pixel_pair.first, pixel_pair.second) > 0;
+                result = Pixel::IsAcuteTurn(previous_origin, pixel_pair.first, pixel_pair.second);
             }
         } else {
-            result = Pixel::CosinTurnAngle(info_pair.first.previous, pixel_pair.first, pixel_pair.second) > 0;
+            result = Pixel::IsAcuteTurn(info_pair.first.previous, pixel_pair.first, pixel_pair.second);
         }
         return result && CheckLine(pixel_pair.first, pixel_pair.second);
     };
-    auto nodes = FetchCandidateLine(origin, destination, 3);
-    if (nodes.empty()) {
-        return Line();
+    if (intensity_weight_ > 0) {
+        // 弱降水区可以穿越但需要付出代价，阻塞检查由代价函数完成
+        auto turn_can_search = [&](const PixelPair &pixel_pair, const PixelInfoPair &info_pair){
+            const Pixel &previous = info_pair.first.previous == kNoPixel ? previous_origin : info_pair.first.previous;
+            return previous == kNoPixel || Pixel::IsAcuteTurn(previous, pixel_pair.first, pixel_pair.second);
+        };
+        auto line_cost = [&](const Pixel &p1, const Pixel &p2) {
+            return LineCost(p1, p2);
+        };
+        return FindPath(origin, destination, nodes, turn_can_search, line_cost);
     }
     return FindPath(origin, destination, nodes, can_search);
 }
 
-static PixelDistance HeuristicDistance(const Pixel &p1, const Pixel &p2) {
-    return Pixel::Distance(p1, p2) * 0.9;
+PixelPath
+RasterGraph::FindCoarseToFinePath(const Pixel &origin,
+                                  const Pixel &destination,
+                                  const Pixel &previous_origin,
+                                  const Pixel &head,
+                                  const Pixel &tail,
+                                  int segment_number,
+                                  int radius) const {
+    int factor = 2;
+    while (2 * radius / factor > kCoarseLadderNodes) {
+        factor *= 2;
+    }
+    auto to_cell = [factor](const Pixel &pixel) {
+        return Pixel(FloorDivide(pixel.x, factor), FloorDivide(pixel.y, factor));
+    };
+    // 最大池化：格内任一像素阻塞则整格阻塞，只计算搜索到的格
+    std::unordered_map<Pixel, bool> blocked_cells;
+    auto is_blocked_cell = [&](const Pixel &cell) {
+        auto iterator = blocked_cells.find(cell);
+        if (iterator != blocked_cells.end()) {
+            return iterator->second;
+        }
+        bool blocked = IsBlockedCell(cell, factor);
+        blocked_cells[cell] = blocked;
+        return blocked;
+    };
+    std::vector<Line> fine_nodes = VerticalEquantLine(head, tail, segment_number, radius);
+    fine_nodes.erase(std::unique(fine_nodes.begin(), fine_nodes.end()), fine_nodes.end());
+    for (auto &node : fine_nodes) {
+        node.erase(std::remove_if(node.begin(), node.end(), [=](Pixel &p){
+            return IsBlockValue(GetPixelValue(p));
+        }), node.end());
+    }
+    // 粗网格的梯级与细网格对齐
+    std::vector<Line> coarse_nodes(fine_nodes.size());
+    for (int i = 0; i < fine_nodes.size(); i++) {
+        for (auto &pixel : fine_nodes[i]) {
+            Pixel cell = to_cell(pixel);
+            if (coarse_nodes[i].empty() || !(coarse_nodes[i].back() == cell)) {
+                coarse_nodes[i].push_back(cell);
+            }
+        }
+        coarse_nodes[i].erase(std::remove_if(coarse_nodes[i].begin(), coarse_nodes[i].end(), is_blocked_cell),
+                              coarse_nodes[i].end());
+    }
+    const Pixel origin_cell = to_cell(origin), destination_cell = to_cell(destination);
+    const Pixel previous_cell = previous_origin == kNoPixel ? kNoPixel : to_cell(previous_origin);
+    auto coarse_can_search = [&](const PixelPair &cell_pair, const PixelInfoPair &info_pair) {
+        const Pixel &previous = info_pair.first.previous == kNoPixel ? previous_cell : info_pair.first.previous;
+        bool turn_allowed = previous == kNoPixel || previous == cell_pair.first ||
+        Pixel::IsAcuteTurn(previous, cell_pair.first, cell_pair.second);
+        if (!turn_allowed) {
+            return false;
+        }
+        // 起止点所在的格可能有天气，由细化检查
+        return WalkBresenhamLine(cell_pair.first, cell_pair.second, [&](const Pixel &cell) {
+            return cell == origin_cell || cell == destination_cell || !is_blocked_cell(cell);
+        });
+    };
+    PixelPath coarse_path = FindPath(origin_cell, destination_cell, coarse_nodes, coarse_can_search);
+    // 粗路径每个梯级恰有一格，两端另有起止点所在的格
+    if (coarse_path.size() == fine_nodes.size() + 2) {
+        // 在粗路径周围的走廊内细化
+        int stride = std::max(3 * factor / kCorridorNodes, 1);
+        std::vector<Line> corridor_nodes(fine_nodes.size());
+        for (size_t i = 0; i < fine_nodes.size(); i++) {
+            const Pixel &cell = coarse_path[i + 1];
+            int count = 0;
+            for (auto &pixel : fine_nodes[i]) {
+                Pixel pixel_cell = to_cell(pixel);
+                if (abs(pixel_cell.x - cell.x) <= 1 && abs(pixel_cell.y - cell.y) <= 1 && count++ % stride == 0) {
+                    corridor_nodes[i].push_back(pixel);
+                }
+            }
+        }
+        PixelPath path = FindLadderPath(origin, destination, previous_origin, corridor_nodes);
+        if (!path.empty()) {
+            return path;
+        }
+    }
+    // 池化会封闭窄的通道，退回到稀疏采样的完整梯级
+    for (auto &node : fine_nodes) {
+        Line sampled_node;
+        for (int i = 0; i < node.size(); i += factor) {
+            sampled_node.push_back(node[i]);
+        }
+        node.swap(sampled_node);
+    }
+    return FindLadderPath(origin, destination, previous_origin, fine_nodes);
+}
+
+PixelPath
+RasterGraph::FindAnyAnglePath(const Pixel &origin,
+                              const Pixel &destination,
+                              const Pixel &previous_origin) const {
+    // 窗口为两端的包围盒向外扩展半个直线长度
+    int margin = static_cast<int>(Pixel::Distance(origin, destination) * 0.5);
+    int min_x = std::min(origin.x, destination.x) - margin, max_x = std::max(origin.x, destination.x) + margin;
+    int min_y = std::min(origin.y, destination.y) - margin, max_y = std::max(origin.y, destination.y) + margin;
+    int step = std::max((std::max(max_x - min_x, max_y - min_y) + kAnyAngleWindowCells) / kAnyAngleWindowCells, 1);
+    int columns = (max_x - min_x) / step + 1, rows = (max_y - min_y) / step + 1;
+    // 格中心之后依次是起点和终点
+    const int cell_count = columns * rows, origin_index = cell_count, destination_index = cell_count + 1;
+    auto node_pixel = [&](int index) {
+        if (index == origin_index) {
+            return origin;
+        }
+        if (index == destination_index) {
+            return destination;
+        }
+        return Pixel(min_x + index % columns * step + step / 2, min_y + index / columns * step + step / 2);
+    };
+    auto cell_index = [&](const Pixel &pixel) {
+        return (pixel.y - min_y) / step * columns + (pixel.x - min_x) / step;
+    };
+    const int origin_cell = cell_index(origin), destination_cell = cell_index(destination);
+    std::vector<PixelDistance> actual_distance(cell_count + 2, kMaxPixelDistance);
+    std::vector<int> parent(cell_count + 2, -1);
+    std::vector<char> closed(cell_count + 2, 0);
+    // 0未知，1可通过，2阻塞
+    std::vector<char> center_state(cell_count, 0);
+    auto line_cost = [&](int index1, int index2) {
+        Pixel p1 = node_pixel(index1), p2 = node_pixel(index2);
+        if (intensity_weight_ > 0) {
+            return LineCost(p1, p2);
+        }
+        return CheckLine(p1, p2) ? Pixel::Distance(p1, p2) : kMaxPixelDistance;
+    };
+    auto turn_allowed = [&](int parent_index, int next_index) {
+        Pixel previous = parent_index == origin_index ? previous_origin : node_pixel(parent[parent_index]);
+        return previous == kNoPixel || Pixel::IsAcuteTurn(previous, node_pixel(parent_index), node_pixel(next_index));
+    };
+    // 周围3x3格的中心，以及相邻时的终点
+    int neighbors[10];
+    auto fetch_neighbors = [&](int index) {
+        int count = 0;
+        int cell = index == origin_index ? origin_cell : index == destination_index ? destination_cell : index;
+        int cell_x = cell % columns, cell_y = cell / columns;
+        for (int y = std::max(cell_y - 1, 0); y <= std::min(cell_y + 1, rows - 1); y++) {
+            for (int x = std::max(cell_x - 1, 0); x <= std::min(cell_x + 1, columns - 1); x++) {
+                int neighbor = y * columns + x;
+                if (neighbor == destination_cell && index != destination_index) {
+                    neighbors[count++] = destination_index;
+                }
+                if (neighbor == index) {
+                    continue;
+                }
+                if (center_state[neighbor] == 0) {
+                    center_state[neighbor] = IsBlockValue(GetPixelValue(node_pixel(neighbor))) ? 2 : 1;
+                }
+                if (center_state[neighbor] == 1) {
+                    neighbors[count++] = neighbor;
+                }
+            }
+        }
+        return count;
+    };
+    using QueueItem = std::pair<PixelDistance, int>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> node_queue;
+    actual_distance[origin_index] = 0;
+    parent[origin_index] = origin_index;
+    node_queue.push(std::make_pair(HeuristicDistance(origin, destination), origin_index));
+    while (!node_queue.empty()) {
+        int u = node_queue.top().second;
+        node_queue.pop();
+        if (closed[u]) {
+            continue;
+        }
+        if (u != origin_index) {
+            // 延迟到扩展时才检查父节点的可见性，不可见时改用已关闭的相邻节点
+            PixelDistance cost = line_cost(parent[u], u);
+            if (cost != kMaxPixelDistance && turn_allowed(parent[u], u)) {
+                actual_distance[u] = actual_distance[parent[u]] + cost;
+            } else {
+                actual_distance[u] = kMaxPixelDistance;
+                parent[u] = -1;
+                int neighbor_count = fetch_neighbors(u);
+                for (int i = 0; i < neighbor_count; i++) {
+                    int v = neighbors[i];
+                    if (!closed[v] || !turn_allowed(v, u)) {
+                        continue;
+                    }
+                    PixelDistance v_cost = line_cost(v, u);
+                    if (v_cost != kMaxPixelDistance && actual_distance[v] + v_cost < actual_distance[u]) {
+                        actual_distance[u] = actual_distance[v] + v_cost;
+                        parent[u] = v;
+                    }
+                }
+                if (parent[u] < 0) {
+                    continue;
+                }
+            }
+        }
+        closed[u] = 1;
+        if (u == destination_index) {
+            break;
+        }
+        const Pixel u_pixel = node_pixel(u);
+        int neighbor_count = fetch_neighbors(u);
+        for (int i = 0; i < neighbor_count; i++) {
+            int v = neighbors[i];
+            if (closed[v]) {
+                continue;
+            }
+            // 乐观地连到u的父节点，转弯不满足时连到u
+            int v_parent = u;
+            Pixel v_pixel = node_pixel(v);
+            PixelDistance distance_through_parent = actual_distance[u] + Pixel::Distance(u_pixel, v_pixel);
+            if (u != origin_index && turn_allowed(parent[u], v)) {
+                v_parent = parent[u];
+                distance_through_parent = actual_distance[v_parent] + Pixel::Distance(node_pixel(v_parent), v_pixel);
+            } else if (!turn_allowed(u, v)) {
+                continue;
+            }
+            if (distance_through_parent < actual_distance[v]) {
+                actual_distance[v] = distance_through_parent;
+                parent[v] = v_parent;
+                node_queue.push(std::make_pair(distance_through_parent + HeuristicDistance(v_pixel, destination), v));
+            }
+        }
+    }
+    PixelPath result;
+    if (!closed[destination_index]) {
+        return result;
+    }
+    for (int index = destination_index; index != origin_index; index = parent[index]) {
+        result.push_back(node_pixel(index));
+    }
+    result.push_back(origin);
+    std::reverse(result.begin(), result.end());
+    return result;
 }
 
 PixelPath
 RasterGraph::FindPath(const Pixel &origin,
                       const Pixel &destination,
                       const std::vector<Line> &node_levels,
-                      const std::function<bool(const PixelPair &, const PixelInfoPair &)> &can_search) {
+                      const std::function<bool(const PixelPair &, const PixelInfoPair &)> &can_search,
+                      const std::function<PixelDistance(const Pixel &, const Pixel &)> &distance) {
     PixelPath result;
     int level_size = static_cast<int>(node_levels.size());
-    std::unordered_map<Pixel, PixelInfo> info_map;
-    info_map[origin] = PixelInfo(0, HeuristicDistance(origin, destination), 0, kNoPixel);
-    info_map[destination] = PixelInfo(kMaxPixelDistance, 0, level_size + 1, kNoPixel);
-    for (int i = 0; i < node_levels.size(); i++) {
+    // 按梯级分别记录，不同梯级上的同一像素是不同的节点
+    std::vector<std::unordered_map<Pixel, PixelInfo>> info_maps(level_size + 2);
+    info_maps[0][origin] = PixelInfo(0, HeuristicDistance(origin, destination), 0, kNoPixel);
+    info_maps[level_size + 1][destination] = PixelInfo(kMaxPixelDistance, 0, level_size + 1, kNoPixel);
+    for (int i = 0; i < level_size; i++) {
         for (auto &px : node_levels[i]) {
-            info_map[px] = PixelInfo(kMaxPixelDistance, kMaxPixelDistance, i + 1, kNoPixel);
+            info_maps[i + 1][px] = PixelInfo(kMaxPixelDistance, kMaxPixelDistance, i + 1, kNoPixel);
         }
     }
-    auto node_compare = [&info_map](const Pixel pixel1, const Pixel pixel2) {
-        return info_map[pixel1].estimated_distance > info_map[pixel2].estimated_distance;
+    using Node = std::pair<Level, Pixel>;
+    auto node_compare = [&info_maps](const Node &node1, const Node &node2) {
+        return info_maps[node1.first][node1.second].estimated_distance >
+        info_maps[node2.first][node2.second].estimated_distance;
     };
-    std::priority_queue<Pixel, std::vector<Pixel>, decltype(node_compare)> node_queue(node_compare);
-    node_queue.push(origin);
+    std::priority_queue<Node, std::vector<Node>, decltype(node_compare)> node_queue(node_compare);
+    node_queue.push(Node(0, origin));
     while (!node_queue.empty()) {
-        Pixel u = node_queue.top();
-        PixelInfo &current_info = info_map[u];
+        Node u = node_queue.top();
+        Level level = u.first;
+        PixelInfo &current_info = info_maps[level][u.second];
         PixelDistance dist = current_info.actual_distance;
-        Level level = current_info.level;
         node_queue.pop();
-        if (u == destination) {
+        if (level == level_size + 1) {
             break;
         }
         const Line &next_level = level != level_size ? node_levels[level] : Line{destination};
+        auto &next_info_map = info_maps[level + 1];
         for (auto &v : next_level) {
-            auto &v_info = info_map[v];
-            if (!can_search(std::make_pair(u, v), std::make_pair(current_info, v_info))) {
+            auto &v_info = next_info_map[v];
+            if (!can_search(std::make_pair(u.second, v), std::make_pair(current_info, v_info))) {
+                continue;
+            }
+            PixelDistance edge_distance = distance(u.second, v);
+            if (edge_distance == kMaxPixelDistance) {
                 continue;
             }
-            PixelDistance distance_through_u = dist + Pixel::Distance(u, v);
+            PixelDistance distance_through_u = dist + edge_distance;
             if (distance_through_u < v_info.actual_distance) {
                 v_info.actual_distance = distance_through_u;
-                v_info.previous = u;
+                v_info.previous = u.second;
                 v_info.estimated_distance = v_info.actual_distance + HeuristicDistance(v, destination);
-                node_queue.push(v);
+                node_queue.push(Node(level + 1, v));
             }
         }
     }
-    Pixel current_pixel = destination;
     // 如果找不到路径 直接返回空
-    if (info_map[current_pixel].previous == kNoPixel) {
+    if (info_maps[level_size + 1][destination].previous == kNoPixel) {
         return result;
     }
-    while (true) {
+    // 前一节点在上一梯级
+    Pixel current_pixel = destination;
+    for (Level level = level_size + 1; level >= 0; level--) {
         result.push_back(current_pixel);
-        PixelInfo &current_info = info_map[current_pixel];
-        if (current_info.previous == kNoPixel) {
-            break;
-        }
-        current_pixel = current_info.previous;
+        current_pixel = info_maps[level][current_pixel].previous;
     }
     std::reverse(result.begin(), result.end());
     return result;
@@ -13,17 +13,44 @@
 
 #include <functional>
 #include <memory>
+#include <stdexcept>
 #include <vector>
 
 #include "raster_type.h"
 
 namespace dwr {
 
+/**
+ Search used to find a detour around the blocked part of a line.
+ */
+enum class DetourEngine {
+    // Nodes on ladders perpendicular to the line, see FindPathWithAngle.
+    kLadder,
+    // Any-angle Lazy Theta* in a window around the line, see FindAnyAnglePath.
+    kThetaStar
+};
+
+/**
+ Raster stored in square tiles. Only the tiles with a non-zero pixel are allocated, the
+ others share one all clear tile, so the memory and the traversal follow the weather
+ coverage instead of the image area.
+ */
 class RasterGraph {
  public:
-    RasterGraph() : raster_data_(nullptr), width_(0), height_(0) {}
+    static const int kTileShift = 6;
+    static const int kTileSize = 1 << kTileShift;
+
+    RasterGraph() : width_(0), height_(0) {}
+
+    /**
+     @param raster_data Pixels in row major order allocated with new[]. The graph takes the ownership and releases it after tiling.
+     */
+    RasterGraph(char *raster_data, int width, int height) {SetRasterData(raster_data, width, height);}
 
-    RasterGraph(char *raster_data, int width, int height): raster_data_(raster_data), width_(width), height_(height) {}
+    /**
+     All clear raster to be filled with SetPixelValue, without a dense buffer.
+     */
+    RasterGraph(int width, int height) {Reset(width, height);}
 
     std::vector<Line> FetchCandidateLine(const Pixel &origin,
                                          const Pixel &destination,
@@ -32,31 +59,166 @@ class RasterGraph {
 
     char GetPixelValue(const Pixel &pixel) const;
 
+    void SetPixelValue(const Pixel &pixel, char value);
+
     void ForEach(const std::function<void(int x, int y, char value)> &traverse_function) const;
 
-    void SetRasterData(char *raster_data, int width, int height) {
-        raster_data_.reset(raster_data);
-        width_ = width;
-        height_ = height;
+    /**
+     Applies the function to the non-zero pixels, skipping the all clear tiles.
+     */
+    void ForEachNonZero(const std::function<void(int x, int y, char value)> &traverse_function) const;
+
+    /**
+     Replace the raster data.
+
+     @param raster_data Pixels in row major order allocated with new[]. The graph takes the ownership and releases it after tiling.
+     */
+    void SetRasterData(char *raster_data, int width, int height);
+
+    /**
+     Clear all pixels and resize.
+     */
+    void Reset(int width, int height);
+
+    int GetWidth() const {return width_;}
+
+    int GetHeight() const {return height_;}
+
+    /**
+     Apply the function to the index of each tile overlapping a box, clipped to the raster.
+     Tiles are indexed in row major order.
+     */
+    void ForEachTileInBox(const Pixel &pixel1, const Pixel &pixel2, const std::function<void(int tile_index)> &function) const;
+
+    /**
+     Indices of the tiles whose pixels differ from another raster of the same size. Block
+     spans are not compared.
+     */
+    std::vector<int> ChangedTiles(const RasterGraph &other) const;
+
+    /**
+     Bytes of the allocated tiles.
+     */
+    size_t AllocatedBytes() const {return tile_storage_.size() * kTileSize * kTileSize;}
+
+    /**
+     Block the pixels of the spans in addition to the raster data, e.g. for vector weather
+     areas. Overlapping spans are merged.
+
+     @param spans Blocking spans, replacing the previous ones.
+     */
+    void SetBlockSpans(std::vector<PixelSpan> spans);
+
+    const std::vector<PixelSpan> &GetBlockSpans() const {return block_spans_;}
+
+    /**
+     Treat the raster as quantized intensity instead of a binary mask, in which the positive
+     values block.
+
+     @param block_level Level from which a pixel is not passable, the bytes read as 0 to 255.
+     @param intensity_weight Crossing a pixel of level L costs (1 + intensity_weight * L) times its length.
+     @throw std::invalid_argument When block_level is not in 1 to 255, so zero pixels would block or none would.
+     */
+    void SetIntensity(int block_level, double intensity_weight) {
+        if (block_level < 1 || block_level > 255) {
+            throw std::invalid_argument("block level out of range");
+        }
+        intensity_ = true;
+        block_level_ = block_level;
+        intensity_weight_ = intensity_weight;
+    }
+
+    int GetBlockLevel() const {return block_level_;}
+
+    double GetIntensityWeight() const {return intensity_weight_;}
+
+    bool IsBlockValue(char value) const {
+        return intensity_ ? static_cast<unsigned char>(value) >= block_level_ : value > 0;
     }
 
+    /**
+     Whether no pixel on a line blocks.
+     */
+    bool CheckLine(const Pixel &start_pixel, const Pixel &end_pixel) const;
+
+    /**
+     Mean intensity level of the pixels on a line.
+     */
+    double LineIntensity(const Pixel &start_pixel, const Pixel &end_pixel) const;
+
     static PixelPath
     FindPath(const Pixel &origin,
              const Pixel &destination,
              const std::vector<Line> &node_levels,
              const std::function<bool(const PixelPair &pixel_pair, const PixelInfoPair &info_pair)> &can_search =
-             [](const PixelPair &pixel_pair, const PixelInfoPair &info_pair){return true;});
+             [](const PixelPair &pixel_pair, const PixelInfoPair &info_pair){return true;},
+             const std::function<PixelDistance(const Pixel &p1, const Pixel &p2)> &distance = Pixel::Distance);
 
+    /**
+     Find a detour around the blocked part of a line, turning less than 90 degrees at each
+     node. The number of segments grows with the blocked length. Long lines are searched on
+     a max-pooled grid first and refined in a corridor around the coarse path, so the cost
+     does not grow with the length of the line.
+
+     @param origin Origin pixel.
+     @param destination Destination pixel.
+     @param previous_origin Pixel before origin, or kNoPixel.
+     @param engine Search used, kThetaStar calls FindAnyAnglePath.
+     @return Path from origin to destination, empty when not found.
+     */
     PixelPath
     FindPathWithAngle(const Pixel &origin,
                       const Pixel &destination,
-                      const Pixel &previous_origin = kNoPixel) const;
+                      const Pixel &previous_origin = kNoPixel,
+                      DetourEngine engine = DetourEngine::kLadder) const;
+
+    /**
+     Find a detour with Lazy Theta* on a grid of at most 64 by 64 cells covering a window
+     around the line. A node may connect to any node it can see, so the path is not bound to
+     the ladders, and the line of sight is only checked when a node is expanded. The turns are
+     less than 90 degrees as in FindPathWithAngle.
+
+     @param origin Origin pixel.
+     @param destination Destination pixel.
+     @param previous_origin Pixel before origin, or kNoPixel.
+     @return Path from origin to destination, empty when not found.
+     */
+    PixelPath
+    FindAnyAnglePath(const Pixel &origin,
+                     const Pixel &destination,
+                     const Pixel &previous_origin = kNoPixel) const;
 
  private:
-    std::unique_ptr<char> raster_data_;
+    // Tiles in row major order, pointing to the shared clear tile or to tile_storage_.
+    std::vector<const char *> tile_table_;
+    std::vector<std::unique_ptr<char[]>> tile_storage_;
+    int tile_columns_ = 0;
     int width_;
     int height_;
-    bool CheckLine(const Pixel &start_pixel, const Pixel &end_pixel) const;
+    // Binary mask until SetIntensity.
+    bool intensity_ = false;
+    int block_level_ = 1;
+    double intensity_weight_ = 0.0;
+    // Merged spans sorted by row, and the index of the first span of each row from block_span_first_row_.
+    std::vector<PixelSpan> block_spans_;
+    std::vector<int> block_span_row_offsets_;
+    int block_span_first_row_ = 0;
+    bool InBlockSpans(const Pixel &pixel) const;
+    bool IsClearBox(const Pixel &pixel1, const Pixel &pixel2) const;
+    bool IsBlockedCell(const Pixel &cell, int factor) const;
+    bool FindBlockedSection(const Pixel &origin, const Pixel &destination, Pixel &head, Pixel &tail) const;
+    PixelPath FindLadderPath(const Pixel &origin,
+                             const Pixel &destination,
+                             const Pixel &previous_origin,
+                             const std::vector<Line> &nodes) const;
+    PixelPath FindCoarseToFinePath(const Pixel &origin,
+                                   const Pixel &destination,
+                                   const Pixel &previous_origin,
+                                   const Pixel &head,
+                                   const Pixel &tail,
+                                   int segment_number,
+                                   int radius) const;
+    PixelDistance LineCost(const Pixel &start_pixel, const Pixel &end_pixel) const;
 };
 
 }  // namespace dwr
@@ -10,6 +10,7 @@
 #define raster_type_h
 
 #include <math.h>
+#include <stdint.h>
 
 #include <functional>
 #include <limits>
@@ -48,6 +49,11 @@ struct Pixel {
         double cn_y = next.y - current.y;
         return (pc_x * cn_x + pc_y * cn_y) / (sqrt(pc_x * pc_x + pc_y * pc_y) * sqrt(cn_x * cn_x + cn_y * cn_y));
     }
+
+    // Same as CosinTurnAngle(previous, current, next) > 0, without sqrt and division.
+    static bool IsAcuteTurn(const Pixel &previous, const Pixel &current, const Pixel &next) {
+        return (current.x - previous.x) * (next.x - current.x) + (current.y - previous.y) * (next.y - current.y) > 0;
+    }
 };
 
 const Pixel kNoPixel = {-1, -1};
@@ -55,6 +61,23 @@ const Pixel kNoPixel = {-1, -1};
 using Line = std::vector<Pixel>;
 using PixelPath = std::vector<Pixel>;
 
+/**
+ Pixels [begin_x, end_x) of row y.
+ */
+struct PixelSpan {
+    int y;
+    int begin_x;
+    int end_x;
+
+    bool operator < (const PixelSpan &other) const {
+        return std::tie(y, begin_x, end_x) < std::tie(other.y, other.begin_x, other.end_x);
+    }
+
+    bool operator == (const PixelSpan &other) const {
+        return std::tie(y, begin_x, end_x) == std::tie(other.y, other.begin_x, other.end_x);
+    }
+};
+
 struct PixelInfo {
     PixelDistance actual_distance;
     PixelDistance estimated_distance;
@@ -78,7 +101,10 @@ namespace std {
 template<>
 struct hash<dwr::Pixel> {
     std::size_t operator()(const dwr::Pixel &p) const {
-        return std::hash<int>()(p.x) ^ std::hash<int>()(p.y);
+        // x ^ y 在对角线方向大量冲突，打包后再混合
+        uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(p.x)) << 32) | static_cast<uint32_t>(p.y);
+        key *= 0x9E3779B97F4A7C15ULL;
+        return static_cast<std::size_t>(key ^ (key >> 32));
     }
 };
 }
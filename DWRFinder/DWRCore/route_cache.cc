@@ -0,0 +1,138 @@
+//
+//  route_cache.cc
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/22.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include "route_cache.h"
+
+#include "metrics.h"
+
+namespace dwr {
+
+static const Counter route_cache_hits =
+MetricsRegistry::Default().AddCounter("dwr_route_cache_hits", "Queries answered by the route cache.");
+static const Counter route_cache_misses =
+MetricsRegistry::Default().AddCounter("dwr_route_cache_misses", "Queries searched because the route cache had no valid route.");
+static const Counter route_cache_invalidations =
+MetricsRegistry::Default().AddCounter("dwr_route_cache_invalidations", "Cached routes dropped by weather updates.");
+
+bool RouteCache::Find(const RouteKey &key, WaypointPath &path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iterator = entries_.find(key);
+    if (iterator == entries_.end()) {
+        route_cache_misses.Increment();
+        return false;
+    }
+    recent_keys_.splice(recent_keys_.begin(), recent_keys_, iterator->second.recent_iterator);
+    path = iterator->second.path;
+    route_cache_hits.Increment();
+    return true;
+}
+
+void RouteCache::Insert(const RouteKey &key,
+                        const WaypointPath &path,
+                        const std::set<UndirectedWaypointPair> &edges,
+                        const std::set<TileKey> &tiles) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iterator = entries_.find(key);
+    if (iterator != entries_.end()) {
+        Erase(iterator);
+    }
+    if (capacity_ == 0) {
+        return;
+    }
+    recent_keys_.push_front(key);
+    Entry &entry = entries_[key];
+    entry.path = path;
+    entry.edges.assign(edges.begin(), edges.end());
+    entry.tiles.assign(tiles.begin(), tiles.end());
+    entry.recent_iterator = recent_keys_.begin();
+    for (auto &edge : edges) {
+        edge_index_[edge].insert(key);
+    }
+    for (auto tile : tiles) {
+        tile_index_[tile].insert(key);
+    }
+    Shrink();
+}
+
+void RouteCache::Erase(std::map<RouteKey, Entry>::iterator iterator) {
+    const RouteKey &key = iterator->first;
+    for (auto &edge : iterator->second.edges) {
+        auto edge_iterator = edge_index_.find(edge);
+        edge_iterator->second.erase(key);
+        if (edge_iterator->second.empty()) {
+            edge_index_.erase(edge_iterator);
+        }
+    }
+    for (auto tile : iterator->second.tiles) {
+        auto tile_iterator = tile_index_.find(tile);
+        tile_iterator->second.erase(key);
+        if (tile_iterator->second.empty()) {
+            tile_index_.erase(tile_iterator);
+        }
+    }
+    recent_keys_.erase(iterator->second.recent_iterator);
+    entries_.erase(iterator);
+}
+
+void RouteCache::Shrink() {
+    while (entries_.size() > capacity_) {
+        Erase(entries_.find(recent_keys_.back()));
+    }
+}
+
+void RouteCache::InvalidateEdges(const std::vector<UndirectedWaypointPair> &edges) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &edge : edges) {
+        auto edge_iterator = edge_index_.find(edge);
+        if (edge_iterator == edge_index_.end()) {
+            continue;
+        }
+        // Erase会修改索引，先复制
+        std::set<RouteKey> keys = edge_iterator->second;
+        for (auto &key : keys) {
+            Erase(entries_.find(key));
+        }
+        route_cache_invalidations.Increment(keys.size());
+    }
+}
+
+void RouteCache::InvalidateTiles(const std::vector<TileKey> &tiles) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto tile : tiles) {
+        auto tile_iterator = tile_index_.find(tile);
+        if (tile_iterator == tile_index_.end()) {
+            continue;
+        }
+        std::set<RouteKey> keys = tile_iterator->second;
+        for (auto &key : keys) {
+            Erase(entries_.find(key));
+        }
+        route_cache_invalidations.Increment(keys.size());
+    }
+}
+
+void RouteCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    recent_keys_.clear();
+    edge_index_.clear();
+    tile_index_.clear();
+}
+
+void RouteCache::SetCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = capacity;
+    Shrink();
+}
+
+size_t RouteCache::GetSize() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+}  // namespace dwr
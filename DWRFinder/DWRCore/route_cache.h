@@ -0,0 +1,117 @@
+//
+//  route_cache.h
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/22.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#ifndef route_cache_h
+#define route_cache_h
+
+#include <stdint.h>
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "dynamic_airway_graph.h"
+#include "raster_graph.h"
+
+namespace dwr {
+
+/**
+ Query of a cached route.
+ */
+struct RouteKey {
+    WaypointIdentifier origin_identifier;
+    WaypointIdentifier destination_identifier;
+    DetourEngine detour_engine;
+    TurnSearch turn_search;
+
+    bool operator < (const RouteKey &other) const {
+        return std::tie(origin_identifier, destination_identifier, detour_engine, turn_search) <
+        std::tie(other.origin_identifier, other.destination_identifier, other.detour_engine, other.turn_search);
+    }
+};
+
+/**
+ Routes of recent queries together with what they depend on: the edges whose blocking would
+ change the route, and the raster tiles in which the weather would change its detours. Each
+ edge and tile points back to the routes depending on it, so an update only drops the routes
+ it touches. The least recently used route is dropped when full. Thread safe.
+ */
+class RouteCache {
+ public:
+    // Source index in the high half, tile index in the low half.
+    using TileKey = uint64_t;
+
+    explicit RouteCache(size_t capacity = 1024) : capacity_(capacity) {}
+
+    static TileKey MakeTileKey(int source_index, int tile_index) {
+        return (static_cast<uint64_t>(source_index) << 32) | static_cast<uint32_t>(tile_index);
+    }
+
+    /**
+     @param key Query.
+     @param path Set to the cached route when found.
+     @return True when found.
+     */
+    bool Find(const RouteKey &key, WaypointPath &path);
+
+    /**
+     Add or replace a route.
+
+     @param key Query.
+     @param path Route, possibly empty when no route is found.
+     @param edges Edges whose blocking the route depends on.
+     @param tiles Tiles in which the weather the route depends on.
+     */
+    void Insert(const RouteKey &key,
+                const WaypointPath &path,
+                const std::set<UndirectedWaypointPair> &edges,
+                const std::set<TileKey> &tiles);
+
+    /**
+     Drop the routes depending on the edges.
+     */
+    void InvalidateEdges(const std::vector<UndirectedWaypointPair> &edges);
+
+    /**
+     Drop the routes depending on the tiles.
+     */
+    void InvalidateTiles(const std::vector<TileKey> &tiles);
+
+    void Clear();
+
+    void SetCapacity(size_t capacity);
+
+    size_t GetSize() const;
+
+ private:
+    struct Entry {
+        WaypointPath path;
+        std::vector<UndirectedWaypointPair> edges;
+        std::vector<TileKey> tiles;
+        std::list<RouteKey>::iterator recent_iterator;
+    };
+
+    mutable std::mutex mutex_;
+    size_t capacity_;
+    std::map<RouteKey, Entry> entries_;
+    // Most recently used first.
+    std::list<RouteKey> recent_keys_;
+    std::map<UndirectedWaypointPair, std::set<RouteKey>> edge_index_;
+    std::unordered_map<TileKey, std::set<RouteKey>> tile_index_;
+
+    void Erase(std::map<RouteKey, Entry>::iterator iterator);
+
+    void Shrink();
+};
+
+}  // namespace dwr
+#endif /* route_cache_h */
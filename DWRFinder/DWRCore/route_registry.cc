@@ -0,0 +1,155 @@
+//
+//  route_registry.cc
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/24.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include "route_registry.h"
+
+#include <algorithm>
+
+namespace dwr {
+
+// 从索引中移除航路在这些键上的条目
+template <typename Key>
+static void EraseEntries(std::map<Key, std::vector<std::pair<RouteIdentifier, int>>> &index,
+                         const std::vector<Key> &keys,
+                         RouteIdentifier route_identifier) {
+    for (auto &key : keys) {
+        auto iterator = index.find(key);
+        if (iterator == index.end()) {
+            continue;
+        }
+        auto &entries = iterator->second;
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const std::pair<RouteIdentifier, int> &entry) {
+            return entry.first == route_identifier;
+        }), entries.end());
+        if (entries.empty()) {
+            index.erase(iterator);
+        }
+    }
+}
+
+void RouteRegistry::Register(RouteIdentifier route_identifier,
+                             const WaypointPath &path,
+                             const std::function<void(const WaypointPair &edge,
+                                                      std::vector<RouteCache::TileKey> &tiles)> &detour_tiles) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Erase(route_identifier);
+    std::vector<UndirectedWaypointPair> &edges = route_edges_[route_identifier];
+    std::vector<RouteCache::TileKey> &tiles = route_tiles_[route_identifier];
+    // 第一个航路点之前的绕行点没有对应的航段
+    int i = 0;
+    while (i < path.GetSize() && path.waypoints[i]->user_waypoint) {
+        i++;
+    }
+    while (i + 1 < path.GetSize()) {
+        // 下一个航路点，中间均为绕行点
+        int j = i + 1;
+        while (j < path.GetSize() && path.waypoints[j]->user_waypoint) {
+            j++;
+        }
+        if (j == path.GetSize()) {
+            break;
+        }
+        WaypointPair waypoint_pair(path.waypoints[i], path.waypoints[j]);
+        UndirectedWaypointPair edge(waypoint_pair);
+        edges.push_back(edge);
+        auto &edge_entries = edge_index_[edge];
+        for (int k = i; k < j; k++) {
+            edge_entries.push_back(std::make_pair(route_identifier, k));
+        }
+        if (j > i + 1 && detour_tiles) {
+            // 绕行段随其所在瓦片中的天气变化
+            std::vector<RouteCache::TileKey> detour_tile_list;
+            detour_tiles(waypoint_pair, detour_tile_list);
+            for (auto tile : detour_tile_list) {
+                tiles.push_back(tile);
+                auto &tile_entries = tile_index_[tile];
+                for (int k = i; k < j; k++) {
+                    tile_entries.push_back(std::make_pair(route_identifier, k));
+                }
+            }
+        }
+        i = j;
+    }
+}
+
+void RouteRegistry::Erase(RouteIdentifier route_identifier) {
+    auto iterator = route_edges_.find(route_identifier);
+    if (iterator == route_edges_.end()) {
+        return;
+    }
+    EraseEntries(edge_index_, iterator->second, route_identifier);
+    route_edges_.erase(iterator);
+    auto tile_iterator = route_tiles_.find(route_identifier);
+    if (tile_iterator != route_tiles_.end()) {
+        EraseEntries(tile_index_, tile_iterator->second, route_identifier);
+        route_tiles_.erase(tile_iterator);
+    }
+}
+
+bool RouteRegistry::Unregister(RouteIdentifier route_identifier) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (route_edges_.find(route_identifier) == route_edges_.end()) {
+        return false;
+    }
+    Erase(route_identifier);
+    return true;
+}
+
+std::vector<RouteImpact> RouteRegistry::FindImpacts(const std::vector<UndirectedWaypointPair> &edges,
+                                                    const std::vector<RouteCache::TileKey> &tiles,
+                                                    bool all_tiles_changed) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 只访问变化航段和瓦片上的航路
+    std::map<RouteIdentifier, std::vector<int>> segment_map;
+    auto add_entries = [&](const std::vector<std::pair<RouteIdentifier, int>> &entries) {
+        for (auto &entry : entries) {
+            segment_map[entry.first].push_back(entry.second);
+        }
+    };
+    for (auto &edge : edges) {
+        auto iterator = edge_index_.find(edge);
+        if (iterator != edge_index_.end()) {
+            add_entries(iterator->second);
+        }
+    }
+    if (all_tiles_changed) {
+        for (auto &pair : tile_index_) {
+            add_entries(pair.second);
+        }
+    } else {
+        for (auto tile : tiles) {
+            auto iterator = tile_index_.find(tile);
+            if (iterator != tile_index_.end()) {
+                add_entries(iterator->second);
+            }
+        }
+    }
+    std::vector<RouteImpact> impacts;
+    impacts.reserve(segment_map.size());
+    for (auto &pair : segment_map) {
+        std::sort(pair.second.begin(), pair.second.end());
+        pair.second.erase(std::unique(pair.second.begin(), pair.second.end()), pair.second.end());
+        impacts.push_back({pair.first, std::move(pair.second)});
+    }
+    return impacts;
+}
+
+void RouteRegistry::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    route_edges_.clear();
+    route_tiles_.clear();
+    edge_index_.clear();
+    tile_index_.clear();
+}
+
+size_t RouteRegistry::GetSize() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return route_edges_.size();
+}
+
+}  // namespace dwr
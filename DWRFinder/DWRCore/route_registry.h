@@ -0,0 +1,90 @@
+//
+//  route_registry.h
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/24.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#ifndef route_registry_h
+#define route_registry_h
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "dynamic_airway_graph.h"
+#include "route_cache.h"
+
+namespace dwr {
+
+using RouteIdentifier = int64_t;
+
+/**
+ Registered route crossing newly blocked edges, or detouring through weather that changed.
+ */
+struct RouteImpact {
+    RouteIdentifier route_identifier;
+    // Index i is the segment from waypoints[i] to waypoints[i + 1] of the registered path.
+    std::vector<int> segment_indices;
+};
+
+/**
+ Active routes indexed by the airway edges they fly, so the routes broken by an update are
+ found from the changed edges without testing every route. The legs of a detour are indexed
+ by the airway edge they replace and by the raster tiles the detour was searched in, as in
+ RouteCache. Detour waypoints before the first or after the last airway waypoint, as when
+ attaching a location, have no such edge and are not indexed. Thread safe.
+ */
+class RouteRegistry {
+ public:
+    /**
+     Add or replace a route.
+
+     @param route_identifier Identifier chosen by the caller.
+     @param path Route.
+     @param detour_tiles Appends the tiles the detour of an edge depends on, nullptr for none.
+     */
+    void Register(RouteIdentifier route_identifier,
+                  const WaypointPath &path,
+                  const std::function<void(const WaypointPair &edge,
+                                           std::vector<RouteCache::TileKey> &tiles)> &detour_tiles = nullptr);
+
+    /**
+     @return False when the route is not registered.
+     */
+    bool Unregister(RouteIdentifier route_identifier);
+
+    /**
+     Routes flying any of the edges or detouring through any of the tiles, ordered by identifier.
+
+     @param edges Newly blocked edges.
+     @param tiles Tiles whose weather changed.
+     @param all_tiles_changed Every detour is affected, e.g. when a raster is resized.
+     */
+    std::vector<RouteImpact> FindImpacts(const std::vector<UndirectedWaypointPair> &edges,
+                                         const std::vector<RouteCache::TileKey> &tiles = std::vector<RouteCache::TileKey>(),
+                                         bool all_tiles_changed = false) const;
+
+    void Clear();
+
+    size_t GetSize() const;
+
+ private:
+    mutable std::mutex mutex_;
+    std::unordered_map<RouteIdentifier, std::vector<UndirectedWaypointPair>> route_edges_;
+    std::unordered_map<RouteIdentifier, std::vector<RouteCache::TileKey>> route_tiles_;
+    // Routes and segment indices on each edge, and on the tiles of each detour.
+    std::map<UndirectedWaypointPair, std::vector<std::pair<RouteIdentifier, int>>> edge_index_;
+    std::map<RouteCache::TileKey, std::vector<std::pair<RouteIdentifier, int>>> tile_index_;
+
+    void Erase(RouteIdentifier route_identifier);
+};
+
+}  // namespace dwr
+#endif /* route_registry_h */
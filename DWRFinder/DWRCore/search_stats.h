@@ -0,0 +1,51 @@
+//
+//  search_stats.h
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/12.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#ifndef search_stats_h
+#define search_stats_h
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dwr {
+
+/**
+ Counters of a single query. Pass a pointer to the search functions to collect them,
+ nullptr skips all the bookkeeping. Counters are added up, so the same object may be
+ reused across the spur searches of a k-path query.
+ */
+struct SearchStats {
+    // Distinct waypoints popped from the open list.
+    uint64_t nodes_settled = 0;
+    uint64_t heap_pushes = 0;
+    // Pops of a waypoint which had already been settled.
+    uint64_t stale_pops = 0;
+    uint64_t can_search_calls = 0;
+    // Edges found in the block set.
+    uint64_t blocked_edges = 0;
+    uint64_t angle_search_calls = 0;
+    double angle_search_milliseconds = 0;
+    // Angle searches which found no detour.
+    uint64_t failed_detours = 0;
+    uint64_t inserted_waypoints = 0;
+    // Single path searches, more than one for a k-path query.
+    uint64_t path_searches = 0;
+    // Spur searches of Yen's algorithm.
+    uint64_t spur_searches = 0;
+    // Edges skipped by the edge search because a state not longer had expanded them.
+    uint64_t dominated_edges = 0;
+    // Labels dropped by the Pareto search as dominated.
+    uint64_t dominated_labels = 0;
+    // Estimated bytes of the search containers and waypoint pools, summed over the searches.
+    size_t workspace_bytes = 0;
+
+    void Reset() {*this = SearchStats();}
+};
+
+}  // namespace dwr
+#endif /* search_stats_h */
@@ -0,0 +1,197 @@
+//
+//  waypoint_index.cc
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/15.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include "waypoint_index.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+namespace dwr {
+
+WaypointIndex::Node WaypointIndex::MakeNode(const GeoPoint &location, int index) {
+    Node node;
+    node.point[0] = cos(location.latitude) * cos(location.longitude);
+    node.point[1] = cos(location.latitude) * sin(location.longitude);
+    node.point[2] = sin(location.latitude);
+    node.axis = 0;
+    node.index = index;
+    return node;
+}
+
+double WaypointIndex::SquaredChord(const double *point1, const double *point2) {
+    double dx = point1[0] - point2[0];
+    double dy = point1[1] - point2[1];
+    double dz = point1[2] - point2[2];
+    return dx * dx + dy * dy + dz * dz;
+}
+
+void WaypointIndex::Build(const std::vector<WaypointPtr> &waypoints) {
+    waypoints_ = waypoints;
+    pending_.clear();
+    nodes_.clear();
+    nodes_.reserve(waypoints_.size());
+    for (size_t i = 0; i < waypoints_.size(); i++) {
+        nodes_.push_back(MakeNode(waypoints_[i]->GetLocation(), static_cast<int>(i)));
+    }
+    BuildRange(0, static_cast<int>(nodes_.size()));
+}
+
+void WaypointIndex::BuildRange(int first, int last) {
+    if (last - first <= 1) {
+        return;
+    }
+    // 按跨度最大的轴划分
+    double lower[3] = {2, 2, 2}, upper[3] = {-2, -2, -2};
+    for (int i = first; i < last; i++) {
+        for (int j = 0; j < 3; j++) {
+            lower[j] = std::min(lower[j], nodes_[i].point[j]);
+            upper[j] = std::max(upper[j], nodes_[i].point[j]);
+        }
+    }
+    int axis = 0;
+    for (int j = 1; j < 3; j++) {
+        if (upper[j] - lower[j] > upper[axis] - lower[axis]) {
+            axis = j;
+        }
+    }
+    int middle = first + (last - first) / 2;
+    std::nth_element(nodes_.begin() + first, nodes_.begin() + middle, nodes_.begin() + last,
+                     [axis](const Node &node1, const Node &node2) {return node1.point[axis] < node2.point[axis];});
+    nodes_[middle].axis = axis;
+    BuildRange(first, middle);
+    BuildRange(middle + 1, last);
+}
+
+void WaypointIndex::Insert(const WaypointPtr &waypoint) {
+    Node node = MakeNode(waypoint->GetLocation(), static_cast<int>(waypoints_.size()));
+    for (auto &indexed : Within(waypoint->GetLocation(), 0)) {
+        if (indexed == waypoint) {
+            return;
+        }
+    }
+    waypoints_.push_back(waypoint);
+    pending_.push_back(node);
+    // 线性扫描的部分过多时重建
+    if (pending_.size() > 64 + nodes_.size() / 16) {
+        std::vector<WaypointPtr> waypoints;
+        waypoints.swap(waypoints_);
+        Build(waypoints);
+    }
+}
+
+void WaypointIndex::Clear() {
+    waypoints_.clear();
+    nodes_.clear();
+    pending_.clear();
+}
+
+void WaypointIndex::Visit(const Node &node, const double *point, size_t k, const Filter &filter,
+                          std::vector<Candidate> &heap) const {
+    double squared_chord = SquaredChord(node.point, point);
+    if (heap.size() == k && squared_chord >= heap.front().first) {
+        return;
+    }
+    if (filter && !filter(*waypoints_[node.index])) {
+        return;
+    }
+    heap.push_back(std::make_pair(squared_chord, node.index));
+    std::push_heap(heap.begin(), heap.end());
+    if (heap.size() > k) {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.pop_back();
+    }
+}
+
+void WaypointIndex::NearestRange(int first, int last, const double *point, size_t k, const Filter &filter,
+                                 std::vector<Candidate> &heap) const {
+    if (first >= last) {
+        return;
+    }
+    int middle = first + (last - first) / 2;
+    const Node &node = nodes_[middle];
+    Visit(node, point, k, filter, heap);
+    double difference = point[node.axis] - node.point[node.axis];
+    if (difference < 0) {
+        NearestRange(first, middle, point, k, filter, heap);
+        if (heap.size() < k || difference * difference < heap.front().first) {
+            NearestRange(middle + 1, last, point, k, filter, heap);
+        }
+    } else {
+        NearestRange(middle + 1, last, point, k, filter, heap);
+        if (heap.size() < k || difference * difference < heap.front().first) {
+            NearestRange(first, middle, point, k, filter, heap);
+        }
+    }
+}
+
+std::vector<WaypointPtr> WaypointIndex::Nearest(const GeoPoint &location, int k, const Filter &filter) const {
+    std::vector<WaypointPtr> result;
+    if (k <= 0) {
+        return result;
+    }
+    Node query = MakeNode(location, -1);
+    std::vector<Candidate> heap;
+    size_t count = static_cast<size_t>(k);
+    heap.reserve(count + 1);
+    NearestRange(0, static_cast<int>(nodes_.size()), query.point, count, filter, heap);
+    for (auto &node : pending_) {
+        Visit(node, query.point, count, filter, heap);
+    }
+    std::sort_heap(heap.begin(), heap.end());
+    for (auto &candidate : heap) {
+        result.push_back(waypoints_[candidate.second]);
+    }
+    return result;
+}
+
+void WaypointIndex::WithinRange(int first, int last, const double *point, double squared_chord,
+                                std::vector<Candidate> &result) const {
+    if (first >= last) {
+        return;
+    }
+    int middle = first + (last - first) / 2;
+    const Node &node = nodes_[middle];
+    double node_squared_chord = SquaredChord(node.point, point);
+    if (node_squared_chord <= squared_chord) {
+        result.push_back(std::make_pair(node_squared_chord, node.index));
+    }
+    double difference = point[node.axis] - node.point[node.axis];
+    if (difference <= 0 || difference * difference <= squared_chord) {
+        WithinRange(first, middle, point, squared_chord, result);
+    }
+    if (difference >= 0 || difference * difference <= squared_chord) {
+        WithinRange(middle + 1, last, point, squared_chord, result);
+    }
+}
+
+std::vector<WaypointPtr> WaypointIndex::Within(const GeoPoint &location, GeoDistance radius) const {
+    std::vector<WaypointPtr> result;
+    if (radius < 0) {
+        return result;
+    }
+    // 弦长 = 2sin(θ/2)
+    double chord = 2 * sin(std::min(radius / kEarthRadius, M_PI) / 2);
+    double squared_chord = chord * chord;
+    Node query = MakeNode(location, -1);
+    std::vector<Candidate> candidates;
+    WithinRange(0, static_cast<int>(nodes_.size()), query.point, squared_chord, candidates);
+    for (auto &node : pending_) {
+        double node_squared_chord = SquaredChord(node.point, query.point);
+        if (node_squared_chord <= squared_chord) {
+            candidates.push_back(std::make_pair(node_squared_chord, node.index));
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    for (auto &candidate : candidates) {
+        result.push_back(waypoints_[candidate.second]);
+    }
+    return result;
+}
+
+}  // namespace dwr
@@ -0,0 +1,102 @@
+//
+//  waypoint_index.h
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/15.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#ifndef waypoint_index_h
+#define waypoint_index_h
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "airway_type.h"
+
+namespace dwr {
+
+/**
+ Spatial index of waypoints for nearest and radius queries.
+
+ Waypoints are kept as unit vectors on the sphere in a k-d tree, where the chord length
+ orders the points the same way as the great circle distance, so the results are exact
+ everywhere including near the poles and across the antimeridian. Waypoints inserted
+ after building are scanned linearly until there are enough of them to rebuild.
+ */
+class WaypointIndex {
+ public:
+    using Filter = std::function<bool(const Waypoint &waypoint)>;
+
+    /**
+     Build the index from scratch.
+
+     @param waypoints Waypoints to index.
+     */
+    void Build(const std::vector<WaypointPtr> &waypoints);
+
+    /**
+     Add a waypoint unless it is already indexed.
+
+     @param waypoint Waypoint pointer.
+     */
+    void Insert(const WaypointPtr &waypoint);
+
+    /**
+     Remove all waypoints.
+     */
+    void Clear();
+
+    size_t GetSize() const {return nodes_.size() + pending_.size();}
+
+    /**
+     Find the nearest waypoints.
+
+     @param location Query location.
+     @param k Number of waypoints.
+     @param filter Only the waypoints for which it returns true are considered, nullptr for all.
+     @return At most k waypoints ordered by distance.
+     */
+    std::vector<WaypointPtr> Nearest(const GeoPoint &location, int k, const Filter &filter = nullptr) const;
+
+    /**
+     Find the waypoints within a distance.
+
+     @param location Query location.
+     @param radius Great circle distance in meter.
+     @return Waypoints ordered by distance.
+     */
+    std::vector<WaypointPtr> Within(const GeoPoint &location, GeoDistance radius) const;
+
+ private:
+    struct Node {
+        double point[3];
+        int axis;
+        int index;
+    };
+
+    using Candidate = std::pair<double, int>;
+
+    std::vector<WaypointPtr> waypoints_;
+    std::vector<Node> nodes_;
+    std::vector<Node> pending_;
+
+    static Node MakeNode(const GeoPoint &location, int index);
+
+    static double SquaredChord(const double *point1, const double *point2);
+
+    void BuildRange(int first, int last);
+
+    void NearestRange(int first, int last, const double *point, size_t k, const Filter &filter,
+                      std::vector<Candidate> &heap) const;
+
+    void WithinRange(int first, int last, const double *point, double squared_chord,
+                     std::vector<Candidate> &result) const;
+
+    void Visit(const Node &node, const double *point, size_t k, const Filter &filter,
+               std::vector<Candidate> &heap) const;
+};
+
+}  // namespace dwr
+#endif /* waypoint_index_h */
@@ -0,0 +1,31 @@
+//
+//  waypoint_pool.cc
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/8.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include "waypoint_pool.h"
+
+namespace dwr {
+
+void *WaypointPool::Arena::Allocate(size_t bytes, size_t alignment) {
+    // Blocks come from operator new[] and are aligned for any fundamental type.
+    if (bytes > block_size_) {
+        blocks_.emplace_back(new char[bytes]);
+        allocated_bytes_ += bytes;
+        return blocks_.back().get();
+    }
+    size_t offset = (offset_ + alignment - 1) & ~(alignment - 1);
+    if (current_block_ == nullptr || offset + bytes > block_size_) {
+        blocks_.emplace_back(new char[block_size_]);
+        allocated_bytes_ += block_size_;
+        current_block_ = blocks_.back().get();
+        offset = 0;
+    }
+    offset_ = offset + bytes;
+    return current_block_ + offset;
+}
+
+}  // namespace dwr
@@ -0,0 +1,95 @@
+//
+//  waypoint_pool.h
+//  DWRFinder
+//
+//  Created by ZachQin on 2018/1/8.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#ifndef waypoint_pool_h
+#define waypoint_pool_h
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "airway_type.h"
+
+namespace dwr {
+
+/**
+ Arena for the synthetic waypoints created while searching.
+
+ Waypoints are carved out of fixed size blocks together with their shared_ptr
+ control blocks, and nothing is released until the last waypoint made by the
+ pool is destroyed. A pool is meant to live for a single query and is not
+ thread safe.
+ */
+class WaypointPool {
+ public:
+    explicit WaypointPool(size_t block_size = 16 * 1024) : arena_(std::make_shared<Arena>(block_size)) {}
+
+    /**
+     Create a waypoint inside the pool.
+
+     @param args Arguments forwarded to the Waypoint constructor.
+     @return Waypoint pointer which keeps the pool memory alive.
+     */
+    template <typename... Args>
+    WaypointPtr MakeWaypoint(Args &&... args) const {
+        return std::allocate_shared<Waypoint>(Allocator<Waypoint>(arena_), std::forward<Args>(args)...);
+    }
+
+    /**
+     Bytes of the blocks held by the pool.
+     */
+    size_t AllocatedBytes() const {return arena_->AllocatedBytes();}
+
+ private:
+    class Arena {
+     public:
+        explicit Arena(size_t block_size) : block_size_(block_size), offset_(block_size) {}
+
+        void *Allocate(size_t bytes, size_t alignment);
+
+        size_t AllocatedBytes() const {return allocated_bytes_;}
+
+     private:
+        size_t block_size_;
+        size_t offset_;
+        size_t allocated_bytes_ = 0;
+        char *current_block_ = nullptr;
+        std::vector<std::unique_ptr<char[]>> blocks_;
+    };
+
+    template <typename T>
+    struct Allocator {
+        using value_type = T;
+
+        std::shared_ptr<Arena> arena;
+
+        explicit Allocator(const std::shared_ptr<Arena> &arena) : arena(arena) {}
+
+        template <typename U>
+        Allocator(const Allocator<U> &other) : arena(other.arena) {}
+
+        T *allocate(size_t n) {
+            return static_cast<T *>(arena->Allocate(n * sizeof(T), alignof(T)));
+        }
+
+        // Memory is returned to the system when the arena itself is released.
+        void deallocate(T *, size_t) {}
+
+        template <typename U>
+        bool operator == (const Allocator<U> &other) const {return arena == other.arena;}
+
+        template <typename U>
+        bool operator != (const Allocator<U> &other) const {return arena != other.arena;}
+    };
+
+    std::shared_ptr<Arena> arena_;
+};
+
+}  // namespace dwr
+#endif /* waypoint_pool_h */
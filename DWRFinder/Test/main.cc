@@ -12,6 +12,7 @@
 
 #include "airway_graph.h"
 #include "dynamic_radar_airway_graph.h"
+#include "path_writer.h"
 #include "radar_image_process.h"
 
 #include <time.h>
@@ -61,13 +62,16 @@ void GenerateBatchTestGround(const dwr::DynamicRadarAirwayGraph &graph, int batc
     ofstream of(path, ios::binary);
     of << batch_count << endl;
     double time_consuming = 0;
+    dwr::TextPathEncoder encoder;
+    dwr::PathWriter writer(of, encoder);
     for (int i = 0; i < batch_count; i++) {
         dwr::WaypointIdentifier start = random_start[i];
         dwr::WaypointIdentifier end = random_end[i];
         Statistics stat = MeasurePath([&](){return graph.FindDynamicFullPath(start, end);});
         time_consuming += stat.time_consuming;
-        of << start << "," << end << "," << stat.path.ToString() << endl;
+        writer.Write(start, end, stat.path);
     }
+    writer.Flush();
     of << time_consuming << endl;
 }
 
@@ -142,10 +146,11 @@ void FullPath(const dwr::DynamicRadarAirwayGraph &graph) {
     dwr::WaypointIdentifier start = 8071;
     dwr::WaypointIdentifier end = 20631;
     
-    auto paths = graph.FindKDynamicFullPath(start, end, 10);
+    // 距离与总转角的帕累托前沿，由短到平滑
+    auto paths = graph.FindParetoDynamicFullPath(start, end);
     int index = 1;
     for (auto &path : paths) {
-        cout << index++ << ":" << endl;
+        cout << index++ << ": " << path.lengths.back() << "m " << path.GetSumTurn() << "rad" << endl;
         cout << path.ToString() << endl;
     }
 }
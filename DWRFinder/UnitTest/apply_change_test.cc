@@ -0,0 +1,145 @@
+//
+//  apply_change_test.cc
+//  DWRFinder UnitTest
+//
+//  Created by ZachQin on 2018/1/26.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "airway_graph.h"
+#include "test_graph.h"
+#include "unit_test.h"
+
+using namespace dwr;
+using namespace dwr::unit_test;
+
+static const double kDegToRad = 0.017453292519943295;
+
+// 航路点和邻接的完整描述，邻接按编号排序，与添加的先后无关
+static std::string Describe(const AirwayGraph &graph) {
+    auto identifiers = graph.AllWaypointIdentifiers();
+    std::sort(identifiers.begin(), identifiers.end());
+    std::ostringstream description;
+    description.precision(17);
+    for (auto identifier : identifiers) {
+        auto waypoint = graph.WaypointFromIdentifier(identifier);
+        description << identifier << " " << waypoint->name << " " << waypoint->GetLocation().longitude << " "
+                    << waypoint->GetLocation().latitude << ":";
+        std::vector<const Neighbor *> neighbors;
+        for (auto &neighbor : waypoint->neibors) {
+            neighbors.push_back(&neighbor);
+        }
+        std::sort(neighbors.begin(), neighbors.end(), [](const Neighbor *neighbor1, const Neighbor *neighbor2) {
+            return neighbor1->target.lock()->identifier < neighbor2->target.lock()->identifier;
+        });
+        // 加 0 把 -0 记为 0，反向方向由取负得到时符号不同
+        for (auto neighbor : neighbors) {
+            description << " " << neighbor->target.lock()->identifier << "(" << neighbor->distance << ","
+                        << neighbor->direction.x + 0.0 << "," << neighbor->direction.y + 0.0 << ")";
+        }
+        description << "\n";
+    }
+    return description.str();
+}
+
+static WaypointRecord Record(WaypointIdentifier identifier, const std::string &name,
+                             double longitude_degree, double latitude_degree) {
+    return {identifier, name, longitude_degree * kDegToRad, latitude_degree * kDegToRad};
+}
+
+DWR_TEST(ApplyChangeEqualsSequentialEdits) {
+    AirwayGraph applied_graph, sequential_graph;
+    BuildGrid(applied_graph, 4, 4);
+    BuildGrid(sequential_graph, 4, 4);
+    GraphChange change;
+    change.removed_segments = {{1, 2}, {11, 6}, {3, 8}};
+    change.removed_waypoints = {16, 13};
+    // 100 为新航路点，7 替换为偏移后的航路点
+    change.added_waypoints = {Record(100, "N100", 110.45, 30.05), Record(7, "R7", 110.22, 29.87)};
+    change.added_segments = {{100, 1}, {100, 7}, {7, 8}, {2, 7}, {3, 4}, {1, 2}, {12, 7}};
+    applied_graph.ApplyChange(change);
+    // 同样的修改逐项执行
+    for (auto &segment : change.removed_segments) {
+        sequential_graph.RemoveAirwaySegment(segment.first, segment.second);
+    }
+    for (auto identifier : change.removed_waypoints) {
+        sequential_graph.RemoveWaypoint(identifier);
+    }
+    for (auto &record : change.added_waypoints) {
+        if (sequential_graph.WaypointFromIdentifier(record.identifier) != nullptr) {
+            sequential_graph.RemoveWaypoint(record.identifier);
+        }
+        sequential_graph.AddWaypoint(record.identifier, record.name, record.longitude, record.latitude);
+    }
+    for (auto &segment : change.added_segments) {
+        sequential_graph.AddAirwaySegment(segment.first, segment.second);
+    }
+    EXPECT_EQ(sequential_graph.GetWaypointCount(), applied_graph.GetWaypointCount());
+    EXPECT_EQ(Describe(sequential_graph), Describe(applied_graph));
+}
+
+DWR_TEST(ApplyChangeIgnoresSegmentsOfUnknownWaypoints) {
+    AirwayGraph graph, original_graph;
+    BuildGrid(graph, 3, 3);
+    BuildGrid(original_graph, 3, 3);
+    GraphChange change;
+    change.removed_segments = {{1, 999}, {998, 999}};
+    change.removed_waypoints = {999};
+    // 9 在同一次修改中删除，连到它的航段也被忽略
+    change.removed_waypoints.push_back(9);
+    change.added_segments = {{1, 999}, {998, 2}, {9, 1}};
+    graph.ApplyChange(change);
+    original_graph.RemoveWaypoint(9);
+    EXPECT_EQ(Describe(original_graph), Describe(graph));
+}
+
+DWR_TEST(ApplyChangeReplacedWaypointDropsSegments) {
+    AirwayGraph graph;
+    BuildGrid(graph, 3, 3);
+    size_t waypoint_count = graph.GetWaypointCount();
+    WaypointIdentifier center = GridIdentifier(3, 1, 1);
+    GraphChange change;
+    change.added_waypoints = {Record(center, "C", 110.12, 29.88)};
+    graph.ApplyChange(change);
+    EXPECT_EQ(waypoint_count, graph.GetWaypointCount());
+    auto waypoint = graph.WaypointFromIdentifier(center);
+    EXPECT_TRUE(waypoint != nullptr);
+    EXPECT_EQ(std::string("C"), waypoint->name);
+    EXPECT_NEAR(110.12 * kDegToRad, waypoint->GetLocation().longitude, 1e-12);
+    EXPECT_TRUE(waypoint->neibors.empty());
+    // 其它航路点也不再连到被替换的航路点
+    graph.ForEach([&](const WaypointPtr &waypoint1, const WaypointPtr &waypoint2, GeoDistance) {
+        EXPECT_TRUE(waypoint1->identifier != center && waypoint2->identifier != center);
+    });
+}
+
+// 邻接目标的编号，已释放的目标记为 kNoWaypointIdentifier
+static std::vector<WaypointIdentifier> NeighborIdentifiers(const AirwayGraph &graph, WaypointIdentifier identifier) {
+    std::vector<WaypointIdentifier> identifiers;
+    for (auto &neighbor : graph.WaypointFromIdentifier(identifier)->neibors) {
+        auto target = neighbor.target.lock();
+        identifiers.push_back(target != nullptr ? target->identifier : kNoWaypointIdentifier);
+    }
+    std::sort(identifiers.begin(), identifiers.end());
+    return identifiers;
+}
+
+DWR_TEST(ApplyChangeDropsExpiredNeighbors) {
+    AirwayGraph graph;
+    BuildGrid(graph, 3, 3);
+    // 同ID替换不删除航段，邻居指向旧航路点的邻接失效
+    graph.AddWaypoint(5, "C", 110.1 * kDegToRad, 29.9 * kDegToRad);
+    GraphChange change;
+    change.removed_segments = {{4, 1}};
+    change.removed_waypoints = {2};
+    change.added_segments = {{4, 5}, {6, 5}};
+    graph.ApplyChange(change);
+    EXPECT_TRUE(NeighborIdentifiers(graph, 4) == (std::vector<WaypointIdentifier>{5, 7, 8}));
+    EXPECT_TRUE(NeighborIdentifiers(graph, 6) == (std::vector<WaypointIdentifier>{3, 5, 8, 9}));
+    EXPECT_TRUE(NeighborIdentifiers(graph, 5) == (std::vector<WaypointIdentifier>{4, 6}));
+}
@@ -0,0 +1,127 @@
+//
+//  flight_planner_test.cc
+//  DWRFinder UnitTest
+//
+//  Created by ZachQin on 2018/1/26.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include <random>
+#include <vector>
+
+#include "dynamic_radar_airway_graph.h"
+#include "flight_planner.h"
+#include "test_graph.h"
+#include "unit_test.h"
+
+using namespace dwr;
+using namespace dwr::unit_test;
+
+static const int kRows = 6, kColumns = 6;
+
+static GeoDistance PathLength(const WaypointPath &path) {
+    return path.lengths.empty() ? -1 : path.lengths.back();
+}
+
+// 随机选取航段，在其中点放置天气
+static std::vector<char> RandomWeather(const DynamicRadarAirwayGraph &graph, const RasterSourceInfo &info,
+                                       std::mt19937 &generator, int count) {
+    std::vector<char> raster = ClearRaster(info);
+    std::uniform_int_distribution<int> row_distribution(0, kRows - 1), column_distribution(0, kColumns - 1);
+    std::uniform_int_distribution<int> radius_distribution(3, 14);
+    for (int i = 0; i < count; i++) {
+        int row = row_distribution(generator), column = column_distribution(generator);
+        bool horizontal = (generator() & 1) != 0;
+        int next_row = horizontal ? row : row + 1, next_column = horizontal ? column + 1 : column;
+        if (next_row >= kRows || next_column >= kColumns) {
+            continue;
+        }
+        FillSegmentMiddle(raster, info, graph, GridIdentifier(kColumns, row, column),
+                          GridIdentifier(kColumns, next_row, next_column), radius_distribution(generator), 1);
+    }
+    return raster;
+}
+
+DWR_TEST(FlightPlannerRepairMatchesFullSearch) {
+    DynamicRadarAirwayGraph graph;
+    BuildGrid(graph, kRows, kColumns);
+    RasterSourceInfo info = GridRasterSource(kRows, kColumns);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    WaypointIdentifier origin = GridIdentifier(kColumns, 0, 0);
+    WaypointIdentifier destination = GridIdentifier(kColumns, kRows - 1, kColumns - 1);
+    FlightPlanner planner(graph, origin, destination);
+    planner.Plan();
+    std::mt19937 generator(7);
+    int blocked_frame_count = 0;
+    for (int frame = 0; frame < 12; frame++) {
+        std::vector<char> raster = RandomWeather(graph, info, generator, 8);
+        BlockChange change = graph.UpdateBlock(NewRasterData(raster), info.width, info.height);
+        blocked_frame_count += change.blocked_edges.empty() ? 0 : 1;
+        planner.Update(change);
+        WaypointPath repaired_path = planner.Plan();
+        // 每帧新建的规划器从头搜索
+        WaypointPath full_path = FlightPlanner(graph, origin, destination).Plan();
+        EXPECT_EQ(full_path.GetSize() > 0, repaired_path.GetSize() > 0);
+        EXPECT_NEAR(PathLength(full_path), PathLength(repaired_path), 1e-6);
+    }
+    EXPECT_TRUE(blocked_frame_count > 0);
+}
+
+DWR_TEST(FlightPlannerMoveStartMatchesFullSearch) {
+    DynamicRadarAirwayGraph graph;
+    BuildGrid(graph, kRows, kColumns);
+    RasterSourceInfo info = GridRasterSource(kRows, kColumns);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    WaypointIdentifier destination = GridIdentifier(kColumns, kRows - 1, kColumns - 1);
+    FlightPlanner planner(graph, GridIdentifier(kColumns, 0, 0), destination);
+    WaypointPath path = planner.Plan();
+    std::mt19937 generator(11);
+    for (int frame = 0; frame < 8 && path.GetSize() > 1; frame++) {
+        // 沿航路飞到下一个航路网上的航路点
+        int next = 1;
+        while (next < path.GetSize() && path.waypoints[next]->user_waypoint) {
+            next++;
+        }
+        if (next == path.GetSize() || path.waypoints[next]->identifier == destination) {
+            break;
+        }
+        WaypointIdentifier start = path.waypoints[next]->identifier;
+        planner.MoveStart(start);
+        std::vector<char> raster = RandomWeather(graph, info, generator, 6);
+        planner.Update(graph.UpdateBlock(NewRasterData(raster), info.width, info.height));
+        path = planner.Plan();
+        WaypointPath full_path = FlightPlanner(graph, start, destination).Plan();
+        EXPECT_NEAR(PathLength(full_path), PathLength(path), 1e-6);
+        EXPECT_TRUE(path.GetSize() > 0 && path.waypoints.front()->identifier == start);
+    }
+}
+
+DWR_TEST(FlightPlannerMoveStartKeepsTurnLimit) {
+    DynamicRadarAirwayGraph graph;
+    BuildGrid(graph, kRows, kColumns);
+    RasterSourceInfo info = GridRasterSource(kRows, kColumns);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    WaypointIdentifier destination = GridIdentifier(kColumns, kRows - 1, kColumns - 1);
+    FlightPlanner planner(graph, GridIdentifier(kColumns, 0, 0), destination);
+    planner.Plan();
+    // 自南向北到达(2, 3)，飞往东南需要转弯绕行
+    ConstWaypointPtr previous = graph.WaypointFromIdentifier(GridIdentifier(kColumns, 3, 3));
+    planner.MoveStart(GridIdentifier(kColumns, 2, 3), previous->identifier);
+    WaypointPath path = planner.Plan();
+    EXPECT_TRUE(path.GetSize() > 2);
+    for (int i = 0; i + 1 < path.GetSize(); i++) {
+        const Waypoint &arriving = i == 0 ? *previous : *path.waypoints[i - 1];
+        EXPECT_TRUE(Waypoint::CosinTurnAngle(arriving, *path.waypoints[i], *path.waypoints[i + 1]) > 0);
+    }
+    WaypointPath free_path = FlightPlanner(graph, GridIdentifier(kColumns, 2, 3), destination).Plan();
+    EXPECT_TRUE(PathLength(path) > PathLength(free_path));
+}
+
+DWR_TEST(FlightPlannerRejectsUnknownWaypoint) {
+    DynamicRadarAirwayGraph graph;
+    BuildGrid(graph, 2, 2);
+    graph.Build(std::vector<RasterSourceInfo>{GridRasterSource(2, 2)});
+    EXPECT_THROW(FlightPlanner(graph, 1, 100), std::invalid_argument);
+    FlightPlanner planner(graph, 1, 4);
+    EXPECT_THROW(planner.MoveStart(100), std::invalid_argument);
+}
@@ -0,0 +1,213 @@
+//
+//  forecast_test.cc
+//  DWRFinder UnitTest
+//
+//  Created by ZachQin on 2018/1/26.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include <stdexcept>
+#include <vector>
+
+#include "dynamic_radar_airway_graph.h"
+#include "test_graph.h"
+#include "unit_test.h"
+
+using namespace dwr;
+using namespace dwr::unit_test;
+
+static const int kRows = 4, kColumns = 4;
+
+// 航路的各段在雷达图中都没有阻塞
+// 航路上两个航路点之间的长度
+static GeoDistance LengthBetween(const WaypointPath &path, WaypointIdentifier identifier1, WaypointIdentifier identifier2) {
+    GeoDistance length1 = -1, length2 = -1;
+    for (int i = 0; i < path.GetSize(); i++) {
+        if (path.waypoints[i]->identifier == identifier1) {
+            length1 = path.lengths[i];
+        } else if (path.waypoints[i]->identifier == identifier2) {
+            length2 = path.lengths[i];
+        }
+    }
+    return length2 - length1;
+}
+
+static bool IsPathClear(const WaypointPath &path, const RasterSourceInfo &info, const std::vector<char> &raster) {
+    RasterGraph raster_graph(NewRasterData(raster), info.width, info.height);
+    for (int i = 0; i + 1 < path.GetSize(); i++) {
+        if (!raster_graph.CheckLine(WaypointPixel(info, *path.waypoints[i]), WaypointPixel(info, *path.waypoints[i + 1]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+DWR_TEST(AddForecastBlockRejectsInvalidFrames) {
+    DynamicRadarAirwayGraph graph;
+    BuildGrid(graph, kRows, kColumns);
+    RasterSourceInfo info = GridRasterSource(kRows, kColumns);
+    std::vector<char> raster = ClearRaster(info);
+    EXPECT_THROW(graph.AddForecastBlock(0, NewRasterData(raster), info.width, info.height), std::logic_error);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    EXPECT_THROW(graph.AddForecastBlock(0, NewRasterData(raster), info.width - 1, info.height), std::invalid_argument);
+    graph.AddForecastBlock(0, NewRasterData(raster), info.width, info.height);
+    EXPECT_THROW(graph.AddForecastBlock(0, NewRasterData(raster), info.width, info.height), std::invalid_argument);
+    graph.AddForecastBlock(600, NewRasterData(raster), info.width, info.height);
+}
+
+DWR_TEST(FindTimeDependentPathRejectsGroundSpeed) {
+    DynamicRadarAirwayGraph graph;
+    BuildGrid(graph, kRows, kColumns);
+    RasterSourceInfo info = GridRasterSource(kRows, kColumns);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    WaypointIdentifier origin = GridIdentifier(kColumns, 0, 0);
+    WaypointIdentifier destination = GridIdentifier(kColumns, kRows - 1, kColumns - 1);
+    EXPECT_THROW(graph.FindTimeDependentPath(origin, destination, 0, 0), std::invalid_argument);
+    EXPECT_THROW(graph.FindTimeDependentPath(origin, destination, 0, -200), std::invalid_argument);
+    EXPECT_TRUE(graph.FindTimeDependentPath(origin, destination, 0, 200).GetSize() > 0);
+}
+
+DWR_TEST(ForecastFramesReplaceObservedBlocks) {
+    DynamicRadarAirwayGraph graph;
+    BuildGrid(graph, kRows, kColumns);
+    RasterSourceInfo info = GridRasterSource(kRows, kColumns);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    WaypointIdentifier origin = GridIdentifier(kColumns, 0, 0);
+    WaypointIdentifier destination = GridIdentifier(kColumns, 0, kColumns - 1);
+    WaypointPath clear_path = graph.FindTimeDependentPath(origin, destination, 0, 200);
+    // 观测的天气阻断航路上的航段
+    std::vector<char> raster = ClearRaster(info);
+    FillSegmentMiddle(raster, info, graph, GridIdentifier(kColumns, 0, 1), GridIdentifier(kColumns, 0, 2), 6, 1);
+    graph.UpdateBlock(NewRasterData(raster), info.width, info.height);
+    WaypointPath observed_path = graph.FindTimeDependentPath(origin, destination, 0, 200);
+    EXPECT_TRUE(observed_path.ToString() != clear_path.ToString());
+    EXPECT_EQ(graph.FindDynamicFullPath(origin, destination).ToString(), observed_path.ToString());
+    // 加入无天气的预报帧后不再使用观测的天气
+    graph.AddForecastBlock(0, NewRasterData(ClearRaster(info)), info.width, info.height);
+    EXPECT_EQ(clear_path.ToString(), graph.FindTimeDependentPath(origin, destination, 0, 200).ToString());
+    graph.ClearForecastBlock();
+    EXPECT_EQ(observed_path.ToString(), graph.FindTimeDependentPath(origin, destination, 0, 200).ToString());
+}
+
+DWR_TEST(BuildClearsForecastFrames) {
+    DynamicRadarAirwayGraph graph;
+    BuildGrid(graph, kRows, kColumns);
+    RasterSourceInfo info = GridRasterSource(kRows, kColumns);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    WaypointIdentifier origin = GridIdentifier(kColumns, 0, 0);
+    WaypointIdentifier destination = GridIdentifier(kColumns, 0, kColumns - 1);
+    WaypointPath clear_path = graph.FindTimeDependentPath(origin, destination, 0, 200);
+    std::vector<char> raster = ClearRaster(info);
+    FillSegmentMiddle(raster, info, graph, GridIdentifier(kColumns, 0, 1), GridIdentifier(kColumns, 0, 2), 6, 1);
+    graph.AddForecastBlock(600, NewRasterData(raster), info.width, info.height);
+    EXPECT_TRUE(clear_path.ToString() != graph.FindTimeDependentPath(origin, destination, 600, 200).ToString());
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    // 重建后原来的帧不再阻断航段
+    EXPECT_EQ(clear_path.ToString(), graph.FindTimeDependentPath(origin, destination, 600, 200).ToString());
+    // 可从更早的时间重新添加
+    graph.AddForecastBlock(0, NewRasterData(ClearRaster(info)), info.width, info.height);
+    EXPECT_EQ(clear_path.ToString(), graph.FindTimeDependentPath(origin, destination, 600, 200).ToString());
+}
+
+DWR_TEST(LaterForecastFrameBlocksOnlyFlightsReachingIt) {
+    DynamicRadarAirwayGraph graph;
+    BuildGrid(graph, kRows, kColumns);
+    RasterSourceInfo info = GridRasterSource(kRows, kColumns);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    WaypointIdentifier origin = GridIdentifier(kColumns, 0, 0);
+    WaypointIdentifier edge_start = GridIdentifier(kColumns, 0, 1), edge_end = GridIdentifier(kColumns, 0, 2);
+    WaypointIdentifier destination = GridIdentifier(kColumns, 0, kColumns - 1);
+    WaypointPath clear_path = graph.FindTimeDependentPath(origin, destination, 0, 200);
+    // 只有第二帧阻断航段
+    const double blocked_time = 1000;
+    std::vector<char> raster = ClearRaster(info);
+    FillSegmentMiddle(raster, info, graph, edge_start, edge_end, 6, 1);
+    graph.AddForecastBlock(0, NewRasterData(ClearRaster(info)), info.width, info.height);
+    graph.AddForecastBlock(blocked_time, NewRasterData(raster), info.width, info.height);
+    WaypointPath blocked_path = graph.FindTimeDependentPath(origin, destination, blocked_time, 200);
+    EXPECT_TRUE(blocked_path.ToString() != clear_path.ToString());
+    // 以 200 米每秒飞到航段起点和终点的时间
+    GeoDistance enter_length = Waypoint::Distance(*graph.WaypointFromIdentifier(origin),
+                                                  *graph.WaypointFromIdentifier(edge_start));
+    GeoDistance leave_length = enter_length + Waypoint::Distance(*graph.WaypointFromIdentifier(edge_start),
+                                                                 *graph.WaypointFromIdentifier(edge_end));
+    double enter_time = enter_length / 200, leave_time = leave_length / 200;
+    // 第二帧生效前飞过该航段
+    EXPECT_EQ(clear_path.ToString(), graph.FindTimeDependentPath(origin, destination, 0, 200).ToString());
+    EXPECT_EQ(clear_path.ToString(),
+              graph.FindTimeDependentPath(origin, destination, blocked_time - leave_time - 1, 200).ToString());
+    // 飞越航段期间第二帧生效
+    double crossing_departure = blocked_time - (enter_time + leave_time) * 0.5;
+    EXPECT_TRUE(clear_path.ToString() != graph.FindTimeDependentPath(origin, destination, crossing_departure, 200).ToString());
+    // 同一时刻出发但飞得慢，第二帧生效后才到达航段
+    double slow_speed = enter_length / (blocked_time - crossing_departure + 1);
+    EXPECT_TRUE(clear_path.ToString() !=
+                graph.FindTimeDependentPath(origin, destination, crossing_departure, slow_speed).ToString());
+}
+
+DWR_TEST(ForecastDetourIsClearInLaterFrames) {
+    DynamicRadarAirwayGraph graph;
+    BuildGrid(graph, kRows, kColumns);
+    RasterSourceInfo info = GridRasterSource(kRows, kColumns);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    WaypointIdentifier origin = GridIdentifier(kColumns, 0, 0);
+    WaypointIdentifier destination = GridIdentifier(kColumns, 0, kColumns - 1);
+    std::vector<char> raster = ClearRaster(info);
+    FillSegmentMiddle(raster, info, graph, GridIdentifier(kColumns, 0, 1), GridIdentifier(kColumns, 0, 2), 6, 1);
+    graph.AddForecastBlock(0, NewRasterData(raster), info.width, info.height);
+    WaypointPath detour_path = graph.FindTimeDependentPath(origin, destination, 0, 200);
+    EXPECT_TRUE(IsPathClear(detour_path, info, raster));
+    // 飞越该航段期间天气扩大到绕行路径上
+    std::vector<char> grown_raster = ClearRaster(info);
+    FillSegmentMiddle(grown_raster, info, graph, GridIdentifier(kColumns, 0, 1), GridIdentifier(kColumns, 0, 2), 16, 1);
+    EXPECT_TRUE(!IsPathClear(detour_path, info, grown_raster));
+    graph.AddForecastBlock(60, NewRasterData(grown_raster), info.width, info.height);
+    WaypointPath path = graph.FindTimeDependentPath(origin, destination, 0, 200);
+    EXPECT_TRUE(path.GetSize() > 0);
+    EXPECT_TRUE(IsPathClear(path, info, raster));
+    EXPECT_TRUE(IsPathClear(path, info, grown_raster));
+}
+
+DWR_TEST(ForecastDetourLeaveTimeFollowsDetourLength) {
+    DynamicRadarAirwayGraph graph;
+    BuildGrid(graph, kRows, kColumns);
+    RasterSourceInfo info = GridRasterSource(kRows, kColumns);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    WaypointIdentifier origin = GridIdentifier(kColumns, 0, 0);
+    WaypointIdentifier destination = GridIdentifier(kColumns, 0, kColumns - 1);
+    WaypointIdentifier detour_start = GridIdentifier(kColumns, 0, 1), detour_end = GridIdentifier(kColumns, 0, 2);
+    std::vector<char> raster = ClearRaster(info);
+    FillSegmentMiddle(raster, info, graph, detour_start, detour_end, 6, 1);
+    graph.AddForecastBlock(0, NewRasterData(raster), info.width, info.height);
+    const double ground_speed = 1;
+    WaypointPath detour_path = graph.FindTimeDependentPath(origin, destination, 0, ground_speed);
+    GeoDistance enter_length = LengthBetween(detour_path, origin, detour_start);
+    GeoDistance edge_length = Waypoint::Distance(*graph.WaypointFromIdentifier(detour_start),
+                                                 *graph.WaypointFromIdentifier(detour_end));
+    GeoDistance detour_length = LengthBetween(detour_path, detour_start, detour_end);
+    EXPECT_TRUE(enter_length > 0 && detour_length > edge_length + 2);
+    // 扩大的天气在飞完原航段之后、飞完绕行之前生效
+    std::vector<char> grown_raster = ClearRaster(info);
+    FillSegmentMiddle(grown_raster, info, graph, detour_start, detour_end, 16, 1);
+    double grown_time = (enter_length + (edge_length + detour_length) * 0.5) / ground_speed;
+    graph.AddForecastBlock(grown_time, NewRasterData(grown_raster), info.width, info.height);
+    WaypointPath path = graph.FindTimeDependentPath(origin, destination, 0, ground_speed);
+    EXPECT_TRUE(path.GetSize() > 0);
+    EXPECT_TRUE(path.ToString() != detour_path.ToString());
+}
+
+DWR_TEST(ForecastFrameAppliesFromValidTime) {
+    DynamicRadarAirwayGraph graph;
+    BuildGrid(graph, kRows, kColumns);
+    RasterSourceInfo info = GridRasterSource(kRows, kColumns);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    WaypointIdentifier origin = GridIdentifier(kColumns, 0, 0);
+    WaypointIdentifier destination = GridIdentifier(kColumns, 0, kColumns - 1);
+    WaypointPath clear_path = graph.FindTimeDependentPath(origin, destination, 0, 200);
+    std::vector<char> raster = ClearRaster(info);
+    FillSegmentMiddle(raster, info, graph, GridIdentifier(kColumns, 0, 1), GridIdentifier(kColumns, 0, 2), 6, 1);
+    graph.AddForecastBlock(1000, NewRasterData(raster), info.width, info.height);
+    // 第一帧生效之前飞完全程，不受预报的天气影响
+    EXPECT_EQ(clear_path.ToString(), graph.FindTimeDependentPath(origin, destination, 0, 200).ToString());
+    EXPECT_TRUE(clear_path.ToString() != graph.FindTimeDependentPath(origin, destination, 1000, 200).ToString());
+}
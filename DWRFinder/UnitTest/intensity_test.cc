@@ -0,0 +1,96 @@
+//
+//  intensity_test.cc
+//  DWRFinder UnitTest
+//
+//  Created by ZachQin on 2018/1/26.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "dynamic_radar_airway_graph.h"
+#include "test_graph.h"
+#include "unit_test.h"
+
+using namespace dwr;
+using namespace dwr::unit_test;
+
+DWR_TEST(IntensityPenaltyOfDirectEdgeEqualsOneLegDetour) {
+    DynamicRadarAirwayGraph graph;
+    BuildGrid(graph, 3, 3);
+    RasterSourceInfo info = GridRasterSource(3, 3);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    std::vector<char> raster = ClearRaster(info);
+    // 各航段上的强度不同
+    FillSegmentMiddle(raster, info, graph, GridIdentifier(3, 0, 0), GridIdentifier(3, 0, 1), 8, 2);
+    FillSegmentMiddle(raster, info, graph, GridIdentifier(3, 1, 1), GridIdentifier(3, 2, 1), 12, 3);
+    FillSegmentMiddle(raster, info, graph, GridIdentifier(3, 1, 2), GridIdentifier(3, 2, 2), 6, 1);
+    graph.UpdateIntensity(NewRasterData(raster), info.width, info.height, 5, 0.5);
+    int penalized_count = 0;
+    graph.ForEach([&](const WaypointPtr &waypoint1, const WaypointPtr &waypoint2, GeoDistance) {
+        WaypointPair waypoint_pair(waypoint1, waypoint2);
+        GeoDistance direct_penalty = graph.IntensityPenalty(waypoint_pair, {});
+        // 插入点位于终点，唯一的一段与航段经过相同的像素
+        auto inserted_waypoint = std::make_shared<Waypoint>(*waypoint2);
+        GeoDistance detour_penalty = graph.IntensityPenalty(waypoint_pair, {inserted_waypoint});
+        EXPECT_NEAR(detour_penalty, direct_penalty, 1e-6 * detour_penalty);
+        penalized_count += direct_penalty > 0 ? 1 : 0;
+    });
+    // 至少三条航段的两个方向
+    EXPECT_TRUE(penalized_count >= 6);
+}
+
+DWR_TEST(IntensityPenaltyGrowsWithLevel) {
+    DynamicRadarAirwayGraph graph;
+    BuildGrid(graph, 1, 2);
+    RasterSourceInfo info = GridRasterSource(1, 2);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    WaypointPair waypoint_pair(graph.WaypointFromIdentifier(1), graph.WaypointFromIdentifier(2));
+    EXPECT_EQ(0.0, graph.IntensityPenalty(waypoint_pair, {}));
+    std::vector<char> raster = ClearRaster(info);
+    FillSegmentMiddle(raster, info, graph, 1, 2, 4, 1);
+    graph.UpdateIntensity(NewRasterData(raster), info.width, info.height, 5, 1.0);
+    GeoDistance level1_penalty = graph.IntensityPenalty(waypoint_pair, {});
+    FillSegmentMiddle(raster, info, graph, 1, 2, 4, 2);
+    graph.UpdateIntensity(NewRasterData(raster), info.width, info.height, 5, 1.0);
+    GeoDistance level2_penalty = graph.IntensityPenalty(waypoint_pair, {});
+    EXPECT_TRUE(level1_penalty > 0);
+    EXPECT_NEAR(2 * level1_penalty, level2_penalty, 1e-6 * level2_penalty);
+}
+
+DWR_TEST(UpdateIntensityRejectsBlockLevelOutOfRange) {
+    DynamicRadarAirwayGraph graph;
+    BuildGrid(graph, 2, 2);
+    RasterSourceInfo info = GridRasterSource(2, 2);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    std::vector<char> raster = ClearRaster(info);
+    EXPECT_THROW(graph.UpdateIntensity(NewRasterData(raster), info.width, info.height, 0, 1.0), std::invalid_argument);
+    EXPECT_THROW(graph.UpdateIntensity(NewRasterData(raster), info.width, info.height, 256, 1.0), std::invalid_argument);
+    graph.UpdateIntensity(NewRasterData(raster), info.width, info.height, 255, 1.0);
+}
+
+DWR_TEST(UpdateBlockTreatsNegativeMaskValuesAsClear) {
+    DynamicRadarAirwayGraph graph;
+    BuildGrid(graph, 1, 2);
+    RasterSourceInfo info = GridRasterSource(1, 2);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    std::vector<char> raster = ClearRaster(info);
+    FillSegmentMiddle(raster, info, graph, 1, 2, 4, static_cast<char>(200));
+    EXPECT_EQ(0u, graph.UpdateBlock(NewRasterData(raster), info.width, info.height).blocked_edges.size());
+    FillSegmentMiddle(raster, info, graph, 1, 2, 4, 1);
+    EXPECT_EQ(1u, graph.UpdateBlock(NewRasterData(raster), info.width, info.height).blocked_edges.size());
+}
+
+DWR_TEST(UpdateIntensityBlocksFromBlockLevel) {
+    DynamicRadarAirwayGraph graph;
+    BuildGrid(graph, 1, 2);
+    RasterSourceInfo info = GridRasterSource(1, 2);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    std::vector<char> raster = ClearRaster(info);
+    FillSegmentMiddle(raster, info, graph, 1, 2, 4, static_cast<char>(199));
+    EXPECT_EQ(0u, graph.UpdateIntensity(NewRasterData(raster), info.width, info.height, 200, 0.0).blocked_edges.size());
+    FillSegmentMiddle(raster, info, graph, 1, 2, 4, static_cast<char>(200));
+    EXPECT_EQ(1u, graph.UpdateIntensity(NewRasterData(raster), info.width, info.height, 200, 0.0).blocked_edges.size());
+}
@@ -0,0 +1,43 @@
+//
+//  location_path_test.cc
+//  DWRFinder UnitTest
+//
+//  Created by ZachQin on 2018/1/26.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include <vector>
+
+#include "dynamic_radar_airway_graph.h"
+#include "test_graph.h"
+#include "unit_test.h"
+
+using namespace dwr;
+using namespace dwr::unit_test;
+
+static const double kDegToRad = 0.017453292519943295;
+static const int kRows = 4, kColumns = 6;
+
+static GeoPoint Location(double longitude_degree, double latitude_degree) {
+    return {longitude_degree * kDegToRad, latitude_degree * kDegToRad};
+}
+
+DWR_TEST(LocationPathKeepsDestinationTurnAcute) {
+    DynamicRadarAirwayGraph graph;
+    BuildGrid(graph, kRows, kColumns);
+    RasterSourceInfo info = GridRasterSource(kRows, kColumns);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    // 终点在 G0_5 的西北侧，经第一行到达 G0_5 后需折返
+    GeoPoint destination = Location(110.47, 30.02);
+    WaypointPath path = graph.FindDynamicFullPath(Location(109.98, 30.01), destination);
+    EXPECT_TRUE(path.GetSize() >= 3);
+    if (path.GetSize() < 3) {
+        return;
+    }
+    EXPECT_NEAR(destination.longitude, path.waypoints.back()->GetLocation().longitude, 1e-12);
+    EXPECT_NEAR(destination.latitude, path.waypoints.back()->GetLocation().latitude, 1e-12);
+    EXPECT_TRUE(path.waypoints[path.GetSize() - 2]->identifier != GridIdentifier(kColumns, 0, kColumns - 1));
+    for (int i = 1; i + 1 < path.GetSize(); i++) {
+        EXPECT_TRUE(Waypoint::CosinTurnAngle(*path.waypoints[i - 1], *path.waypoints[i], *path.waypoints[i + 1]) > 0);
+    }
+}
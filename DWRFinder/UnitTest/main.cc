@@ -0,0 +1,59 @@
+//
+//  main.cc
+//  DWRFinder UnitTest
+//
+//  Created by ZachQin on 2018/1/26.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+//  Usage: DWRUnitTest [FILTER]
+//  Runs the tests whose name contains FILTER, all by default. The exit status is 1 when any
+//  expectation fails.
+//
+
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "unit_test.h"
+
+namespace dwr {
+namespace unit_test {
+
+static int failure_count = 0;
+
+std::vector<TestCase> &Registry() {
+    static std::vector<TestCase> registry;
+    return registry;
+}
+
+void Fail(const char *file, int line, const std::string &message) {
+    failure_count++;
+    printf("%s:%d: %s\n", file, line, message.c_str());
+}
+
+}  // namespace unit_test
+}  // namespace dwr
+
+int main(int argc, const char *argv[]) {
+    using namespace dwr::unit_test;
+    std::string filter = argc > 1 ? argv[1] : "";
+    int run_count = 0, failed_count = 0;
+    for (auto &test_case : Registry()) {
+        if (test_case.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        run_count++;
+        int previous_failure_count = failure_count;
+        try {
+            test_case.function();
+        } catch (const std::exception &e) {
+            Fail(test_case.name.c_str(), 0, std::string("unexpected exception: ") + e.what());
+        }
+        bool passed = failure_count == previous_failure_count;
+        failed_count += passed ? 0 : 1;
+        printf("[%s] %s\n", passed ? "  OK  " : "FAILED", test_case.name.c_str());
+    }
+    printf("%d of %d tests passed\n", run_count - failed_count, run_count);
+    return failed_count > 0 ? 1 : 0;
+}
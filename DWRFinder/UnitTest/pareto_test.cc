@@ -0,0 +1,100 @@
+//
+//  pareto_test.cc
+//  DWRFinder UnitTest
+//
+//  Created by ZachQin on 2018/1/26.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include <stdexcept>
+#include <vector>
+
+#include "dynamic_radar_airway_graph.h"
+#include "test_graph.h"
+#include "unit_test.h"
+
+using namespace dwr;
+using namespace dwr::unit_test;
+
+static const int kRows = 5, kColumns = 7;
+static const double kTolerance = 1e-9;
+
+static GeoDistance PathLength(const WaypointPath &path) {
+    return path.lengths.empty() ? -1 : path.lengths.back();
+}
+
+// 航路网中部的天气阻断两条航段
+static void BuildWeatherGraph(DynamicRadarAirwayGraph &graph) {
+    BuildGrid(graph, kRows, kColumns);
+    RasterSourceInfo info = GridRasterSource(kRows, kColumns);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    std::vector<char> raster = ClearRaster(info);
+    FillSegmentMiddle(raster, info, graph, GridIdentifier(kColumns, 1, 2), GridIdentifier(kColumns, 2, 3), 10, 1);
+    FillSegmentMiddle(raster, info, graph, GridIdentifier(kColumns, 2, 4), GridIdentifier(kColumns, 3, 4), 6, 1);
+    graph.UpdateBlock(NewRasterData(raster), info.width, info.height);
+}
+
+DWR_TEST(ParetoFrontIsMutuallyNondominated) {
+    DynamicRadarAirwayGraph graph;
+    BuildWeatherGraph(graph);
+    WaypointIdentifier origin = GridIdentifier(kColumns, 0, 0);
+    WaypointIdentifier destination = GridIdentifier(kColumns, 3, kColumns - 1);
+    std::vector<WaypointPath> front = graph.FindParetoDynamicFullPath(origin, destination);
+    EXPECT_TRUE(front.size() >= 2);
+    for (size_t i = 0; i < front.size(); i++) {
+        EXPECT_TRUE(front[i].GetSize() > 0);
+        // 按距离升序，转角随之下降
+        if (i + 1 < front.size()) {
+            EXPECT_TRUE(PathLength(front[i]) <= PathLength(front[i + 1]) + kTolerance);
+        }
+        for (size_t j = 0; j < front.size(); j++) {
+            if (i == j) {
+                continue;
+            }
+            bool dominated = PathLength(front[j]) <= PathLength(front[i]) + kTolerance &&
+                             front[j].GetSumTurn() <= front[i].GetSumTurn() + kTolerance;
+            EXPECT_TRUE(!dominated);
+        }
+    }
+}
+
+DWR_TEST(ParetoShortestRouteMatchesEdgeSearch) {
+    DynamicRadarAirwayGraph graph;
+    BuildWeatherGraph(graph);
+    graph.SetTurnSearch(TurnSearch::kEdge);
+    WaypointIdentifier origin = GridIdentifier(kColumns, 0, 0);
+    WaypointIdentifier destination = GridIdentifier(kColumns, 3, kColumns - 1);
+    std::vector<WaypointPath> front = graph.FindParetoDynamicFullPath(origin, destination);
+    WaypointPath shortest_path = graph.FindDynamicFullPath(origin, destination);
+    EXPECT_TRUE(!front.empty());
+    EXPECT_TRUE(shortest_path.GetSize() > 0);
+    if (!front.empty()) {
+        EXPECT_NEAR(PathLength(shortest_path), PathLength(front.front()), 1e-6);
+    }
+}
+
+DWR_TEST(ParetoEpsilonBoundsFront) {
+    DynamicRadarAirwayGraph graph;
+    BuildWeatherGraph(graph);
+    WaypointIdentifier origin = GridIdentifier(kColumns, 0, 0);
+    WaypointIdentifier destination = GridIdentifier(kColumns, 3, kColumns - 1);
+    std::vector<WaypointPath> front = graph.FindParetoDynamicFullPath(origin, destination);
+    size_t previous_size = front.size();
+    for (double turn_epsilon : {0.1, 0.5, 2.0}) {
+        std::vector<WaypointPath> epsilon_front = graph.FindParetoDynamicFullPath(origin, destination, turn_epsilon);
+        EXPECT_TRUE(!epsilon_front.empty() && epsilon_front.size() <= previous_size);
+        // 完整前沿的每条航路都有不长且转角至多多 turn_epsilon 的航路
+        for (auto &path : front) {
+            bool covered = false;
+            for (auto &epsilon_path : epsilon_front) {
+                covered = covered || (PathLength(epsilon_path) <= PathLength(path) + kTolerance &&
+                                      epsilon_path.GetSumTurn() <= path.GetSumTurn() + turn_epsilon + kTolerance);
+            }
+            EXPECT_TRUE(covered);
+        }
+        previous_size = epsilon_front.size();
+    }
+    // turn_epsilon 超过前沿的转角范围时只剩最短的航路
+    EXPECT_EQ(1u, previous_size);
+    EXPECT_THROW(graph.FindParetoDynamicFullPath(origin, destination, -0.1), std::invalid_argument);
+}
@@ -0,0 +1,64 @@
+//
+//  path_reader_test.cc
+//  DWRFinder UnitTest
+//
+//  Created by ZachQin on 2018/1/26.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include <stdint.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "airway_graph.h"
+#include "path_writer.h"
+#include "test_graph.h"
+#include "unit_test.h"
+
+using namespace dwr;
+using namespace dwr::unit_test;
+
+DWR_TEST(BinaryPathReaderReadsEncodedRecord) {
+    AirwayGraph graph;
+    BuildGrid(graph, 3, 3);
+    WaypointPath path = graph.FindPath(1, 9, [](const WaypointPair &, const WaypointInfoPair &,
+                                                std::vector<WaypointPtr> &) {return true;});
+    EXPECT_TRUE(path.GetSize() > 1);
+    std::string buffer;
+    BinaryPathEncoder().Encode(1, 9, path, buffer);
+    BinaryPathEncoder().Encode(2, 3, WaypointPath(), buffer);
+    std::istringstream stream(buffer);
+    BinaryPathReader reader(stream);
+    PathRecord record;
+    EXPECT_TRUE(reader.Read(record));
+    EXPECT_EQ(1, record.origin_identifier);
+    EXPECT_EQ(9, record.destination_identifier);
+    EXPECT_EQ(static_cast<size_t>(path.GetSize()), record.identifiers.size());
+    for (size_t i = 0; i < path.waypoints.size() && i < record.identifiers.size(); i++) {
+        EXPECT_EQ(path.waypoints[i]->identifier, record.identifiers[i]);
+        EXPECT_NEAR(path.lengths[i], record.lengths[i], 0);
+    }
+    EXPECT_TRUE(reader.Read(record));
+    EXPECT_TRUE(record.identifiers.empty());
+    EXPECT_TRUE(!reader.Read(record));
+}
+
+DWR_TEST(BinaryPathReaderRejectsCorruptCount) {
+    // 记录声称有约 40 亿个航路点，实际只有一个
+    std::string buffer;
+    int32_t origin_identifier = 1, destination_identifier = 2, identifier = 3;
+    uint32_t waypoint_count = 0xFFFFFFF0u;
+    double length = 0;
+    buffer.append(reinterpret_cast<const char *>(&origin_identifier), sizeof(origin_identifier));
+    buffer.append(reinterpret_cast<const char *>(&destination_identifier), sizeof(destination_identifier));
+    buffer.append(reinterpret_cast<const char *>(&waypoint_count), sizeof(waypoint_count));
+    buffer.append(reinterpret_cast<const char *>(&identifier), sizeof(identifier));
+    buffer.append(reinterpret_cast<const char *>(&length), sizeof(length));
+    std::istringstream stream(buffer);
+    BinaryPathReader reader(stream);
+    PathRecord record;
+    EXPECT_TRUE(!reader.Read(record));
+    EXPECT_TRUE(record.identifiers.capacity() < 1u << 20);
+}
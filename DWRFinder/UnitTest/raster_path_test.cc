@@ -0,0 +1,69 @@
+//
+//  raster_path_test.cc
+//  DWRFinder UnitTest
+//
+//  Created by ZachQin on 2018/1/26.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include <algorithm>
+#include <vector>
+
+#include "raster_graph.h"
+#include "unit_test.h"
+
+using namespace dwr;
+
+DWR_TEST(FindPathKeepsSharedPixelOnEachLevel) {
+    Pixel origin(0, 0), destination(12, 0);
+    // 相邻梯级共用一个像素，第一个梯级还含有起点
+    std::vector<Line> node_levels = {{origin, Pixel(4, 0)}, {Pixel(4, 0), Pixel(8, 3)}, {Pixel(8, 0)}};
+    PixelPath path = RasterGraph::FindPath(origin, destination, node_levels);
+    EXPECT_EQ(node_levels.size() + 2, path.size());
+    if (path.size() != node_levels.size() + 2) {
+        return;
+    }
+    // 每个梯级恰取一个像素
+    EXPECT_TRUE(path.front() == origin && path.back() == destination);
+    for (size_t i = 0; i < node_levels.size(); i++) {
+        EXPECT_TRUE(std::find(node_levels[i].begin(), node_levels[i].end(), path[i + 1]) != node_levels[i].end());
+    }
+}
+
+DWR_TEST(CoarseToFineDetourIsClearAndAcute) {
+    // 直线长于直接搜索的梯级长度，先在粗网格上搜索
+    RasterGraph raster_graph(600, 600);
+    for (int y = 260; y < 340; y++) {
+        for (int x = 260; x < 340; x++) {
+            raster_graph.SetPixelValue(Pixel(x, y), 1);
+        }
+    }
+    Pixel origin(60, 300), destination(540, 300);
+    EXPECT_TRUE(!raster_graph.CheckLine(origin, destination));
+    PixelPath path = raster_graph.FindPathWithAngle(origin, destination);
+    EXPECT_TRUE(path.size() > 2);
+    if (path.size() > 2) {
+        EXPECT_TRUE(path.front() == origin && path.back() == destination);
+    }
+    for (size_t i = 0; i + 1 < path.size(); i++) {
+        if (path[i] == path[i + 1]) {
+            continue;
+        }
+        EXPECT_TRUE(raster_graph.CheckLine(path[i], path[i + 1]));
+        if (i > 0 && !(path[i - 1] == path[i])) {
+            EXPECT_TRUE(Pixel::IsAcuteTurn(path[i - 1], path[i], path[i + 1]));
+        }
+    }
+}
+
+DWR_TEST(ShortBlockedSectionUsesOneLadder) {
+    RasterGraph raster_graph(100, 100);
+    raster_graph.SetPixelValue(Pixel(50, 50), 1);
+    raster_graph.SetPixelValue(Pixel(51, 50), 1);
+    // 阻塞段只有两个像素，两个梯级重合
+    PixelPath path = raster_graph.FindPathWithAngle(Pixel(20, 50), Pixel(80, 50));
+    EXPECT_EQ(3u, path.size());
+    for (size_t i = 0; i + 1 < path.size(); i++) {
+        EXPECT_TRUE(raster_graph.CheckLine(path[i], path[i + 1]));
+    }
+}
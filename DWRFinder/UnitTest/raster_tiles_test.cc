@@ -0,0 +1,75 @@
+//
+//  raster_tiles_test.cc
+//  DWRFinder UnitTest
+//
+//  Created by ZachQin on 2018/1/26.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include <algorithm>
+#include <vector>
+
+#include "raster_graph.h"
+#include "unit_test.h"
+
+using namespace dwr;
+
+// 200 x 150 的雷达图，占 4 x 3 个瓦片，其中两个有天气
+static const int kWidth = 200, kHeight = 150, kTileColumns = 4;
+
+static char *NewWeatherData() {
+    char *raster_data = new char[kWidth * kHeight]();
+    for (int y = 70; y < 90; y++) {
+        for (int x = 100; x < 140; x++) {
+            raster_data[y * kWidth + x] = 3;
+        }
+    }
+    return raster_data;
+}
+
+static int TileIndex(int x, int y) {
+    return (y / RasterGraph::kTileSize) * kTileColumns + x / RasterGraph::kTileSize;
+}
+
+DWR_TEST(ChangedTilesOfSameRasterIsEmpty) {
+    RasterGraph raster_graph(NewWeatherData(), kWidth, kHeight);
+    RasterGraph same_raster_graph(NewWeatherData(), kWidth, kHeight);
+    EXPECT_TRUE(raster_graph.ChangedTiles(same_raster_graph).empty());
+    // 逐像素写入的同样内容也不算变化
+    RasterGraph pixel_raster_graph(kWidth, kHeight);
+    for (int y = 70; y < 90; y++) {
+        for (int x = 100; x < 140; x++) {
+            pixel_raster_graph.SetPixelValue(Pixel(x, y), 3);
+        }
+    }
+    EXPECT_TRUE(raster_graph.ChangedTiles(pixel_raster_graph).empty());
+    EXPECT_TRUE(pixel_raster_graph.ChangedTiles(raster_graph).empty());
+}
+
+DWR_TEST(ChangedTilesReportsTileOfChangedPixel) {
+    RasterGraph raster_graph(NewWeatherData(), kWidth, kHeight);
+    RasterGraph changed_raster_graph(NewWeatherData(), kWidth, kHeight);
+    changed_raster_graph.SetPixelValue(Pixel(130, 80), 0);
+    std::vector<int> tile_indices = raster_graph.ChangedTiles(changed_raster_graph);
+    EXPECT_EQ(1u, tile_indices.size());
+    EXPECT_TRUE(tile_indices == std::vector<int>{TileIndex(130, 80)});
+}
+
+DWR_TEST(ChangedTilesReportsClearTileTurningBlocked) {
+    RasterGraph raster_graph(NewWeatherData(), kWidth, kHeight);
+    RasterGraph changed_raster_graph(NewWeatherData(), kWidth, kHeight);
+    // 图像右下角不完整的瓦片
+    changed_raster_graph.SetPixelValue(Pixel(kWidth - 1, kHeight - 1), 1);
+    changed_raster_graph.SetPixelValue(Pixel(10, 10), 1);
+    std::vector<int> tile_indices = raster_graph.ChangedTiles(changed_raster_graph);
+    std::sort(tile_indices.begin(), tile_indices.end());
+    EXPECT_TRUE(tile_indices == (std::vector<int>{TileIndex(10, 10), TileIndex(kWidth - 1, kHeight - 1)}));
+    // 反向比较结果相同
+    std::vector<int> reverse_tile_indices = changed_raster_graph.ChangedTiles(raster_graph);
+    std::sort(reverse_tile_indices.begin(), reverse_tile_indices.end());
+    EXPECT_TRUE(reverse_tile_indices == tile_indices);
+    RasterGraph clear_raster_graph(kWidth, kHeight);
+    tile_indices = clear_raster_graph.ChangedTiles(raster_graph);
+    std::sort(tile_indices.begin(), tile_indices.end());
+    EXPECT_TRUE(tile_indices == (std::vector<int>{TileIndex(100, 70), TileIndex(130, 70)}));
+}
@@ -0,0 +1,86 @@
+//
+//  route_cache_test.cc
+//  DWRFinder UnitTest
+//
+//  Created by ZachQin on 2018/1/26.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include <vector>
+
+#include "dynamic_radar_airway_graph.h"
+#include "test_graph.h"
+#include "unit_test.h"
+
+using namespace dwr;
+using namespace dwr::unit_test;
+
+static const int kRows = 6, kColumns = 6;
+
+// 沿第一行飞行的航路
+static const WaypointIdentifier kOrigin = GridIdentifier(kColumns, 0, 0);
+static const WaypointIdentifier kDestination = GridIdentifier(kColumns, 0, kColumns - 1);
+
+static void BuildClearGraph(DynamicRadarAirwayGraph &graph, RasterSourceInfo &info) {
+    BuildGrid(graph, kRows, kColumns);
+    info = GridRasterSource(kRows, kColumns);
+    graph.Build(std::vector<RasterSourceInfo>{info});
+    // 第一帧改变雷达图尺寸，会清空缓存
+    graph.UpdateBlock(NewRasterData(ClearRaster(info)), info.width, info.height);
+}
+
+DWR_TEST(RouteCacheAnswersRepeatedQuery) {
+    DynamicRadarAirwayGraph graph;
+    RasterSourceInfo info;
+    BuildClearGraph(graph, info);
+    SearchStats first_stats;
+    WaypointPath path = graph.FindCachedDynamicFullPath(kOrigin, kDestination, &first_stats);
+    EXPECT_TRUE(path.GetSize() > 0);
+    EXPECT_TRUE(first_stats.nodes_settled > 0);
+    EXPECT_EQ(1u, graph.GetRouteCacheSize());
+    SearchStats second_stats;
+    WaypointPath cached_path = graph.FindCachedDynamicFullPath(kOrigin, kDestination, &second_stats);
+    EXPECT_EQ(path.ToString(), cached_path.ToString());
+    EXPECT_EQ(0u, second_stats.nodes_settled);
+    EXPECT_EQ(1u, graph.GetRouteCacheSize());
+}
+
+DWR_TEST(RouteCacheKeepsRouteAwayFromChange) {
+    DynamicRadarAirwayGraph graph;
+    RasterSourceInfo info;
+    BuildClearGraph(graph, info);
+    WaypointPath path = graph.FindCachedDynamicFullPath(kOrigin, kDestination);
+    // 最后一行的天气离航路几个瓦片远
+    std::vector<char> raster = ClearRaster(info);
+    FillSegmentMiddle(raster, info, graph, GridIdentifier(kColumns, kRows - 1, 1),
+                      GridIdentifier(kColumns, kRows - 1, 2), 6, 1);
+    BlockChange change = graph.UpdateBlock(NewRasterData(raster), info.width, info.height);
+    EXPECT_TRUE(!change.blocked_edges.empty());
+    EXPECT_EQ(1u, graph.GetRouteCacheSize());
+    SearchStats stats;
+    WaypointPath cached_path = graph.FindCachedDynamicFullPath(kOrigin, kDestination, &stats);
+    EXPECT_EQ(path.ToString(), cached_path.ToString());
+    EXPECT_EQ(0u, stats.nodes_settled);
+}
+
+DWR_TEST(RouteCacheDropsRouteOverBlockedEdge) {
+    DynamicRadarAirwayGraph graph;
+    RasterSourceInfo info;
+    BuildClearGraph(graph, info);
+    WaypointPath path = graph.FindCachedDynamicFullPath(kOrigin, kDestination);
+    std::vector<char> raster = ClearRaster(info);
+    FillSegmentMiddle(raster, info, graph, GridIdentifier(kColumns, 0, 2), GridIdentifier(kColumns, 0, 3), 6, 1);
+    graph.UpdateBlock(NewRasterData(raster), info.width, info.height);
+    EXPECT_EQ(0u, graph.GetRouteCacheSize());
+    // 重新搜索的航路避开天气，与不用缓存的搜索一致
+    WaypointPath rerouted_path = graph.FindCachedDynamicFullPath(kOrigin, kDestination);
+    WaypointPath full_path = graph.FindDynamicFullPath(kOrigin, kDestination);
+    EXPECT_TRUE(rerouted_path.GetSize() > 0);
+    EXPECT_TRUE(rerouted_path.ToString() != path.ToString());
+    EXPECT_EQ(full_path.ToString(), rerouted_path.ToString());
+    EXPECT_EQ(1u, graph.GetRouteCacheSize());
+    // 天气消散后缓存的绕飞航路同样失效
+    graph.UpdateBlock(NewRasterData(ClearRaster(info)), info.width, info.height);
+    EXPECT_EQ(0u, graph.GetRouteCacheSize());
+    EXPECT_EQ(path.ToString(), graph.FindCachedDynamicFullPath(kOrigin, kDestination).ToString());
+}
@@ -0,0 +1,119 @@
+//
+//  scanline_polygon_test.cc
+//  DWRFinder UnitTest
+//
+//  Created by ZachQin on 2018/1/26.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "graphics_utils.h"
+#include "unit_test.h"
+
+using namespace dwr;
+
+using PixelSet = std::set<std::pair<int, int>>;
+
+// 各区间覆盖的像素 (x, y)，去掉重叠
+static PixelSet Cover(const std::vector<PixelSpan> &spans) {
+    PixelSet pixels;
+    for (auto &span : spans) {
+        for (int x = span.begin_x; x < span.end_x; x++) {
+            pixels.insert({x, span.y});
+        }
+    }
+    return pixels;
+}
+
+static void InsertRectangle(PixelSet &pixels, int left, int top, int right, int bottom) {
+    for (int y = top; y <= bottom; y++) {
+        for (int x = left; x <= right; x++) {
+            pixels.insert({x, y});
+        }
+    }
+}
+
+DWR_TEST(ScanlineRectangleCoversExactPixels) {
+    std::vector<PixelSpan> spans;
+    ScanlinePolygon({2, 6, 6, 2}, {1, 1, 4, 4}, spans);
+    // 中心在矩形内的像素，加上右边和下边的轮廓
+    PixelSet expected;
+    InsertRectangle(expected, 2, 1, 6, 4);
+    EXPECT_TRUE(expected == Cover(spans));
+}
+
+DWR_TEST(ScanlineConcavePolygonLeavesNotchClear) {
+    std::vector<PixelSpan> spans;
+    ScanlinePolygon({0, 6, 6, 2, 2, 0}, {0, 0, 2, 2, 6, 6}, spans);
+    PixelSet expected;
+    InsertRectangle(expected, 0, 0, 6, 2);
+    InsertRectangle(expected, 0, 0, 2, 6);
+    EXPECT_TRUE(expected == Cover(spans));
+}
+
+DWR_TEST(ScanlineTriangleCoversPixelCenters) {
+    std::vector<double> x = {3.3, 20.8, 9.6}, y = {2.7, 8.1, 17.4};
+    std::vector<PixelSpan> spans;
+    ScanlinePolygon(x, y, spans);
+    PixelSet pixels = Cover(spans);
+    int inside_count = 0;
+    auto side = [&](int i, double px, double py) {
+        int j = (i + 1) % 3;
+        return (x[j] - x[i]) * (py - y[i]) - (y[j] - y[i]) * (px - x[i]);
+    };
+    for (int row = 0; row < 20; row++) {
+        for (int column = 0; column < 24; column++) {
+            double center_x = column + 0.5, center_y = row + 0.5;
+            bool inside = side(0, center_x, center_y) > 0 && side(1, center_x, center_y) > 0 &&
+                          side(2, center_x, center_y) > 0;
+            if (inside) {
+                inside_count++;
+                EXPECT_TRUE(pixels.count({column, row}) == 1);
+            }
+        }
+    }
+    EXPECT_TRUE(inside_count > 50);
+    // 不超出顶点所在像素的外接矩形
+    for (auto &pixel : pixels) {
+        EXPECT_TRUE(pixel.first >= 3 && pixel.first <= 20 && pixel.second >= 2 && pixel.second <= 17);
+    }
+}
+
+DWR_TEST(ScanlineThinPolygonKeepsOutline) {
+    std::vector<PixelSpan> spans;
+    // 不含任何像素中心的细长多边形
+    ScanlinePolygon({10.2, 30.7, 30.7}, {5.2, 5.3, 5.35}, spans);
+    PixelSet pixels = Cover(spans);
+    for (int x = 10; x <= 30; x++) {
+        EXPECT_TRUE(pixels.count({x, 5}) == 1);
+    }
+    EXPECT_EQ(21u, pixels.size());
+}
+
+DWR_TEST(ScanlineNegativeOutlineRoundsDown) {
+    std::vector<PixelSpan> spans;
+    // 与上例相同的细长多边形平移到负坐标，像素 -1 覆盖 [-1, 0)
+    ScanlinePolygon({-29.8, -9.3, -9.3}, {-4.8, -4.7, -4.65}, spans);
+    PixelSet pixels = Cover(spans);
+    for (int x = -30; x <= -10; x++) {
+        EXPECT_TRUE(pixels.count({x, -5}) == 1);
+    }
+    EXPECT_EQ(21u, pixels.size());
+    // 跨过 0 的矩形与正坐标的结果一致
+    spans.clear();
+    ScanlinePolygon({-2.5, 1.5, 1.5, -2.5}, {-1.5, -1.5, 1.5, 1.5}, spans);
+    PixelSet expected;
+    InsertRectangle(expected, -3, -2, 1, 1);
+    EXPECT_TRUE(expected == Cover(spans));
+}
+
+DWR_TEST(ScanlineDegeneratePolygonIsEmpty) {
+    std::vector<PixelSpan> spans;
+    ScanlinePolygon({}, {}, spans);
+    ScanlinePolygon({1.5}, {2.5}, spans);
+    ScanlinePolygon({1.5, 8.5}, {2.5, 6.5}, spans);
+    EXPECT_TRUE(spans.empty());
+}
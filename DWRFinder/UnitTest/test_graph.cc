@@ -0,0 +1,101 @@
+//
+//  test_graph.cc
+//  DWRFinder UnitTest
+//
+//  Created by ZachQin on 2018/1/26.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include "test_graph.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "coordinate_convert.h"
+
+namespace dwr {
+namespace unit_test {
+
+static const double kDegToRad = 0.017453292519943295;
+static const double kGridLongitude = 110.0, kGridLatitude = 30.0, kGridSpacing = 0.1;
+static const double kPixelSize = 250.0;
+static const int kMargin = 40;
+
+void BuildGrid(AirwayGraph &graph, int rows, int columns) {
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < columns; column++) {
+            graph.AddWaypoint(GridIdentifier(columns, row, column),
+                              "G" + std::to_string(row) + "_" + std::to_string(column),
+                              (kGridLongitude + column * kGridSpacing) * kDegToRad,
+                              (kGridLatitude - row * kGridSpacing) * kDegToRad);
+        }
+    }
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < columns; column++) {
+            if (column + 1 < columns) {
+                graph.AddAirwaySegment(GridIdentifier(columns, row, column), GridIdentifier(columns, row, column + 1));
+            }
+            if (row + 1 < rows) {
+                graph.AddAirwaySegment(GridIdentifier(columns, row, column), GridIdentifier(columns, row + 1, column));
+            }
+            if (column + 1 < columns && row + 1 < rows) {
+                graph.AddAirwaySegment(GridIdentifier(columns, row, column), GridIdentifier(columns, row + 1, column + 1));
+            }
+            if (column > 0 && row + 1 < rows) {
+                graph.AddAirwaySegment(GridIdentifier(columns, row, column), GridIdentifier(columns, row + 1, column - 1));
+            }
+        }
+    }
+}
+
+RasterSourceInfo GridRasterSource(int rows, int columns) {
+    double left, top, right, bottom;
+    LonLatToMerc(kGridLongitude * kDegToRad, kGridLatitude * kDegToRad, &left, &top);
+    LonLatToMerc((kGridLongitude + (columns - 1) * kGridSpacing) * kDegToRad,
+                 (kGridLatitude - (rows - 1) * kGridSpacing) * kDegToRad, &right, &bottom);
+    WorldFileInfo world_file_info;
+    world_file_info.A = kPixelSize;
+    world_file_info.B = 0;
+    world_file_info.D = 0;
+    world_file_info.E = -kPixelSize;
+    world_file_info.C = left - kMargin * kPixelSize;
+    world_file_info.F = top + kMargin * kPixelSize;
+    int width = static_cast<int>((right - left) / kPixelSize) + 2 * kMargin;
+    int height = static_cast<int>((top - bottom) / kPixelSize) + 2 * kMargin;
+    return RasterSourceInfo(world_file_info, width, height);
+}
+
+Pixel WaypointPixel(const RasterSourceInfo &info, const Waypoint &waypoint) {
+    const WorldFileInfo &w = info.world_file_info;
+    return Pixel(static_cast<int>((waypoint.coordinate.x - w.C) / w.A),
+                 static_cast<int>((waypoint.coordinate.y - w.F) / w.E));
+}
+
+std::vector<char> ClearRaster(const RasterSourceInfo &info) {
+    return std::vector<char>(info.width * info.height, 0);
+}
+
+void FillSquare(std::vector<char> &raster, const RasterSourceInfo &info, const Pixel &center, int radius, char value) {
+    for (int y = std::max(center.y - radius, 0); y <= std::min(center.y + radius, info.height - 1); y++) {
+        for (int x = std::max(center.x - radius, 0); x <= std::min(center.x + radius, info.width - 1); x++) {
+            raster[y * info.width + x] = value;
+        }
+    }
+}
+
+void FillSegmentMiddle(std::vector<char> &raster, const RasterSourceInfo &info, const AirwayGraph &graph,
+                       WaypointIdentifier identifier1, WaypointIdentifier identifier2, int radius, char value) {
+    Pixel pixel1 = WaypointPixel(info, *graph.WaypointFromIdentifier(identifier1));
+    Pixel pixel2 = WaypointPixel(info, *graph.WaypointFromIdentifier(identifier2));
+    FillSquare(raster, info, Pixel((pixel1.x + pixel2.x) / 2, (pixel1.y + pixel2.y) / 2), radius, value);
+}
+
+char *NewRasterData(const std::vector<char> &raster) {
+    char *raster_data = new char[raster.size()];
+    memcpy(raster_data, raster.data(), raster.size());
+    return raster_data;
+}
+
+}  // namespace unit_test
+}  // namespace dwr
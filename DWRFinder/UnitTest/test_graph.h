@@ -0,0 +1,66 @@
+//
+//  test_graph.h
+//  DWRFinder UnitTest
+//
+//  Created by ZachQin on 2018/1/26.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#ifndef test_graph_h
+#define test_graph_h
+
+#include <vector>
+
+#include "airway_graph.h"
+#include "dynamic_radar_airway_graph.h"
+#include "raster_type.h"
+
+namespace dwr {
+namespace unit_test {
+
+/**
+ Airway grid of rows x columns waypoints 0.1° apart, from 110°E 30°N to the south east. The
+ waypoint at row r and column c has the identifier GridIdentifier(columns, r, c) and the
+ segments to its right, below and on both diagonals below. The diagonals make the turns less
+ than 90°, which the searches require.
+ */
+void BuildGrid(AirwayGraph &graph, int rows, int columns);
+
+inline WaypointIdentifier GridIdentifier(int columns, int row, int column) {
+    return row * columns + column + 1;
+}
+
+/**
+ Radar of 250 m pixels covering the grid with a margin of 40 pixels, not rotated.
+ */
+RasterSourceInfo GridRasterSource(int rows, int columns);
+
+/**
+ Pixel of a waypoint of a built graph.
+ */
+Pixel WaypointPixel(const RasterSourceInfo &info, const Waypoint &waypoint);
+
+/**
+ All clear raster of the radar.
+ */
+std::vector<char> ClearRaster(const RasterSourceInfo &info);
+
+/**
+ Set the pixels of the square of the given radius around a center.
+ */
+void FillSquare(std::vector<char> &raster, const RasterSourceInfo &info, const Pixel &center, int radius, char value);
+
+/**
+ Set the pixels around the middle of the segment between two waypoints.
+ */
+void FillSegmentMiddle(std::vector<char> &raster, const RasterSourceInfo &info, const AirwayGraph &graph,
+                       WaypointIdentifier identifier1, WaypointIdentifier identifier2, int radius, char value);
+
+/**
+ Copy of the raster allocated with new[], as taken by UpdateBlock.
+ */
+char *NewRasterData(const std::vector<char> &raster);
+
+}  // namespace unit_test
+}  // namespace dwr
+#endif /* test_graph_h */
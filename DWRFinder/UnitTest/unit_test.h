@@ -0,0 +1,99 @@
+//
+//  unit_test.h
+//  DWRFinder UnitTest
+//
+//  Created by ZachQin on 2018/1/26.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+//  Minimal test registry. A test is declared with DWR_TEST and checks with the EXPECT macros,
+//  which record the failure and let the test continue.
+//
+
+#ifndef unit_test_h
+#define unit_test_h
+
+#include <cmath>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace dwr {
+namespace unit_test {
+
+struct TestCase {
+    std::string name;
+    std::function<void()> function;
+};
+
+/**
+ Tests in the order of registration.
+ */
+std::vector<TestCase> &Registry();
+
+/**
+ Record a failed expectation of the running test.
+ */
+void Fail(const char *file, int line, const std::string &message);
+
+struct Registrar {
+    Registrar(const char *name, const std::function<void()> &function) {
+        Registry().push_back({name, function});
+    }
+};
+
+template <typename Expected, typename Actual>
+void ExpectEqual(const Expected &expected, const Actual &actual,
+                 const char *expected_text, const char *actual_text,
+                 const char *file, int line) {
+    if (expected == actual) {
+        return;
+    }
+    std::ostringstream message;
+    message << actual_text << " is " << actual << ", expected " << expected_text << " (" << expected << ")";
+    Fail(file, line, message.str());
+}
+
+}  // namespace unit_test
+}  // namespace dwr
+
+#define DWR_TEST(name) \
+static void name(); \
+static const dwr::unit_test::Registrar name##_registrar(#name, name); \
+static void name()
+
+#define EXPECT_TRUE(condition) \
+do { \
+    if (!(condition)) { \
+        dwr::unit_test::Fail(__FILE__, __LINE__, "expected " #condition); \
+    } \
+} while (0)
+
+#define EXPECT_EQ(expected, actual) \
+dwr::unit_test::ExpectEqual((expected), (actual), #expected, #actual, __FILE__, __LINE__)
+
+#define EXPECT_NEAR(expected, actual, tolerance) \
+do { \
+    double expected_value = (expected), actual_value = (actual); \
+    if (!(std::fabs(expected_value - actual_value) <= (tolerance))) { \
+        std::ostringstream message; \
+        message.precision(17); \
+        message << #actual " is " << actual_value << ", expected " << expected_value << " within " << (tolerance); \
+        dwr::unit_test::Fail(__FILE__, __LINE__, message.str()); \
+    } \
+} while (0)
+
+#define EXPECT_THROW(statement, exception) \
+do { \
+    bool thrown = false; \
+    try { \
+        statement; \
+    } catch (const exception &) { \
+        thrown = true; \
+    } \
+    if (!thrown) { \
+        dwr::unit_test::Fail(__FILE__, __LINE__, "expected " #statement " to throw " #exception); \
+    } \
+} while (0)
+
+#endif /* unit_test_h */
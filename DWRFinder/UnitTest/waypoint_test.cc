@@ -0,0 +1,31 @@
+//
+//  waypoint_test.cc
+//  DWRFinder UnitTest
+//
+//  Created by ZachQin on 2018/1/26.
+//  Copyright © 2018年 Zach. All rights reserved.
+//
+
+#include "airway_type.h"
+#include "unit_test.h"
+
+using namespace dwr;
+
+static const double kDegToRad = 0.017453292519943295;
+
+DWR_TEST(WaypointDistanceFollowsSetLocation) {
+    Waypoint waypoint1(1, "A", 110.0 * kDegToRad, 30.0 * kDegToRad);
+    Waypoint waypoint2(2, "B", 110.5 * kDegToRad, 30.2 * kDegToRad);
+    GeoDistance distance = Waypoint::Distance(waypoint1, waypoint2);
+    EXPECT_TRUE(distance > 50000 && distance < 60000);
+    // 默认构造后设置位置，与带位置构造的距离相同
+    Waypoint moved_waypoint;
+    moved_waypoint.SetLocation(waypoint2.GetLocation());
+    EXPECT_NEAR(distance, Waypoint::Distance(waypoint1, moved_waypoint), 1e-6);
+    // 复制后移动，距离随之改变
+    Waypoint copied_waypoint(waypoint1);
+    EXPECT_NEAR(0, Waypoint::Distance(waypoint1, copied_waypoint), 1e-6);
+    copied_waypoint.SetLocation(waypoint2.GetLocation());
+    EXPECT_NEAR(distance, Waypoint::Distance(waypoint1, copied_waypoint), 1e-6);
+    EXPECT_NEAR(distance, Waypoint::ChordDistance(waypoint1, copied_waypoint), distance * 1e-4);
+}